@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+#define INITIAL_CAPACITY 256
+#define NAME_CHUNK_SIZE 16384
+
+// Marks an empty slot of the index
+#define NO_ATOM UINT32_MAX
+
+// Names are copied into large chunks instead of one malloc per name
+typedef struct NameChunk
+{
+  struct NameChunk* next;
+  size_t used;
+  size_t size;
+  char data[];
+} NameChunk;
+
+// One interned name
+typedef struct Entry
+{
+  const char* name;
+  uint32_t len;
+  uint64_t hash;
+} Entry;
+
+static NameChunk* chunks = NULL;
+
+// Names by Atom
+static Entry* entries = NULL;
+static size_t count = 0;
+static size_t entries_capacity = 0;
+
+// Open-addressing (linear probing) index from names to Atoms
+static Atom* atom_index = NULL;
+static size_t atom_index_capacity = 0;
+
+// FNV-1a over the bytes followed by the murmur3 64-bit finalizer
+static uint64_t hashBytes(const char* text, size_t len)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    hash ^= (unsigned char) text[i];
+    hash *= 1099511628211ULL;
+  }
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Copy len bytes plus a terminating '\0' into the chunks
+static const char* storeName(const char* text, size_t len)
+{
+  if (chunks == NULL || chunks->size - chunks->used < len + 1)
+  {
+    size_t size = len + 1 > NAME_CHUNK_SIZE ? len + 1 : NAME_CHUNK_SIZE;
+    NameChunk* chunk = (NameChunk*) malloc(sizeof(NameChunk) + size);
+    chunk->next = chunks;
+    chunk->used = 0;
+    chunk->size = size;
+    chunks = chunk;
+  }
+
+  char* copy = chunks->data + chunks->used;
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+  chunks->used += len + 1;
+  return copy;
+}
+
+// Double the index, reinserting Atoms by their stored hash
+static void growIndex()
+{
+  size_t capacity = atom_index_capacity ? 2 * atom_index_capacity : INITIAL_CAPACITY;
+  Atom* slots = (Atom*) malloc(capacity * sizeof(Atom));
+  memset(slots, 0xff, capacity * sizeof(Atom));
+
+  for (size_t i = 0; i < count; i++)
+  {
+    size_t j = entries[i].hash & (capacity - 1);
+    while (slots[j] != NO_ATOM)
+      j = (j + 1) & (capacity - 1);
+    slots[j] = (Atom) i;
+  }
+
+  free(atom_index);
+  atom_index = slots;
+  atom_index_capacity = capacity;
+}
+
+Atom internAtom(const char* text, size_t len)
+{
+  // Keep the load factor at or below one half
+  if (2 * (count + 1) > atom_index_capacity)
+    growIndex();
+
+  uint64_t hash = hashBytes(text, len);
+  size_t mask = atom_index_capacity - 1;
+  size_t i = hash & mask;
+
+  while (atom_index[i] != NO_ATOM)
+  {
+    const Entry* entry = &entries[atom_index[i]];
+    if (entry->hash == hash && entry->len == len && memcmp(entry->name, text, len) == 0)
+      return atom_index[i];
+    i = (i + 1) & mask;
+  }
+
+  if (count == entries_capacity)
+  {
+    entries_capacity = entries_capacity ? 2 * entries_capacity : INITIAL_CAPACITY;
+    entries = (Entry*) realloc(entries, entries_capacity * sizeof(Entry));
+  }
+
+  Atom atom = (Atom) count++;
+  entries[atom].name = storeName(text, len);
+  entries[atom].len = (uint32_t) len;
+  entries[atom].hash = hash;
+  atom_index[i] = atom;
+  return atom;
+}
+
+const char* atomName(Atom atom)
+{
+  return entries[atom].name;
+}
+
+size_t internCount(void)
+{
+  return count;
+}
+
+void internFree(void)
+{
+  while (chunks != NULL)
+  {
+    NameChunk* next = chunks->next;
+    free(chunks);
+    chunks = next;
+  }
+
+  free(entries);
+  free(atom_index);
+  entries = NULL;
+  atom_index = NULL;
+  count = entries_capacity = atom_index_capacity = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  String interning pool shared by the lexer and the parser.
+
+  The lexer interns every identifier once and passes its Atom in yylval.
+  Equal names always get the same Atom, so the parser and the symbol table
+  compare identifiers as integers and never copy or rehash the text.
+  Atoms are dense, starting from 0.
+*/
+typedef uint32_t Atom;
+
+// Atom of the len bytes at text, adding them to the pool if new
+Atom internAtom(const char* text, size_t len);
+
+// The name an Atom stands for, valid until internFree()
+const char* atomName(Atom atom);
+
+// Number of distinct names interned so far
+size_t internCount(void);
+
+// Release every name in the pool
+void internFree(void);
+
+#endif
@@ -1,25 +1,52 @@
 %{
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "intern.h"
+
 int yylex ( );
 
 int yylineno;
 
 void yyerror ( char * );
 
-char sym_table[255][255], tmp[255];
+// Marks an empty slot of the symbol table
+#define EMPTY_SLOT UINT32_MAX
+
+// Open-addressing (linear probing) hash set of the Atoms of declared
+// identifiers. Capacity is always a power of two and doubles when half full.
+typedef struct SymTable
+{
+  Atom* slots;
+  size_t capacity;
+  size_t count;
+} SymTable;
 
-int sym_table_index = 0;
+#define SYM_TABLE_INIT_CAPACITY 64
+
+SymTable sym_table;
 
 int sem_err = 0;
 
-void updateSymTable ( int );
+// Syntax errors recovered from so far, and how many are too many to go on
+int syntax_err = 0;
+#define MAX_SYNTAX_ERRORS 20
+
+int recover ( );
+
+void updateSymTable ( Atom, int );
+void freeSymTable ( );
 %}
 
+%code requires
+{
+#include "intern.h"
+}
+
 %union
 {
-	char* str;
+	Atom atom;
 }
 
 // Keywords
@@ -60,7 +87,7 @@ void updateSymTable ( int );
 
 // Constants
 %token MAIN_TOK
-%token <str> ID_TOK
+%token <atom> ID_TOK
 %token INTCONST_TOK
 %token REALCONST_TOK
 %token STRCONST_TOK
@@ -117,6 +144,7 @@ BLOCK   : STATEMENTS
 
 STATEMENTS  : STATEMENT STATEMENTS
             |
+            | error                                                                  {if (recover()) YYABORT;}
             ;
 
 STATEMENT   : DECLARE_ASSIGN
@@ -124,6 +152,7 @@ STATEMENT   : DECLARE_ASSIGN
             | CONDITIONAL                                                            {printf("Syntactically correct conditional block ended at Line %d\n", yylineno);}
             | ITERATIVE                                                              {printf("Syntactically correct iterative block ended at Line %d\n", yylineno);}
             | FUNC_CALL                                                              {printf("Function call at Line %d\n", yylineno);}
+            | error ';'                                                              {if (recover()) YYABORT; yyerrok;}
             ;
 
 COMPARISON  : '>'
@@ -143,7 +172,7 @@ DECLARE_ASSIGN  : INT_TOK INT_VARLIST ';'
 
 INT_VARLIST : ID_TOK
             | ID_TOK ',' INT_VARLIST
-            | ID_TOK '=' INTCONST_TOK   {strcpy(tmp, $1); updateSymTable(1);}
+            | ID_TOK '=' INTCONST_TOK   {updateSymTable($1, 1);}
             ;
 
 FLOAT_VARLIST   : FLOAT_TOK
@@ -161,7 +190,7 @@ CHAR_VARLIST    : CHAR_TOK
 
 EXPRESSION_ASSIGN   : INT_TOK ID_TOK '=' EXPRESSION ';'
                     | FLOAT_TOK ID_TOK '=' EXPRESSION ';'
-                    | ID_TOK '=' EXPRESSION ';' {strcpy(tmp, $1); updateSymTable(0);}
+                    | ID_TOK '=' EXPRESSION ';' {updateSymTable($1, 0);}
 
 EXPRESSION  : ID_TOK
             | INTCONST_TOK
@@ -210,22 +239,22 @@ ARGs    : ARG
         ;
 
 ARG : ID_TOK
-    | ID_TOK ',' ARG
+    | ARG ',' ID_TOK
     | INTCONST_TOK
-    | INTCONST_TOK ',' ARG
+    | ARG ',' INTCONST_TOK
     | REALCONST_TOK
-    | REALCONST_TOK ',' ARG
+    | ARG ',' REALCONST_TOK
     | CHARCONST_TOK
-    | CHARCONST_TOK ',' ARG
+    | ARG ',' CHARCONST_TOK
     | STRCONST_TOK
-    | STRCONST_TOK ',' ARG
+    | ARG ',' STRCONST_TOK
     ;
 
 %%
 
 int main()
 {
-  if ( yyparse() == 0 )
+  if ( yyparse() == 0 && syntax_err == 0 )
   {
     printf("\nNo Syntax Error\n");
     printf("%d Semantic Error(s) present\n", sem_err);
@@ -234,6 +263,7 @@ int main()
   {
     printf("\nSyntax Error\n");
   }
+  freeSymTable();
   return 0;
 }
 
@@ -242,31 +272,103 @@ void yyerror ( char *s )
   printf("Error: %s at Line %d\n", s, yylineno);
 }
 
-void updateSymTable ( int isDeclaration )
+/*
+  Count a syntax error the parser recovered from, by skipping to the end
+  of the statement or of the block. Returns 1 once there have been too
+  many to go on, since later ones likely only follow from the first.
+*/
+int recover ( )
+{
+  if (++syntax_err < MAX_SYNTAX_ERRORS)
+    return 0;
+
+  printf("Error: too many syntax errors at Line %d\n", yylineno);
+  return 1;
+}
+
+/*
+  Atoms are small consecutive integers, so they are spread over the whole
+  64-bit range with the murmur3 finalizer before use.
+*/
+unsigned long hashAtom ( Atom atom )
+{
+  unsigned long hash = atom;
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdUL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53UL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Find the slot holding atom, or the empty slot where it would be inserted
+Atom* findSlot ( Atom *slots, size_t capacity, Atom atom )
+{
+  size_t mask = capacity - 1;
+  size_t i = hashAtom(atom) & mask;
+
+  while (slots[i] != EMPTY_SLOT && slots[i] != atom)
+    i = (i + 1) & mask;
+
+  return &slots[i];
+}
+
+// Double the capacity of the table, reinserting every Atom
+void growSymTable ( )
 {
-  for(int i = 0; i < sym_table_index; i++)
+  size_t capacity = sym_table.capacity ? sym_table.capacity * 2 : SYM_TABLE_INIT_CAPACITY;
+  Atom *slots = (Atom*) malloc(capacity * sizeof(Atom));
+  memset(slots, 0xff, capacity * sizeof(Atom));
+
+  for (size_t i = 0; i < sym_table.capacity; i++)
   {
-    if(strcmp(tmp, sym_table[i]) == 0)
+    if (sym_table.slots[i] != EMPTY_SLOT)
+      *findSlot(slots, capacity, sym_table.slots[i]) = sym_table.slots[i];
+  }
+
+  free(sym_table.slots);
+  sym_table.slots = slots;
+  sym_table.capacity = capacity;
+}
+
+void freeSymTable ( )
+{
+  free(sym_table.slots);
+  sym_table.slots = NULL;
+  sym_table.capacity = sym_table.count = 0;
+  internFree();
+}
+
+void updateSymTable ( Atom name, int isDeclaration )
+{
+  // Keep the load factor at or below one half
+  if (2 * (sym_table.count + 1) > sym_table.capacity)
+    growSymTable();
+
+  Atom *slot = findSlot(sym_table.slots, sym_table.capacity, name);
+
+  if (*slot != EMPTY_SLOT)
+  {
+    if (isDeclaration)
     {
-      if (isDeclaration)
-      {
-        sem_err++;
-        printf("Variable %s : ", tmp);
-        yyerror("Variable redeclaration");
-      }
-      return;
+      sem_err++;
+      printf("Variable %s : ", atomName(name));
+      yyerror("Variable redeclaration");
     }
+    return;
   }
 
   if ( !isDeclaration )
   {
     sem_err++;
-    printf("Variable %s : ", tmp);
+    printf("Variable %s : ", atomName(name));
     yyerror("Variable not declared");
     return;
   }
 
-  printf("Variable %s : ", tmp);
+  printf("Variable %s : ", atomName(name));
   printf("Valid variable declaration\n");
-  strcpy(sym_table[sym_table_index++], tmp);
+  *slot = name;
+  sym_table.count++;
 }
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "diag.h"
+
+/*
+  name is the stable identifier of a code in JSON, message is the text of
+  the diagnostic on its own and text is how the checker has always printed
+  it. Both formats take the line and then the argument; the %N$ forms let
+  the lexer messages print the argument first. A code without a text is
+  printed as its message on a line of its own.
+*/
+static const struct
+{
+  Severity severity;
+  const char* name;
+  const char* message;
+  const char* text;
+} codes[DIAG_CODE_COUNT] =
+{
+  [DIAG_MAIN_OK]           = { SEVERITY_NOTE, "main-function", "Syntax of main function is correct", "\nSyntax of main function is correct" },
+  [DIAG_FUNCTION_OK]       = { SEVERITY_NOTE, "user-function", "Syntax of user defined function is correct", "\nSyntax of user defined function is correct" },
+  [DIAG_RETURN_OK]         = { SEVERITY_NOTE, "return-statement", "Syntax of return statement is correct", "\nSyntax of return statement is correct" },
+  [DIAG_DECLARATION_OK]    = { SEVERITY_NOTE, "declaration-statement", "Syntax of declaration statement is correct", "\nSyntax of declaration statement is correct" },
+  [DIAG_ASSIGNMENT_OK]     = { SEVERITY_NOTE, "assignment-statement", "Syntax of assignment statement is correct", "\nSyntax of assignment statement is correct" },
+  [DIAG_CALL_OK]           = { SEVERITY_NOTE, "function-call", "Syntax of function call is correct", "\nSyntax of function call is correct" },
+  [DIAG_ITERATION_OK]      = { SEVERITY_NOTE, "iterative-statement", "Syntax of iterative statement is correct", "\nSyntax of iterative statement is correct" },
+  [DIAG_CONDITIONAL_OK]    = { SEVERITY_NOTE, "conditional-statement", "Syntax of conditional statement is correct", "\nSyntax of conditional statement is correct" },
+  [DIAG_INT_DECLARED]      = { SEVERITY_NOTE, "integer-declared", "Integer declared", "\n Integer declared in line %d.\n" },
+  [DIAG_FLOAT_DECLARED]    = { SEVERITY_NOTE, "float-declared", "Float declared", "\n Float declared in line %d\n" },
+  [DIAG_PARSED]            = { SEVERITY_NOTE, "parse-complete", "Parsed successfully.", "\nParsed successfully.\n" },
+
+  [DIAG_INVALID_TOKEN]     = { SEVERITY_ERROR, "invalid-token", "Known invalid token '%s'", "SYNTAX ERROR : Known invalid token '%2$s' on Line Number %1$d\n" },
+  [DIAG_UNKNOWN_TOKEN]     = { SEVERITY_ERROR, "unknown-token", "Unknown invalid token '%s'", "ERROR : Unknown invalid token '%2$s' in Line Number %1$d\n" },
+  [DIAG_SYNTAX]            = { SEVERITY_ERROR, "syntax-error", "%s", "\nParsing failed in line %d %s\n" },
+  [DIAG_TOO_MANY_ERRORS]   = { SEVERITY_ERROR, "too-many-errors", "Too many syntax errors, giving up", "\nParsing stopped in line %d : Too many syntax errors\n" },
+  [DIAG_REDEFINITION]      = { SEVERITY_ERROR, "multiple-definitions", "Multiple definitions of the identifier %s", "\nParsing failed in line %d : Multiple definitions of the identifier %s\n" },
+  [DIAG_UNDEFINED]         = { SEVERITY_ERROR, "undefined-identifier", "Undefined identifier %s", "\nParsing failed in line %d : Undefined identifier %s\n" },
+  [DIAG_CANNOT_OPEN]       = { SEVERITY_ERROR, "cannot-open", "Cannot open %s", NULL },
+};
+
+void diagInit(Diagnostics* diag, int quiet)
+{
+  diag->records = NULL;
+  diag->count = diag->capacity = 0;
+  diag->errors = 0;
+  diag->quiet = quiet;
+}
+
+void diagFree(Diagnostics* diag)
+{
+  for (size_t i = 0; i < diag->count; i++)
+    free(diag->records[i].arg);
+  free(diag->records);
+  diagInit(diag, diag->quiet);
+}
+
+Severity diagSeverity(DiagCode code)
+{
+  return codes[code].severity;
+}
+
+void diagReport(Diagnostics* diag, DiagCode code, int line, const char* arg)
+{
+  if (codes[code].severity == SEVERITY_ERROR)
+    diag->errors++;
+  else if (diag->quiet)
+    return;
+
+  if (diag->count == diag->capacity)
+  {
+    diag->capacity = diag->capacity ? 2 * diag->capacity : 64;
+    diag->records = (Diagnostic*) realloc(diag->records, diag->capacity * sizeof(Diagnostic));
+  }
+
+  Diagnostic* record = &diag->records[diag->count++];
+  record->code = code;
+  record->line = line;
+  record->arg = arg ? strdup(arg) : NULL;
+}
+
+void diagWriteText(const Diagnostics* diag, FILE* out)
+{
+  for (size_t i = 0; i < diag->count; i++)
+  {
+    const Diagnostic* record = &diag->records[i];
+    const char* arg = record->arg ? record->arg : "";
+
+    if (codes[record->code].text)
+      fprintf(out, codes[record->code].text, record->line, arg);
+    else
+    {
+      fputc('\n', out);
+      fprintf(out, codes[record->code].message, arg);
+      fputc('\n', out);
+    }
+  }
+}
+
+static void writeJsonString(FILE* out, const char* text)
+{
+  fputc('"', out);
+  for (const unsigned char* c = (const unsigned char*) text; *c; c++)
+  {
+    if (*c == '"' || *c == '\\')
+      fprintf(out, "\\%c", *c);
+    else if (*c < 0x20)
+      fprintf(out, "\\u%04x", *c);
+    else
+      fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+void diagWriteJson(const Diagnostics* diag, FILE* out, const char* file)
+{
+  fprintf(out, "{\"file\": ");
+  writeJsonString(out, file);
+  fprintf(out, ", \"errors\": %zu, \"diagnostics\": [", diag->errors);
+
+  for (size_t i = 0; i < diag->count; i++)
+  {
+    const Diagnostic* record = &diag->records[i];
+    char message[256];
+    snprintf(message, sizeof(message), codes[record->code].message, record->arg ? record->arg : "");
+
+    fprintf(out, i ? ",\n  " : "\n  ");
+    fprintf(out, "{\"severity\": \"%s\", \"line\": %d, \"code\": \"%s\", \"message\": ",
+            codes[record->code].severity == SEVERITY_ERROR ? "error" : "note",
+            record->line, codes[record->code].name);
+    writeJsonString(out, message);
+    if (record->arg)
+    {
+      fprintf(out, ", \"argument\": ");
+      writeJsonString(out, record->arg);
+    }
+    fprintf(out, "}");
+  }
+
+  fprintf(out, diag->count ? "\n]}" : "]}");
+}
@@ -0,0 +1,76 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum Severity
+{
+  SEVERITY_NOTE,   // progress of the parse, dropped in quiet mode
+  SEVERITY_ERROR
+} Severity;
+
+// What a diagnostic reports. Every code has a fixed severity and message.
+typedef enum DiagCode
+{
+  DIAG_MAIN_OK,
+  DIAG_FUNCTION_OK,
+  DIAG_RETURN_OK,
+  DIAG_DECLARATION_OK,
+  DIAG_ASSIGNMENT_OK,
+  DIAG_CALL_OK,
+  DIAG_ITERATION_OK,
+  DIAG_CONDITIONAL_OK,
+  DIAG_INT_DECLARED,
+  DIAG_FLOAT_DECLARED,
+  DIAG_PARSED,
+
+  DIAG_INVALID_TOKEN,      // argument: the token
+  DIAG_UNKNOWN_TOKEN,      // argument: the token
+  DIAG_SYNTAX,             // argument: message from the parser
+  DIAG_TOO_MANY_ERRORS,
+  DIAG_REDEFINITION,       // argument: the identifier
+  DIAG_UNDEFINED,          // argument: the identifier
+  DIAG_CANNOT_OPEN,        // argument: the file
+
+  DIAG_CODE_COUNT
+} DiagCode;
+
+typedef struct Diagnostic
+{
+  DiagCode code;
+  int line;
+  char* arg;     // owned copy of the argument, or NULL
+} Diagnostic;
+
+/*
+  Sink for the diagnostics of one file.
+
+  Reporting only appends a record; nothing is formatted or written until
+  diagWriteText() or diagWriteJson() prints them all in one go at the end.
+  A quiet sink keeps errors only, so a clean file costs no output at all.
+*/
+typedef struct Diagnostics
+{
+  Diagnostic* records;
+  size_t count;
+  size_t capacity;
+  size_t errors;
+  int quiet;
+} Diagnostics;
+
+void diagInit(Diagnostics* diag, int quiet);
+void diagFree(Diagnostics* diag);
+
+// Record a diagnostic; arg is copied and may be NULL
+void diagReport(Diagnostics* diag, DiagCode code, int line, const char* arg);
+
+Severity diagSeverity(DiagCode code);
+
+// Print the records in the classic format of the checker
+void diagWriteText(const Diagnostics* diag, FILE* out);
+
+// Print the records as a JSON object naming the file
+void diagWriteJson(const Diagnostics* diag, FILE* out, const char* file);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+#define INITIAL_CAPACITY 256
+#define NAME_CHUNK_SIZE 16384
+
+// Marks an empty slot of the index
+#define NO_ATOM UINT32_MAX
+
+// Names are copied into large chunks instead of one malloc per name
+typedef struct NameChunk
+{
+  struct NameChunk* next;
+  size_t used;
+  size_t size;
+  char data[];
+} NameChunk;
+
+// One interned name
+typedef struct InternEntry
+{
+  const char* name;
+  uint32_t len;
+  uint64_t hash;
+} InternEntry;
+
+// FNV-1a over the bytes followed by the murmur3 64-bit finalizer
+static uint64_t hashBytes(const char* text, size_t len)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    hash ^= (unsigned char) text[i];
+    hash *= 1099511628211ULL;
+  }
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Copy len bytes plus a terminating '\0' into the chunks
+static const char* storeName(InternPool* pool, const char* text, size_t len)
+{
+  NameChunk* chunk = pool->chunks;
+
+  if (chunk == NULL || chunk->size - chunk->used < len + 1)
+  {
+    size_t size = len + 1 > NAME_CHUNK_SIZE ? len + 1 : NAME_CHUNK_SIZE;
+    chunk = (NameChunk*) malloc(sizeof(NameChunk) + size);
+    chunk->next = pool->chunks;
+    chunk->used = 0;
+    chunk->size = size;
+    pool->chunks = chunk;
+  }
+
+  char* copy = chunk->data + chunk->used;
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+  chunk->used += len + 1;
+  return copy;
+}
+
+// Double the index, reinserting Atoms by their stored hash
+static void growIndex(InternPool* pool)
+{
+  size_t capacity = pool->index_capacity ? 2 * pool->index_capacity : INITIAL_CAPACITY;
+  Atom* slots = (Atom*) malloc(capacity * sizeof(Atom));
+  memset(slots, 0xff, capacity * sizeof(Atom));
+
+  for (size_t i = 0; i < pool->count; i++)
+  {
+    size_t j = pool->entries[i].hash & (capacity - 1);
+    while (slots[j] != NO_ATOM)
+      j = (j + 1) & (capacity - 1);
+    slots[j] = (Atom) i;
+  }
+
+  free(pool->index);
+  pool->index = slots;
+  pool->index_capacity = capacity;
+}
+
+void internInit(InternPool* pool)
+{
+  pool->chunks = NULL;
+  pool->entries = NULL;
+  pool->count = pool->entries_capacity = 0;
+  pool->index = NULL;
+  pool->index_capacity = 0;
+}
+
+Atom internAtom(InternPool* pool, const char* text, size_t len)
+{
+  // Keep the load factor at or below one half
+  if (2 * (pool->count + 1) > pool->index_capacity)
+    growIndex(pool);
+
+  uint64_t hash = hashBytes(text, len);
+  size_t mask = pool->index_capacity - 1;
+  size_t i = hash & mask;
+
+  while (pool->index[i] != NO_ATOM)
+  {
+    const InternEntry* entry = &pool->entries[pool->index[i]];
+    if (entry->hash == hash && entry->len == len && memcmp(entry->name, text, len) == 0)
+      return pool->index[i];
+    i = (i + 1) & mask;
+  }
+
+  if (pool->count == pool->entries_capacity)
+  {
+    pool->entries_capacity = pool->entries_capacity ? 2 * pool->entries_capacity : INITIAL_CAPACITY;
+    pool->entries = (InternEntry*) realloc(pool->entries, pool->entries_capacity * sizeof(InternEntry));
+  }
+
+  Atom atom = (Atom) pool->count++;
+  pool->entries[atom].name = storeName(pool, text, len);
+  pool->entries[atom].len = (uint32_t) len;
+  pool->entries[atom].hash = hash;
+  pool->index[i] = atom;
+  return atom;
+}
+
+const char* atomName(const InternPool* pool, Atom atom)
+{
+  return pool->entries[atom].name;
+}
+
+size_t internCount(const InternPool* pool)
+{
+  return pool->count;
+}
+
+void internFree(InternPool* pool)
+{
+  while (pool->chunks != NULL)
+  {
+    NameChunk* next = pool->chunks->next;
+    free(pool->chunks);
+    pool->chunks = next;
+  }
+
+  free(pool->entries);
+  free(pool->index);
+  internInit(pool);
+}
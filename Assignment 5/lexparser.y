@@ -1,173 +1,200 @@
+%code requires
+{
+#include <stdio.h>
+
+#include "diag.h"
+#include "symstats.h"
+#include "symtable.h"
+
+/*
+  All the state of one parse. The parser is pure and is fed one token at
+  a time with yypush_parse(), so any number of files can be checked at
+  once, each with its own Checker. The lexer of a parse keeps its line
+  number and names here too, and every message of the parse is recorded
+  in diag.
+*/
+typedef struct Checker
+{
+  Diagnostics diag;
+  int lineno;        // line being scanned
+  int syntax_errors; // recovered from so far
+  int scope;         // current scope depth
+  int dtype;         // datatype of the declaration being parsed
+  Atom fname;        // function being parsed
+  Atom* vars;        // variables of the declaration being parsed
+  size_t var_count;
+  size_t var_capacity;
+  Symtable table;
+  SymtableStats* stats;  // kept if not NULL
+  InternPool names;  // identifiers seen by the lexer
+  int syntax_only;   // nothing is named or checked, see checkSyntax()
+} Checker;
+}
+
+%define api.pure full
+%define api.push-pull push
+%parse-param { Checker* ctx }
+
+// yylval is an union, instead of the default int
+// and can hold both strings and integers.
+%union
+{
+  int number;
+  Atom atom;
+}
+
 %{
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <getopt.h>
+#include <unistd.h>
 
-// Size of symbol table
-#define TABLE_SIZE 100
-
-int yylex();
-void yyerror(char* s);
-int yylineno;
-FILE* yyin;
-
-// If there is no error in parsing a line, success remains 1, else changed to 0.
-int success = 1;
+#include "batch.h"
 
-// Tracks scope during parsing
-int scope = 0;
+void yyerror(Checker* ctx, char* s);
 
-// Stores datatype during parsing
-int dtype;
+// Syntax errors recovered from before the parse is given up
+#define MAX_SYNTAX_ERRORS 20
 
-// Stores current function name during parsing
-char fname[10] = "main";
-
-// Structure for a symbol's entry in a symbol table
-typedef struct Symbol
+void __init__(Checker* ctx, int quiet)
 {
-  char name[10];
-  char fname[10];
-  int dtype; // 0 for int; 1 for float
-  int scope; // scope of this symbol
-  struct Symbol* next;
-} Symbol;
-
-// Symbol table structure
-typedef struct Symtable
+  diagInit(&ctx->diag, quiet);
+  ctx->lineno = 1;
+  ctx->syntax_errors = 0;
+  ctx->scope = 0;
+  ctx->dtype = 0;
+  ctx->vars = NULL;
+  ctx->var_count = 0;
+  ctx->var_capacity = 0;
+  internInit(&ctx->names);
+  symtableInit(&ctx->table);
+  ctx->stats = NULL;
+  ctx->syntax_only = 0;
+  ctx->fname = internAtom(&ctx->names, "main", 4);
+}
+
+// Record a diagnostic for the current line
+void report(Checker* ctx, DiagCode code, const char* arg)
 {
-  Symbol* entry[TABLE_SIZE];
-} Symtable;
+  diagReport(&ctx->diag, code, ctx->lineno, arg);
+}
 
 /*
-  http://www.cse.yorku.ca/~oz/hash.html -> djb2 algorithm
-
-  this algorithm (k=33) was first reported by dan bernstein many years ago in
-  comp.lang.c. another version of this algorithm (now favored by bernstein)
-  uses xor: hash(i) = hash(i - 1) * 33 ^ str[i]; the magic of number 33 (why
-  it works better than many other constants, prime or not) has never
-  been adequately explained.
+  Count a syntax error the parser recovered from. A bad file can go on
+  producing errors that only follow from the first ones, so the parse is
+  given up once there have been MAX_SYNTAX_ERRORS; returns 1 then.
 */
-int hash(char *str)
+int recover(Checker* ctx)
 {
-  int hash = 5381;
-  int c;
+  // Only the first error is wanted then
+  if (ctx->syntax_only)
+    return 1;
 
-  while ((c = *str++))
-    hash = ((hash << 5) + hash) + c; // hash * 33 + c
-
-  return hash % TABLE_SIZE;
-}
-
-// Global variable for symbol table
-Symtable table;
+  if (++ctx->syntax_errors < MAX_SYNTAX_ERRORS)
+    return 0;
 
-void __init__()
-{
-  for (int i = 0; i < TABLE_SIZE; i++)
-    table.entry[i] = NULL;
+  report(ctx, DIAG_TOO_MANY_ERRORS, NULL);
+  return 1;
 }
 
 // Function to add a new entry to symbol table
-void add(char* symb)
+void add(Checker* ctx, Atom symb)
 {
-  int hval = hash(symb);
-  Symbol* head = table.entry[hval];
-  if (head == NULL)
-  {
-    // No collision
-    head = ( Symbol* )malloc(sizeof(Symbol));
-    strcpy(head->name, symb);
-    strcpy(head->fname, fname);
-    head->dtype = dtype;
-    head->scope = scope;
-    head->next = NULL;
-    table.entry[hval] = head;
+  if (ctx->syntax_only)
     return;
-  }
 
-  // For collision, add this new symbol to the end of list
-  while(head->next != NULL)
-    head = head->next;
+  symtableInsert(&ctx->table, symb, ctx->fname, ctx->dtype, ctx->scope);
+  if (ctx->stats != NULL)
+    ctx->stats->inserts++;
+}
 
-  head->next = ( Symbol* )malloc(sizeof(Symbol));
-  strcpy(head->name, symb);
-  head->dtype = dtype;
-  head->scope = scope;
-  head->next = NULL;
+// Symbol named symb declared in scope with datatype dtype, or visible from
+// scope if dtype is -1; counted and timed if stats are kept
+const Symbol* lookup(Checker* ctx, Atom symb, int dtype)
+{
+  const Symtable* table = &ctx->table;
+  if (ctx->stats == NULL)
+    return dtype < 0 ? symtableLookupVisible(table, symb, ctx->fname, ctx->scope)
+                     : symtableLookupInScope(table, symb, ctx->fname, ctx->scope, dtype);
+
+  uint64_t start = statsClock();
+  const Symbol* symbol = dtype < 0 ? symtableLookupVisible(table, symb, ctx->fname, ctx->scope)
+                                   : symtableLookupInScope(table, symb, ctx->fname, ctx->scope, dtype);
+  uint64_t ns = statsClock() - start;
+  statsLookup(ctx->stats, symtableProbes(table, symb, ctx->fname, ctx->scope, dtype), symbol != NULL, ns);
+  return symbol;
 }
 
 // Function to check if the variable is being redefined within a function in same scope
-int existsInSameScope(char* symb)
+int existsInSameScope(Checker* ctx, Atom symb)
 {
-  int hval = hash(symb);
-  Symbol* head = table.entry[hval];
-  if (head == NULL)
+  // If the symbol names match and
+  // the current scope is same as its scope and
+  // they are within same function and
+  // their datatypes are same
+  // then it implies that this identifier is being redeclared.
+  if (ctx->syntax_only)
     return 0;
 
-  while (head != NULL)
-  {
-    // If the symbol names match and
-    // the current scope is same as its scope and
-    // they are within same function and
-    // their datatypes are same
-    // then it implies that this identifier is being redeclared.
-    if (strcmp(head->name,symb)==0 && head->scope==scope &&
-        strcmp(head->fname,fname)==0 && dtype==head->dtype)
-      return 1;
-
-    head = head->next;
-  }
-  return 0;
+  return lookup(ctx, symb, ctx->dtype) != NULL;
 }
 
 // Function to check if hashtable contains a particular symbol.
-int contains(char* symb)
+int contains(Checker* ctx, Atom symb)
 {
-  int hval = hash(symb);
-  Symbol* head = table.entry[hval];
-  if (head == NULL)
-    return 0;
+  // If the symbol names match and
+  // either the var is global or
+  // the current scope>=its scope and they are within same function
+  // then it implies that this identifier is already present.
+  if (ctx->syntax_only)
+    return 1;
+
+  return lookup(ctx, symb, -1) != NULL;
+}
 
-  while (head != NULL)
+/*
+  The variables of a declaration are read left to right, so the parser
+  stack does not grow with their number, but declared from the last one
+  back once the declaration ends, as the right recursive rule they were
+  parsed with used to. So a name declared twice in one declaration is
+  still reported where it was.
+*/
+void pushVar(Checker* ctx, Atom symb)
+{
+  if (ctx->syntax_only)
+    return;
+
+  if (ctx->var_count == ctx->var_capacity)
   {
-    // If the symbol names match and
-    // either the var is global or
-    // the current scope>=its scope and they are within same function
-    // then it implies that this identifier is already present.
-    if ((strcmp(head->name,symb)==0) &&
-        ((head->scope==0) || (head->scope<=scope && strcmp(head->fname,fname)==0)))
-      return 1;
-
-    head = head->next;
+    ctx->var_capacity = ctx->var_capacity ? 2 * ctx->var_capacity : 16;
+    ctx->vars = (Atom*) realloc(ctx->vars, ctx->var_capacity * sizeof(Atom));
   }
-  return 0;
+  ctx->vars[ctx->var_count++] = symb;
 }
 
-// Free all the DMA space of hashtable
-void __freeMemory__()
+void declareVars(Checker* ctx)
 {
-  for (int i = 0; i < TABLE_SIZE; i++)
+  while (ctx->var_count > 0)
   {
-    Symbol* head = table.entry[i];
-    Symbol* temp = head;
-    while (head != NULL)
-    {
-      head = head->next;
-      free(temp);
-    }
+    Atom symb = ctx->vars[--ctx->var_count];
+    if (existsInSameScope(ctx, symb))
+      report(ctx, DIAG_REDEFINITION, atomName(&ctx->names, symb));
+    else
+      add(ctx, symb);
   }
 }
-%}
 
-// yylval is an union, instead of the default int
-// and can hold both strings and integers.
-%union
+// Free all the DMA space of hashtable
+void __freeMemory__(Checker* ctx)
 {
-  int number;
-  char* string;
+  free(ctx->vars);
+  symtableFree(&ctx->table);
+  internFree(&ctx->names);
+  diagFree(&ctx->diag);
 }
+%}
 
 // Keywords
 %token AUTO_TOK
@@ -240,7 +267,7 @@ void __freeMemory__()
 
 // %type tells bison which member of the yylval union is used by which expression
 %type<number> INT_CONST_TOK
-%type<string> ID_TOK
+%type<atom> ID_TOK
 
 %left  '+' '-'
 %left  '*' '/' '%'
@@ -250,56 +277,44 @@ void __freeMemory__()
 %%
 S:              MAIN_FN US_DEF_FNS
                 ;
-MAIN_FN:        DATATYPE MAIN_TOK '(' ')' BLK      {printf("\nSyntax of main function is correct");}
+MAIN_FN:        DATATYPE MAIN_TOK '(' ')' BLK      {report(ctx, DIAG_MAIN_OK, NULL);}
                 ;
 BLK:            BLK_START STMTS BLKS BLK_END
+                | BLK_START STMTS error BLK_END  { if (recover(ctx)) YYABORT;
+                                                   yyerrok;
+                                                 }
                 ;
-BLK_START:      '{'      {scope+=1;}
+BLK_START:      '{'      {ctx->scope+=1;}
                 ;
-BLK_END:        '}'      {scope-=1;}
+BLK_END:        '}'      {ctx->scope-=1;}
                 ;
-BLKS:           BLK STMTS BLKS
+BLKS:           BLKS BLK STMTS
                 |
                 ;
 STMTS:          STMTS STMT
                 |
                 ;
-STMT:           RETURN_TOK EXPRESSION ';'  {printf("\nSyntax of return statement is correct");}
-                | DECLARATION ';'          {printf("\nSyntax of declaration statement is correct");}
-                | ASSIGN ';'               {printf("\nSyntax of assignment statement is correct");}
-                | FN_CALL ';'              {printf("\nSyntax of function call is correct");}
-                | ITER                     {printf("\nSyntax of iterative statement is correct");}
-                | COND                     {printf("\nSyntax of conditional statement is correct");}
-                ;
-DECLARATION:    DATATYPE VARS
-                ;
-DATATYPE:       INT_TOK       {dtype = 0; printf("\n Integer declared in line %d.\n", yylineno);}
-                | FLOAT_TOK   {dtype = 1; printf("\n Float declared in line %d\n", yylineno);}
-                ;
-VARS:           ID_TOK  { if(existsInSameScope($1))
-                          {
-                            char buff[50];
-                            sprintf(buff,": Multiple definitions of the identifier %s",$1);
-                            yyerror(buff);
-                          }
-                          else
-                          {
-                            add($1);
-                          }
-                        }
-                | ID_TOK ',' VARS   { if(existsInSameScope($1))
-                                      {
-                                        char buff[50];
-                                        sprintf(buff,": Multiple definitions of the identifier %s",$1);
-                                        yyerror(buff);
-                                      }
-                                      else
-                                      {
-                                        add($1);
-                                      }
+STMT:           RETURN_TOK EXPRESSION ';'  {report(ctx, DIAG_RETURN_OK, NULL);}
+                | DECLARATION ';'          {report(ctx, DIAG_DECLARATION_OK, NULL);}
+                | ASSIGN ';'               {report(ctx, DIAG_ASSIGNMENT_OK, NULL);}
+                | FN_CALL ';'              {report(ctx, DIAG_CALL_OK, NULL);}
+                | ITER                     {report(ctx, DIAG_ITERATION_OK, NULL);}
+                | COND                     {report(ctx, DIAG_CONDITIONAL_OK, NULL);}
+                | error ';'                { if (recover(ctx)) YYABORT;
+                                             yyerrok;
+                                           }
+                ;
+DECLARATION:    DATATYPE VARS   {declareVars(ctx);}
+                ;
+DATATYPE:       INT_TOK       {ctx->dtype = 0; report(ctx, DIAG_INT_DECLARED, NULL);}
+                | FLOAT_TOK   {ctx->dtype = 1; report(ctx, DIAG_FLOAT_DECLARED, NULL);}
+                ;
+VARS:           ID_TOK              { ctx->var_count = 0;
+                                      pushVar(ctx, $1);
                                     }
+                | VARS ',' ID_TOK   { pushVar(ctx, $3); }
                 ;
-ASSIGN:         ID_TOK '=' EXPRESSION   {if(!contains($1)) { char buff[40]; sprintf(buff,": Undefined identifier %s",$1); yyerror(buff); } }
+ASSIGN:         ID_TOK '=' EXPRESSION   {if(!contains(ctx, $1)) { report(ctx, DIAG_UNDEFINED, atomName(&ctx->names, $1)); } }
                 ;
 EXPRESSION:     '(' EXPRESSION ')'
                 | EXPRESSION '+' EXPRESSION
@@ -308,7 +323,7 @@ EXPRESSION:     '(' EXPRESSION ')'
                 | EXPRESSION '/' EXPRESSION
                 | EXPRESSION '%' EXPRESSION
                 | INT_CONST_TOK
-                | ID_TOK      {if(!contains($1)) { char buff[40]; sprintf(buff,": Undefined identifier %s",$1); yyerror(buff); } }
+                | ID_TOK      {if(!contains(ctx, $1)) { report(ctx, DIAG_UNDEFINED, atomName(&ctx->names, $1)); } }
                 ;
 
 LOGIC_OP:       AND_TOK
@@ -332,29 +347,29 @@ ITER:           FOR_TOK '(' INIT_PART ';' COND_PART ';' CHANGE_PART ')' INNER_BO
                 | WHILE_TOK '(' COND_PART ')' INNER_BODY
                 | DO_TOK INNER_BODY WHILE_TOK '(' COND_PART ')' ';'
                 ;
-INNER_BODY:       BODY_START STMT {scope-=1;}
+INNER_BODY:       BODY_START STMT {ctx->scope-=1;}
                 | BLK
                 ;
-BODY_START:     {scope+=1;}
+BODY_START:     {ctx->scope+=1;}
                 ;
 
 INIT_PART:      ASSIGN
                 |
                 ;
-CHANGE_PART:      ID_TOK '+' '+'      {if(!contains($1)) { char buff[40]; sprintf(buff,": Undefined identifier %s",$1); yyerror(buff); } }
-                | ID_TOK '-' '-'      {if(!contains($1)) { char buff[40]; sprintf(buff,": Undefined identifier %s",$1); yyerror(buff); } }
+CHANGE_PART:      ID_TOK '+' '+'      {if(!contains(ctx, $1)) { report(ctx, DIAG_UNDEFINED, atomName(&ctx->names, $1)); } }
+                | ID_TOK '-' '-'      {if(!contains(ctx, $1)) { report(ctx, DIAG_UNDEFINED, atomName(&ctx->names, $1)); } }
                 |
                 ;
 COND_PART:      CONDITIONS
                 |
                 ;
 CONDITIONS:       CONDITION
-                | CONDITION LOGIC_OP CONDITIONS
+                | CONDITIONS LOGIC_OP CONDITION
                 ;
 CONDITION:      EXPRESSION RELAT_OP EXPRESSION
                 ;
 
-FN_CALL:        ID_TOK '=' FN_SIGN   {if(!contains($1)) { char buff[40]; sprintf(buff,": Undefined identifier %s",$1); yyerror(buff); } }
+FN_CALL:        ID_TOK '=' FN_SIGN   {if(!contains(ctx, $1)) { report(ctx, DIAG_UNDEFINED, atomName(&ctx->names, $1)); } }
                 | FN_SIGN
                 ;
 FN_SIGN:        ID_TOK '(' OPTIONS ')'
@@ -363,52 +378,299 @@ OPTIONS:        PARAMS
                 |
                 ;
 PARAMS:         PARAM
-                | PARAM ',' PARAMS
+                | PARAMS ',' PARAM
                 ;
-PARAM:          ID_TOK  {if(!contains($1)) { char buff[40]; sprintf(buff,": Undefined identifier %s",$1); yyerror(buff); } }
+PARAM:          ID_TOK  {if(!contains(ctx, $1)) { report(ctx, DIAG_UNDEFINED, atomName(&ctx->names, $1)); } }
                 | INT_CONST_TOK
                 ;
 
-US_DEF_FNS:     US_DEF_FN US_DEF_FNS
+US_DEF_FNS:     US_DEF_FNS US_DEF_FN
                 |
                 ;
-US_DEF_FN:      DATATYPE FN_NAME '(' OPTIONS_FORMAL ')' BLK  {printf("\nSyntax of user defined function is correct");}
+US_DEF_FN:      DATATYPE FN_NAME '(' OPTIONS_FORMAL ')' BLK  {report(ctx, DIAG_FUNCTION_OK, NULL);}
                 ;
-FN_NAME:        ID_TOK  {strcpy(fname,$1);}
+FN_NAME:        ID_TOK  {ctx->fname = $1;}
                 ;
 OPTIONS_FORMAL: PARAMS_FORMAL
                 |
                 ;
 PARAMS_FORMAL:    PARAM_FORMAL
-                | PARAM_FORMAL ',' PARAMS_FORMAL
+                | PARAMS_FORMAL ',' PARAM_FORMAL
                 ;
-PARAM_FORMAL:   DATATYPE ID_TOK { if(existsInSameScope($2))
+PARAM_FORMAL:   DATATYPE ID_TOK { if(existsInSameScope(ctx, $2))
                                   {
-                                    char buff[50];
-                                    sprintf(buff,": Multiple definitions of the identifier %s",$2);
-                                    yyerror(buff);
+                                    report(ctx, DIAG_REDEFINITION, atomName(&ctx->names, $2));
                                   }
                                   else
                                   {
-                                    add($2);
+                                    add(ctx, $2);
                                   }
                                 }
 %%
 
+// Reentrant lexer generated from lexrules.l
+int yylex(YYSTYPE* lvalp, void* scanner);
+int yylex_init_extra(Checker* ctx, void** scanner);
+void yyset_in(FILE* in, void* scanner);
+int yylex_destroy(void* scanner);
+
+// Parse one file, pushing each token to the parser as soon as it is scanned
+int check(Checker* ctx, FILE* in)
+{
+  void* scanner;
+  yylex_init_extra(ctx, &scanner);
+  yyset_in(in, scanner);
+
+  yypstate* parser = yypstate_new();
+  int status;
+
+  do
+  {
+    YYSTYPE lval;
+    int token = yylex(&lval, scanner);
+    status = yypush_parse(parser, token, &lval, ctx);
+  } while (status == YYPUSH_MORE);
+
+  yypstate_delete(parser);
+  yylex_destroy(scanner);
+  return status;
+}
+
+/*
+  Only find out whether a file parses, as fast as the lexer and the parser
+  go: the lexer interns no names, and the actions neither touch the symbol
+  table nor report anything but errors, of which there are none to find.
+  The parse stops at the first error, before the token after it is even
+  pushed, so that error is the only diagnostic recorded. Returns 0 if the
+  file parses.
+*/
+int checkSyntax(Checker* ctx, FILE* in)
+{
+  ctx->syntax_only = 1;
+
+  void* scanner;
+  yylex_init_extra(ctx, &scanner);
+  yyset_in(in, scanner);
+
+  yypstate* parser = yypstate_new();
+  int status = YYPUSH_MORE;
+
+  while (status == YYPUSH_MORE && ctx->diag.errors == 0)
+  {
+    YYSTYPE lval;
+    int token = yylex(&lval, scanner);
+    if (ctx->diag.errors == 0)
+      status = yypush_parse(parser, token, &lval, ctx);
+  }
+
+  yypstate_delete(parser);
+  yylex_destroy(scanner);
+  return ctx->diag.errors != 0 || status != 0;
+}
+
+// How the diagnostics of every file are printed
+typedef struct Options
+{
+  int quiet;  // errors only
+  int json;
+  int stats;  // keep statistics of the symbol table
+  int syntax_only;  // only the syntax, and only its first error
+} Options;
+
+// Check one file, or report that in could not be opened, and print its
+// diagnostics to out. Statistics of the symbol table go to stats if
+// options ask for them. Returns 1 if the file has errors.
+int checkFile(const char* path, FILE* in, FILE* out, const Options* options, SymtableStats* stats)
+{
+  Checker ctx;
+  __init__(&ctx, options->quiet || options->syntax_only);
+  if (options->stats)
+  {
+    ctx.stats = stats;
+    statsInit(stats);
+  }
+
+  if (in == NULL)
+    report(&ctx, DIAG_CANNOT_OPEN, path);
+  else if (options->syntax_only)
+    checkSyntax(&ctx, in);
+  else if (check(&ctx, in) == 0 && ctx.syntax_errors == 0)
+    report(&ctx, DIAG_PARSED, NULL);
+
+  if (options->json)
+    diagWriteJson(&ctx.diag, out, path);
+  else
+    diagWriteText(&ctx.diag, out);
+
+  int failed = ctx.diag.errors != 0;
+  __freeMemory__(&ctx);
+  return failed;
+}
+
+// Files of a batch and their messages, kept until printed in order
+typedef struct CheckBatch
+{
+  PathList files;
+  Options options;
+  char** texts;
+  size_t* sizes;
+  int* failed;
+  int failures;
+  SymtableStats* stats;  // of each file, if kept
+  SymtableStats total;
+} CheckBatch;
+
+void runBatchFile(size_t i, void* arg)
+{
+  CheckBatch* batch = (CheckBatch*) arg;
+  FILE* out = open_memstream(&batch->texts[i], &batch->sizes[i]);
+  FILE* in = fopen(batch->files.paths[i], "r");
+
+  batch->failed[i] = checkFile(batch->files.paths[i], in, out, &batch->options, &batch->stats[i]);
+
+  if (in != NULL)
+    fclose(in);
+  fclose(out);
+}
+
+void emitBatchFile(size_t i, void* arg)
+{
+  CheckBatch* batch = (CheckBatch*) arg;
+
+  if (batch->options.json)
+  {
+    printf(i ? ",\n" : "");
+    fwrite(batch->texts[i], 1, batch->sizes[i], stdout);
+  }
+
+  // Quiet runs leave out the files without errors altogether
+  else if (!batch->options.quiet || batch->sizes[i] != 0)
+  {
+    printf("==> %s <==", batch->files.paths[i]);
+    fwrite(batch->texts[i], 1, batch->sizes[i], stdout);
+    printf("\n");
+  }
+
+  free(batch->texts[i]);
+  batch->failures += batch->failed[i];
+  if (batch->options.stats)
+    statsMerge(&batch->total, &batch->stats[i]);
+}
+
+void usage(const char* program)
+{
+  fprintf(stderr, "usage: %s [-q] [-f text|json] [-s] [--syntax-only] file\n", program);
+  fprintf(stderr, "       %s [-q] [-f text|json] [-s] [--syntax-only] [-j threads] [-l listfile] [file|directory]...\n", program);
+}
+
 int main(int argc, char *argv[])
 {
-  yyin = fopen(argv[1],"r");
-  __init__();
-  if (yyparse() == 0)
-      printf("\nParsed successfully.\n");
-
-  fclose(yyin);
-  __freeMemory__();
-  return 0;
+  CheckBatch batch;
+  pathListInit(&batch.files);
+  batch.options.quiet = 0;
+  batch.options.json = 0;
+  batch.options.stats = 0;
+  batch.options.syntax_only = 0;
+  int threads = batchDefaultThreads();
+  int batch_mode = 0;
+  int opt;
+
+  static const struct option long_options[] =
+  {
+    { "syntax-only", no_argument, NULL, 'S' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  while ((opt = getopt_long(argc, argv, "qf:sj:l:", long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 'q':
+        batch.options.quiet = 1;
+        break;
+      case 'f':
+        if (strcmp(optarg, "json") == 0)
+          batch.options.json = 1;
+        else if (strcmp(optarg, "text") != 0)
+        {
+          usage(argv[0]);
+          return 2;
+        }
+        break;
+      case 's':
+        batch.options.stats = 1;
+        break;
+      case 'S':
+        batch.options.syntax_only = 1;
+        break;
+      case 'j':
+        threads = atoi(optarg);
+        batch_mode = 1;
+        break;
+      case 'l':
+        if (pathListRead(&batch.files, optarg) != 0)
+          fprintf(stderr, "%s: cannot read all of %s\n", argv[0], optarg);
+        batch_mode = 1;
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+
+  for (int i = optind; i < argc; i++)
+    if (pathListAdd(&batch.files, argv[i]) != 0)
+      fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[i]);
+
+  // A single file named on its own is checked as it always was
+  if (!batch_mode && argc - optind == 1 && batch.files.count == 1
+      && strcmp(batch.files.paths[0], argv[optind]) == 0)
+  {
+    FILE* in = fopen(argv[optind], "r");
+    int failed = checkFile(argv[optind], in, stdout, &batch.options, &batch.total);
+    if (batch.options.json)
+      printf("\n");
+    if (batch.options.stats)
+      statsPrint(&batch.total, "group", stderr);
+    if (in != NULL)
+      fclose(in);
+    pathListFree(&batch.files);
+
+    // An editor asking whether the program parses goes by the status
+    return batch.options.syntax_only && failed;
+  }
+
+  if (batch.files.count == 0 && !batch_mode)
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  batch.texts = (char**) calloc(batch.files.count, sizeof(char*));
+  batch.sizes = (size_t*) calloc(batch.files.count, sizeof(size_t));
+  batch.failed = (int*) calloc(batch.files.count, sizeof(int));
+  batch.failures = 0;
+  batch.stats = (SymtableStats*) calloc(batch.files.count, sizeof(SymtableStats));
+  statsInit(&batch.total);
+
+  if (batch.options.json)
+    printf("[\n");
+  batchRun(batch.files.count, threads, runBatchFile, emitBatchFile, &batch);
+  if (batch.options.json)
+    printf("\n]\n");
+  fprintf(stderr, "%d of %zu files failed\n", batch.failures, batch.files.count);
+  if (batch.options.stats)
+    statsPrint(&batch.total, "group", stderr);
+
+  free(batch.texts);
+  free(batch.sizes);
+  free(batch.failed);
+  free(batch.stats);
+  pathListFree(&batch.files);
+  return batch.failures != 0;
 }
 
-void yyerror(char* msg)
+void yyerror(Checker* ctx, char* msg)
 {
-  printf("\nParsing failed in line %d %s\n", yylineno, msg);
-  success = 0;
+  report(ctx, DIAG_SYNTAX, msg);
 }
@@ -0,0 +1,25 @@
+# Writes a program with lists of n items for "make stress", run as
+#   awk -v n=10000 -f stress.awk
+# One declaration of n variables, a call with n arguments, an expression
+# of n terms and n blocks side by side in main, then a function with n
+# parameters and n more functions.
+function list(prefix, sep, count,   i, text, end) {
+  end = sep;
+  sub(/ +$/, "", end);
+  text = prefix 0;
+  for (i = 1; i < count; i++)
+    text = text (i % 10 == 0 ? end "\n    " : sep) prefix i;
+  return text;
+}
+BEGIN {
+  print "int main()\n{";
+  print "  int " list("v", ", ", n) ";";
+  print "  v0 = " list("v", " + ", n) ";";
+  print "  g(" list("v", ", ", n) ");";
+  for (i = 0; i < n; i++)
+    print "  {\n    int t" i ";\n    t" i " = v" i ";\n  }";
+  print "}";
+  print "int g(" list("int p", ", ", n) ")\n{\n  return p0;\n}";
+  for (i = 0; i < n; i++)
+    print "int f" i "()\n{\n  return 0;\n}";
+}
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "symtable.h"
+
+// Control byte values. A full slot stores H2 of its hash (0..127).
+#define CTRL_EMPTY ((int8_t) -128)
+
+#define INITIAL_CAPACITY GROUP_WIDTH
+
+// Upper bits of the hash select the starting group, lower 7 bits are
+// kept in the control byte.
+#define H1(hash) ((size_t) ((hash) >> 7))
+#define H2(hash) ((int8_t) ((hash) & 0x7f))
+
+// Bitmask with bit i set if control byte i of the group equals byte
+static unsigned matchByte(const int8_t* group, int8_t byte)
+{
+#ifdef __SSE2__
+  __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+  return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+#else
+  unsigned mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++)
+    if (group[i] == byte)
+      mask |= 1u << i;
+  return mask;
+#endif
+}
+
+// Set a control byte, keeping the cloned bytes past the end in sync so
+// that a group can be loaded from any slot without wrapping around.
+static void setCtrl(Symtable* table, size_t i, int8_t byte)
+{
+  table->ctrl[i] = byte;
+  if (i < GROUP_WIDTH)
+    table->ctrl[table->capacity + i] = byte;
+}
+
+static void allocate(Symtable* table, size_t capacity)
+{
+  table->ctrl = (int8_t*) malloc(capacity + GROUP_WIDTH);
+  memset(table->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+  table->slots = (Symbol*) malloc(capacity * sizeof(Symbol));
+  table->capacity = capacity;
+  table->size = 0;
+}
+
+// First EMPTY slot on the probe sequence of hash
+static size_t findEmpty(const Symtable* table, uint64_t hash)
+{
+  size_t mask = table->capacity - 1;
+  size_t pos = H1(hash) & mask;
+  size_t stride = 0;
+
+  for (;;)
+  {
+    unsigned empty = matchByte(table->ctrl + pos, CTRL_EMPTY);
+    if (empty)
+      return (pos + __builtin_ctz(empty)) & mask;
+
+    // Triangular probing visits every group once when capacity is a power of two
+    stride += GROUP_WIDTH;
+    pos = (pos + stride) & mask;
+  }
+}
+
+// Rebuild the table with twice the capacity
+static void grow(Symtable* table)
+{
+  Symtable old = *table;
+  allocate(table, 2 * old.capacity);
+
+  for (size_t i = 0; i < old.capacity; i++)
+  {
+    if (old.ctrl[i] < 0)
+      continue;
+
+    size_t j = findEmpty(table, symtableHash(old.slots[i].name));
+    setCtrl(table, j, old.ctrl[i]);
+    table->slots[j] = old.slots[i];
+    table->size++;
+  }
+
+  free(old.ctrl);
+  free(old.slots);
+}
+
+/*
+  Atoms are small consecutive integers, so they are spread over the whole
+  64-bit range with the murmur3 finalizer before use.
+*/
+uint64_t symtableHash(Atom name)
+{
+  uint64_t hash = name;
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+void symtableInit(Symtable* table)
+{
+  allocate(table, INITIAL_CAPACITY);
+}
+
+void symtableFree(Symtable* table)
+{
+  free(table->ctrl);
+  free(table->slots);
+  table->ctrl = NULL;
+  table->slots = NULL;
+  table->capacity = table->size = 0;
+}
+
+Symbol* symtableInsert(Symtable* table, Atom name, Atom fname, int dtype, int scope)
+{
+  // Keep at least 1/8 of the slots EMPTY so that every probe terminates
+  if ((table->size + 1) * 8 > table->capacity * 7)
+    grow(table);
+
+  uint64_t hash = symtableHash(name);
+  size_t i = findEmpty(table, hash);
+
+  setCtrl(table, i, H2(hash));
+  table->size++;
+
+  Symbol* symbol = &table->slots[i];
+  symbol->name = name;
+  symbol->fname = fname;
+  symbol->dtype = dtype;
+  symbol->scope = scope;
+  return symbol;
+}
+
+// Whether symbol satisfies the lookup made from scope of function fname.
+// An exact lookup passes the wanted datatype, a visibility lookup -1.
+static int matches(const Symbol* symbol, Atom fname, int scope, int dtype)
+{
+  if (dtype >= 0)
+    return symbol->scope == scope && symbol->dtype == dtype && symbol->fname == fname;
+
+  return symbol->scope == 0 || (symbol->scope <= scope && symbol->fname == fname);
+}
+
+// Walk every symbol named name and return the first one that matches,
+// counting the groups probed in *groups
+static Symbol* find(const Symtable* table, Atom name, Atom fname, int scope, int dtype, size_t* groups)
+{
+  uint64_t hash = symtableHash(name);
+  size_t mask = table->capacity - 1;
+  size_t pos = H1(hash) & mask;
+  size_t stride = 0;
+
+  for (*groups = 1;; ++*groups)
+  {
+    const int8_t* group = table->ctrl + pos;
+    unsigned candidates = matchByte(group, H2(hash));
+
+    while (candidates)
+    {
+      Symbol* symbol = &table->slots[(pos + __builtin_ctz(candidates)) & mask];
+      candidates &= candidates - 1;
+
+      if (symbol->name == name && matches(symbol, fname, scope, dtype))
+        return symbol;
+    }
+
+    // An EMPTY byte ends every probe sequence passing through this group
+    if (matchByte(group, CTRL_EMPTY))
+      return NULL;
+
+    stride += GROUP_WIDTH;
+    pos = (pos + stride) & mask;
+  }
+}
+
+Symbol* symtableLookupVisible(const Symtable* table, Atom name, Atom fname, int scope)
+{
+  size_t groups;
+  return find(table, name, fname, scope, -1, &groups);
+}
+
+Symbol* symtableLookupInScope(const Symtable* table, Atom name, Atom fname,
+                              int scope, int dtype)
+{
+  size_t groups;
+  return find(table, name, fname, scope, dtype, &groups);
+}
+
+size_t symtableProbes(const Symtable* table, Atom name, Atom fname, int scope, int dtype)
+{
+  size_t groups;
+  find(table, name, fname, scope, dtype, &groups);
+  return groups;
+}
@@ -0,0 +1,61 @@
+#ifndef SYMTABLE_H
+#define SYMTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "intern.h"
+
+// Number of control bytes examined together while probing
+#define GROUP_WIDTH 16
+
+// Structure for a symbol's entry in a symbol table
+typedef struct Symbol
+{
+  Atom name;         // name of the identifier
+  Atom fname;        // function the symbol is declared in
+  int dtype;         // 0 for int; 1 for float
+  int scope;         // scope of this symbol
+} Symbol;
+
+/*
+  Symbol table structure.
+
+  Open addressing in the style of a Swiss table: every slot has a control
+  byte which is either EMPTY or the low 7 bits of the hash of the Atom of
+  the symbol stored there. Lookups compare GROUP_WIDTH control bytes at once
+  and only touch the slots whose control byte matches. Symbols are stored
+  inline in the slot array, and the table doubles once it is 7/8 full.
+
+  The same name may be present in several functions and scopes.
+*/
+typedef struct Symtable
+{
+  int8_t* ctrl;      // capacity + GROUP_WIDTH control bytes
+  Symbol* slots;     // capacity symbols
+  size_t capacity;   // power of two, at least GROUP_WIDTH
+  size_t size;       // number of symbols
+} Symtable;
+
+void symtableInit(Symtable* table);
+void symtableFree(Symtable* table);
+
+uint64_t symtableHash(Atom name);
+
+// Add a symbol
+Symbol* symtableInsert(Symtable* table, Atom name, Atom fname, int dtype, int scope);
+
+// Symbol visible as name from scope of function fname: either a global or
+// one declared in fname at scope or an enclosing one. NULL if none.
+Symbol* symtableLookupVisible(const Symtable* table, Atom name, Atom fname, int scope);
+
+// Symbol with the given name and datatype declared exactly in scope of
+// fname, or NULL
+Symbol* symtableLookupInScope(const Symtable* table, Atom name, Atom fname,
+                              int scope, int dtype);
+
+// Number of groups probed by one of the lookups above, for statistics;
+// dtype is -1 for symtableLookupVisible
+size_t symtableProbes(const Symtable* table, Atom name, Atom fname, int scope, int dtype);
+
+#endif
@@ -0,0 +1,719 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+
+#define INITIAL_CAPACITY 64
+
+// Make room for one more item in a vector, returning its index
+static NodeId grow(void** items, uint32_t* count, uint32_t* capacity, size_t size)
+{
+  if (*count == *capacity)
+  {
+    *capacity = *capacity ? 2 * *capacity : INITIAL_CAPACITY;
+    *items = realloc(*items, *capacity * size);
+  }
+
+  return (*count)++;
+}
+
+#define PUSH(vector) grow((void**) &(vector).items, &(vector).count, &(vector).capacity, sizeof(*(vector).items))
+
+#define FREE(vector) free((vector).items)
+
+void astInit(Ast* ast)
+{
+  memset(ast, 0, sizeof(Ast));
+  ast->main = NO_NODE;
+  ast->functions = NO_NODE;
+}
+
+void astFree(Ast* ast)
+{
+  FREE(ast->types);
+  FREE(ast->exprs);
+  FREE(ast->vars);
+  FREE(ast->assigns);
+  FREE(ast->args);
+  FREE(ast->calls);
+  FREE(ast->conds);
+  FREE(ast->iters);
+  FREE(ast->ifs);
+  FREE(ast->stmts);
+  FREE(ast->blocks);
+  FREE(ast->params);
+  FREE(ast->funcs);
+  astInit(ast);
+}
+
+NodeId astType(Ast* ast, int line, int dtype)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->types);
+  AstType* node = &ast->types.items[id];
+  node->dtype = dtype;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+NodeId astExpr(Ast* ast, int line, ExprKind kind, char op, NodeId lhs, NodeId rhs, Atom name)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->exprs);
+  AstExpr* node = &ast->exprs.items[id];
+  node->kind = kind;
+  node->op = op;
+  node->line = line;
+  node->seq = ast->seq++;
+  node->lhs = lhs;
+  node->rhs = rhs;
+  node->name = name;
+  return id;
+}
+
+NodeId astArraySize(Ast* ast, int line, ArraySize size, int length)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->vars);
+  AstVar* node = &ast->vars.items[id];
+  node->name = NO_NAME;
+  node->array = size;
+  node->length = length;
+  node->array_line = line;
+  node->array_seq = ast->seq++;
+  node->line = line;
+  node->seq = node->array_seq;
+  node->next = NO_NODE;
+  return id;
+}
+
+NodeId astVar(Ast* ast, int line, NodeId var, Atom name, NodeId next)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  AstVar* node = &ast->vars.items[var];
+  node->name = name;
+  node->line = line;
+  node->seq = ast->seq++;
+  node->next = next;
+  return var;
+}
+
+NodeId astAssign(Ast* ast, int line, Atom name, NodeId expr)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->assigns);
+  AstAssign* node = &ast->assigns.items[id];
+  node->name = name;
+  node->expr = expr;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+NodeId astArg(Ast* ast, int line, ArgKind kind, Atom name)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->args);
+  AstArg* node = &ast->args.items[id];
+  node->kind = kind;
+  node->name = name;
+  node->line = line;
+  node->seq = ast->seq++;
+  node->next = NO_NODE;
+  return id;
+}
+
+NodeId astCall(Ast* ast, int line, Atom function, NodeId args)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->calls);
+  AstCall* node = &ast->calls.items[id];
+  node->function = function;
+  node->args = args;
+  node->target = NO_NAME;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+void astCallTarget(Ast* ast, int line, NodeId call, Atom target)
+{
+  if (ast->discard)
+    return;
+
+  AstCall* node = &ast->calls.items[call];
+  node->target = target;
+  node->line = line;
+  node->seq = ast->seq++;
+}
+
+NodeId astCond(Ast* ast, int line, int relop, NodeId lhs, NodeId rhs)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->conds);
+  AstCond* node = &ast->conds.items[id];
+  node->relop = relop;
+  node->logic = 0;
+  node->lhs = lhs;
+  node->rhs = rhs;
+  node->next = NO_NODE;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+NodeId astIter(Ast* ast, int line, IterKind kind, NodeId init, NodeId cond, NodeId step, NodeId body)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->iters);
+  AstIter* node = &ast->iters.items[id];
+  node->kind = kind;
+  node->init = init;
+  node->cond = cond;
+  node->step = step;
+  node->body = body;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+NodeId astIf(Ast* ast, int line, NodeId cond, NodeId then_body, NodeId else_body)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->ifs);
+  AstIf* node = &ast->ifs.items[id];
+  node->cond = cond;
+  node->then_body = then_body;
+  node->else_body = else_body;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+NodeId astStmt(Ast* ast, int line, StmtKind kind, NodeId a, NodeId b)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->stmts);
+  AstStmt* node = &ast->stmts.items[id];
+  node->kind = kind;
+  node->a = a;
+  node->b = b;
+  node->next = NO_NODE;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+NodeId astOpenBlock(Ast* ast, int line)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->blocks);
+  AstBlock* node = &ast->blocks.items[id];
+  node->first = NO_NODE;
+  node->closed = 0;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+void astCloseBlock(Ast* ast, NodeId block, NodeId first)
+{
+  if (ast->discard)
+    return;
+
+  ast->blocks.items[block].first = first;
+  ast->blocks.items[block].closed = 1;
+}
+
+NodeId astParam(Ast* ast, int line, NodeId type, Atom name)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->params);
+  AstParam* node = &ast->params.items[id];
+  node->type = type;
+  node->name = name;
+  node->line = line;
+  node->seq = ast->seq++;
+  node->next = NO_NODE;
+  return id;
+}
+
+NodeId astFunc(Ast* ast, int line, NodeId type, Atom name, NodeId params, NodeId body)
+{
+  if (ast->discard)
+    return NO_NODE;
+
+  NodeId id = PUSH(ast->funcs);
+  AstFunc* node = &ast->funcs.items[id];
+  node->type = type;
+  node->name = name;
+  node->params = params;
+  node->body = body;
+  node->next = NO_NODE;
+  node->line = line;
+  node->seq = ast->seq++;
+  return id;
+}
+
+AstList astAppendStmt(Ast* ast, AstList list, NodeId stmt)
+{
+  // A statement the parser recovered from has no node
+  if (stmt == NO_NODE)
+    return list;
+
+  if (list.first == NO_NODE)
+    list.first = stmt;
+  else
+    ast->stmts.items[list.last].next = stmt;
+
+  list.last = stmt;
+  return list;
+}
+
+AstList astConcatStmts(Ast* ast, AstList head, AstList tail)
+{
+  if (head.first == NO_NODE)
+    return tail;
+  if (tail.first == NO_NODE)
+    return head;
+
+  ast->stmts.items[head.last].next = tail.first;
+  head.last = tail.last;
+  return head;
+}
+
+AstList astAppendArg(Ast* ast, AstList list, NodeId arg)
+{
+  if (list.first == NO_NODE)
+    list.first = arg;
+  else
+    ast->args.items[list.last].next = arg;
+
+  list.last = arg;
+  return list;
+}
+
+AstList astAppendCond(Ast* ast, AstList list, int logic, NodeId cond)
+{
+  if (list.first == NO_NODE)
+    list.first = cond;
+  else
+  {
+    ast->conds.items[list.last].logic = logic;
+    ast->conds.items[list.last].next = cond;
+  }
+
+  list.last = cond;
+  return list;
+}
+
+AstList astAppendParam(Ast* ast, AstList list, NodeId param)
+{
+  if (list.first == NO_NODE)
+    list.first = param;
+  else
+    ast->params.items[list.last].next = param;
+
+  list.last = param;
+  return list;
+}
+
+AstList astAppendFunc(Ast* ast, AstList list, NodeId func)
+{
+  if (list.first == NO_NODE)
+    list.first = func;
+  else
+    ast->funcs.items[list.last].next = func;
+
+  list.last = func;
+  return list;
+}
+
+void astProgram(Ast* ast, NodeId main, NodeId functions)
+{
+  ast->main = main;
+  ast->functions = functions;
+  ast->complete = 1;
+}
+
+// Walk of the tree with the callbacks of one pass
+typedef struct Walk
+{
+  const Ast* ast;
+  const AstVisitor* visitor;
+  void* arg;
+} Walk;
+
+#define CALLBACK(walk, name, id) \
+  do { if ((walk)->visitor->name) (walk)->visitor->name((walk)->arg, (id)); } while (0)
+
+static void visitBlock(const Walk* walk, NodeId id);
+
+static void visitExpr(const Walk* walk, NodeId id)
+{
+  const AstExpr* node = &walk->ast->exprs.items[id];
+  if (node->lhs != NO_NODE)
+    visitExpr(walk, node->lhs);
+  if (node->rhs != NO_NODE)
+    visitExpr(walk, node->rhs);
+  CALLBACK(walk, expr, id);
+}
+
+// Variables of a declaration are named from the last one backwards
+static void visitVars(const Walk* walk, NodeId id)
+{
+  if (walk->ast->vars.items[id].next != NO_NODE)
+    visitVars(walk, walk->ast->vars.items[id].next);
+  CALLBACK(walk, var, id);
+}
+
+static void visitAssign(const Walk* walk, NodeId id)
+{
+  visitExpr(walk, walk->ast->assigns.items[id].expr);
+  CALLBACK(walk, assign, id);
+}
+
+static void visitArgs(const Walk* walk, NodeId id)
+{
+  for (; id != NO_NODE; id = walk->ast->args.items[id].next)
+    CALLBACK(walk, arg, id);
+}
+
+static void visitCall(const Walk* walk, NodeId id)
+{
+  visitArgs(walk, walk->ast->calls.items[id].args);
+  CALLBACK(walk, call, id);
+}
+
+static void visitConds(const Walk* walk, NodeId id)
+{
+  for (; id != NO_NODE; id = walk->ast->conds.items[id].next)
+  {
+    visitExpr(walk, walk->ast->conds.items[id].lhs);
+    visitExpr(walk, walk->ast->conds.items[id].rhs);
+    CALLBACK(walk, cond, id);
+  }
+}
+
+static void visitIter(const Walk* walk, NodeId id)
+{
+  const AstIter* node = &walk->ast->iters.items[id];
+
+  if (node->kind == ITER_DO)
+  {
+    visitBlock(walk, node->body);
+    visitConds(walk, node->cond);
+    return;
+  }
+
+  if (node->init != NO_NODE)
+    visitAssign(walk, node->init);
+  visitConds(walk, node->cond);
+  if (node->step != NO_NODE)
+    visitExpr(walk, node->step);
+  visitBlock(walk, node->body);
+}
+
+static void visitIf(const Walk* walk, NodeId id)
+{
+  const AstIf* node = &walk->ast->ifs.items[id];
+  visitConds(walk, node->cond);
+  visitBlock(walk, node->then_body);
+  if (node->else_body != NO_NODE)
+    visitBlock(walk, node->else_body);
+}
+
+static void visitStmt(const Walk* walk, NodeId id)
+{
+  const AstStmt* node = &walk->ast->stmts.items[id];
+
+  switch (node->kind)
+  {
+    case STMT_RETURN:
+      visitExpr(walk, node->a);
+      break;
+    case STMT_DECLARATION:
+      CALLBACK(walk, type, node->a);
+      visitVars(walk, node->b);
+      break;
+    case STMT_ASSIGN:
+      visitAssign(walk, node->a);
+      break;
+    case STMT_CALL:
+      visitCall(walk, node->a);
+      break;
+    case STMT_ITER:
+      visitIter(walk, node->a);
+      break;
+    case STMT_IF:
+      visitIf(walk, node->a);
+      break;
+    case STMT_BLOCK:
+      visitBlock(walk, node->a);
+      break;
+  }
+
+  CALLBACK(walk, stmt, id);
+}
+
+static void visitStmts(const Walk* walk, NodeId id)
+{
+  for (; id != NO_NODE; id = walk->ast->stmts.items[id].next)
+    visitStmt(walk, id);
+}
+
+static void visitBlock(const Walk* walk, NodeId id)
+{
+  const AstBlock* node = &walk->ast->blocks.items[id];
+  CALLBACK(walk, enterBlock, id);
+  visitStmts(walk, node->first);
+  if (node->closed)
+    CALLBACK(walk, exitBlock, id);
+}
+
+static void visitParams(const Walk* walk, NodeId id)
+{
+  for (; id != NO_NODE; id = walk->ast->params.items[id].next)
+  {
+    CALLBACK(walk, type, walk->ast->params.items[id].type);
+    CALLBACK(walk, param, id);
+  }
+}
+
+static void visitFuncs(const Walk* walk, NodeId id)
+{
+  for (; id != NO_NODE; id = walk->ast->funcs.items[id].next)
+  {
+    const AstFunc* node = &walk->ast->funcs.items[id];
+    CALLBACK(walk, type, node->type);
+    visitParams(walk, node->params);
+    visitBlock(walk, node->body);
+    CALLBACK(walk, func, id);
+  }
+}
+
+/*
+  Visiting what a failed parse left behind. Every node not referenced by
+  another one was still on the parser's stack, and since each of them was
+  built after everything to its left, visiting them in the order they were
+  built replays the parse up to the error.
+*/
+typedef enum RootKind
+{
+  ROOT_TYPE, ROOT_EXPR, ROOT_VAR, ROOT_ASSIGN, ROOT_ARG, ROOT_CALL, ROOT_COND,
+  ROOT_ITER, ROOT_IF, ROOT_STMT, ROOT_BLOCK, ROOT_PARAM, ROOT_FUNC, ROOT_KINDS
+} RootKind;
+
+typedef struct Root
+{
+  uint32_t seq;
+  uint8_t kind;
+  NodeId id;
+} Root;
+
+#define MARK(marks, kind, id) do { if ((id) != NO_NODE) (marks)[kind][id] = 1; } while (0)
+
+static int compareRoots(const void* a, const void* b)
+{
+  const Root* x = (const Root*) a;
+  const Root* y = (const Root*) b;
+  return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// The nodes of different roots were built one root after the other, so
+// the sequence number of the root itself orders them
+static uint32_t rootSeq(const Ast* ast, RootKind kind, NodeId id)
+{
+  switch (kind)
+  {
+    case ROOT_TYPE:   return ast->types.items[id].seq;
+    case ROOT_EXPR:   return ast->exprs.items[id].seq;
+    case ROOT_VAR:    return ast->vars.items[id].seq;
+    case ROOT_ASSIGN: return ast->assigns.items[id].seq;
+    case ROOT_ARG:    return ast->args.items[id].seq;
+    case ROOT_CALL:   return ast->calls.items[id].seq;
+    case ROOT_COND:   return ast->conds.items[id].seq;
+    case ROOT_ITER:   return ast->iters.items[id].seq;
+    case ROOT_IF:     return ast->ifs.items[id].seq;
+    case ROOT_STMT:   return ast->stmts.items[id].seq;
+    case ROOT_BLOCK:  return ast->blocks.items[id].seq;
+    case ROOT_PARAM:  return ast->params.items[id].seq;
+    default:          return ast->funcs.items[id].seq;
+  }
+}
+
+static void visitForest(const Walk* walk)
+{
+  const Ast* ast = walk->ast;
+  uint32_t counts[ROOT_KINDS] =
+  {
+    ast->types.count, ast->exprs.count, ast->vars.count, ast->assigns.count,
+    ast->args.count, ast->calls.count, ast->conds.count, ast->iters.count,
+    ast->ifs.count, ast->stmts.count, ast->blocks.count, ast->params.count,
+    ast->funcs.count
+  };
+
+  uint8_t* marks[ROOT_KINDS];
+  size_t total = 0;
+  for (int k = 0; k < ROOT_KINDS; k++)
+  {
+    marks[k] = (uint8_t*) calloc(counts[k] + 1, 1);
+    total += counts[k];
+  }
+
+  // Mark every node some other node refers to
+  for (uint32_t i = 0; i < ast->exprs.count; i++)
+  {
+    MARK(marks, ROOT_EXPR, ast->exprs.items[i].lhs);
+    MARK(marks, ROOT_EXPR, ast->exprs.items[i].rhs);
+  }
+  for (uint32_t i = 0; i < ast->vars.count; i++)
+    MARK(marks, ROOT_VAR, ast->vars.items[i].next);
+  for (uint32_t i = 0; i < ast->assigns.count; i++)
+    MARK(marks, ROOT_EXPR, ast->assigns.items[i].expr);
+  for (uint32_t i = 0; i < ast->args.count; i++)
+    MARK(marks, ROOT_ARG, ast->args.items[i].next);
+  for (uint32_t i = 0; i < ast->calls.count; i++)
+    MARK(marks, ROOT_ARG, ast->calls.items[i].args);
+  for (uint32_t i = 0; i < ast->conds.count; i++)
+  {
+    MARK(marks, ROOT_EXPR, ast->conds.items[i].lhs);
+    MARK(marks, ROOT_EXPR, ast->conds.items[i].rhs);
+    MARK(marks, ROOT_COND, ast->conds.items[i].next);
+  }
+  for (uint32_t i = 0; i < ast->iters.count; i++)
+  {
+    MARK(marks, ROOT_ASSIGN, ast->iters.items[i].init);
+    MARK(marks, ROOT_COND, ast->iters.items[i].cond);
+    MARK(marks, ROOT_EXPR, ast->iters.items[i].step);
+    MARK(marks, ROOT_BLOCK, ast->iters.items[i].body);
+  }
+  for (uint32_t i = 0; i < ast->ifs.count; i++)
+  {
+    MARK(marks, ROOT_COND, ast->ifs.items[i].cond);
+    MARK(marks, ROOT_BLOCK, ast->ifs.items[i].then_body);
+    MARK(marks, ROOT_BLOCK, ast->ifs.items[i].else_body);
+  }
+  for (uint32_t i = 0; i < ast->stmts.count; i++)
+  {
+    static const RootKind child[] =
+    {
+      [STMT_RETURN] = ROOT_EXPR, [STMT_DECLARATION] = ROOT_TYPE, [STMT_ASSIGN] = ROOT_ASSIGN,
+      [STMT_CALL] = ROOT_CALL, [STMT_ITER] = ROOT_ITER, [STMT_IF] = ROOT_IF, [STMT_BLOCK] = ROOT_BLOCK
+    };
+    const AstStmt* node = &ast->stmts.items[i];
+    MARK(marks, child[node->kind], node->a);
+    if (node->kind == STMT_DECLARATION)
+      MARK(marks, ROOT_VAR, node->b);
+    MARK(marks, ROOT_STMT, node->next);
+  }
+  for (uint32_t i = 0; i < ast->blocks.count; i++)
+    MARK(marks, ROOT_STMT, ast->blocks.items[i].first);
+  for (uint32_t i = 0; i < ast->params.count; i++)
+  {
+    MARK(marks, ROOT_TYPE, ast->params.items[i].type);
+    MARK(marks, ROOT_PARAM, ast->params.items[i].next);
+  }
+  for (uint32_t i = 0; i < ast->funcs.count; i++)
+  {
+    MARK(marks, ROOT_TYPE, ast->funcs.items[i].type);
+    MARK(marks, ROOT_PARAM, ast->funcs.items[i].params);
+    MARK(marks, ROOT_BLOCK, ast->funcs.items[i].body);
+    MARK(marks, ROOT_FUNC, ast->funcs.items[i].next);
+  }
+
+  Root* roots = (Root*) malloc((total + 1) * sizeof(Root));
+  size_t count = 0;
+  for (int k = 0; k < ROOT_KINDS; k++)
+    for (uint32_t i = 0; i < counts[k]; i++)
+      if (!marks[k][i])
+      {
+        roots[count].seq = rootSeq(ast, (RootKind) k, i);
+        roots[count].kind = (uint8_t) k;
+        roots[count].id = i;
+        count++;
+      }
+
+  qsort(roots, count, sizeof(Root), compareRoots);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    NodeId id = roots[i].id;
+    switch (roots[i].kind)
+    {
+      case ROOT_TYPE:   CALLBACK(walk, type, id); break;
+      case ROOT_EXPR:   visitExpr(walk, id); break;
+      case ROOT_VAR:    visitVars(walk, id); break;
+      case ROOT_ASSIGN: visitAssign(walk, id); break;
+      case ROOT_ARG:    visitArgs(walk, id); break;
+      case ROOT_CALL:   visitCall(walk, id); break;
+      case ROOT_COND:   visitConds(walk, id); break;
+      case ROOT_ITER:   visitIter(walk, id); break;
+      case ROOT_IF:     visitIf(walk, id); break;
+      case ROOT_STMT:   visitStmts(walk, id); break;
+      case ROOT_BLOCK:  visitBlock(walk, id); break;
+      case ROOT_PARAM:  visitParams(walk, id); break;
+      case ROOT_FUNC:   visitFuncs(walk, id); break;
+    }
+  }
+
+  free(roots);
+  for (int k = 0; k < ROOT_KINDS; k++)
+    free(marks[k]);
+}
+
+void astVisit(const Ast* ast, const AstVisitor* visitor, void* arg)
+{
+  Walk walk = { ast, visitor, arg };
+
+  if (!ast->complete)
+  {
+    visitForest(&walk);
+    return;
+  }
+
+  visitFuncs(&walk, ast->main);
+  visitFuncs(&walk, ast->functions);
+}
+
+void astVisitSignature(const Ast* ast, NodeId func, const AstVisitor* visitor, void* arg)
+{
+  Walk walk = { ast, visitor, arg };
+  const AstFunc* node = &ast->funcs.items[func];
+
+  CALLBACK(&walk, type, node->type);
+  visitParams(&walk, node->params);
+}
+
+void astVisitBlock(const Ast* ast, NodeId block, const AstVisitor* visitor, void* arg)
+{
+  Walk walk = { ast, visitor, arg };
+  visitBlock(&walk, block);
+}
@@ -0,0 +1,318 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stdint.h>
+
+#include "intern.h"
+
+/*
+  Abstract syntax tree built by the parser.
+
+  Nodes of each kind live in their own contiguous vector, and refer to
+  their children by 32-bit index into the vector of the child's kind, so
+  the tree is a handful of flat arrays that are allocated in large steps
+  and freed at once. Lists (statements of a block, variables of a
+  declaration, ...) are chained through the next field of their items.
+
+  Every node records the line the parser was on when it built the node,
+  and a sequence number: nodes are numbered in the order they were built,
+  which is the order the parser reduced them in. A pass can use it to
+  place its messages where the parser would have reported them.
+*/
+typedef uint32_t NodeId;
+
+// Index of no node
+#define NO_NODE UINT32_MAX
+
+// Name of no identifier
+#define NO_NAME UINT32_MAX
+
+// DATATYPE
+typedef struct AstType
+{
+  int dtype;          // 0 for int; 1 for float
+  int line;
+  uint32_t seq;
+} AstType;
+
+typedef enum ExprKind
+{
+  EXPR_INT,
+  EXPR_REAL,
+  EXPR_ID,
+  EXPR_PAREN,         // lhs
+  EXPR_BINARY,        // lhs op rhs
+  EXPR_INCREMENT,     // name++ in a for loop
+  EXPR_DECREMENT      // name-- in a for loop
+} ExprKind;
+
+typedef struct AstExpr
+{
+  uint8_t kind;
+  char op;            // '+', '-', '*', '/' or '%'
+  int line;
+  uint32_t seq;
+  NodeId lhs;
+  NodeId rhs;
+  Atom name;
+} AstExpr;
+
+typedef enum ArraySize
+{
+  ARRAY_NONE,
+  ARRAY_INT,
+  ARRAY_REAL
+} ArraySize;
+
+// One variable of a declaration. It is built when its array size has
+// been parsed and named later, so a syntax error can leave it NO_NAME.
+typedef struct AstVar
+{
+  Atom name;
+  uint8_t array;      // ArraySize
+  int length;         // of an ARRAY_INT
+  int line;
+  uint32_t seq;
+  int array_line;     // where the array size was parsed
+  uint32_t array_seq;
+  NodeId next;
+} AstVar;
+
+typedef struct AstAssign
+{
+  Atom name;
+  NodeId expr;
+  int line;
+  uint32_t seq;
+} AstAssign;
+
+typedef enum ArgKind
+{
+  ARG_ID,
+  ARG_INT,
+  ARG_REAL
+} ArgKind;
+
+// Actual parameter of a function call
+typedef struct AstArg
+{
+  uint8_t kind;       // ArgKind
+  Atom name;
+  int line;
+  uint32_t seq;
+  NodeId next;
+} AstArg;
+
+typedef struct AstCall
+{
+  Atom function;
+  NodeId args;
+  Atom target;        // variable assigned the result, or NO_NAME
+  int line;           // where the call, or its assignment, was parsed
+  uint32_t seq;
+} AstCall;
+
+// Comparison in a condition, joined to the next one by logic
+typedef struct AstCond
+{
+  int relop;          // token of the relational operator
+  int logic;          // AND_TOK or OR_TOK, if next is set
+  NodeId lhs;
+  NodeId rhs;
+  NodeId next;
+  int line;
+  uint32_t seq;
+} AstCond;
+
+typedef enum IterKind
+{
+  ITER_FOR,
+  ITER_WHILE,
+  ITER_DO
+} IterKind;
+
+typedef struct AstIter
+{
+  uint8_t kind;       // IterKind
+  NodeId init;        // assign, for loops only
+  NodeId cond;
+  NodeId step;        // expr, for loops only
+  NodeId body;        // block
+  int line;
+  uint32_t seq;
+} AstIter;
+
+typedef struct AstIf
+{
+  NodeId cond;
+  NodeId then_body;   // block
+  NodeId else_body;   // block, or NO_NODE
+  int line;
+  uint32_t seq;
+} AstIf;
+
+typedef enum StmtKind
+{
+  STMT_RETURN,        // a: expr
+  STMT_DECLARATION,   // a: type, b: first var
+  STMT_ASSIGN,        // a: assign
+  STMT_CALL,          // a: call
+  STMT_ITER,          // a: iter
+  STMT_IF,            // a: if
+  STMT_BLOCK          // a: block
+} StmtKind;
+
+typedef struct AstStmt
+{
+  uint8_t kind;       // StmtKind
+  NodeId a;
+  NodeId b;
+  NodeId next;
+  int line;
+  uint32_t seq;
+} AstStmt;
+
+/*
+  A block is built when its scope opens, and closed with its statements
+  once its end has been parsed. The body of a loop or if without braces is
+  a block of one statement.
+*/
+typedef struct AstBlock
+{
+  NodeId first;       // stmt
+  int closed;
+  int line;
+  uint32_t seq;
+} AstBlock;
+
+// Formal parameter of a function
+typedef struct AstParam
+{
+  NodeId type;
+  Atom name;
+  int line;
+  uint32_t seq;
+  NodeId next;
+} AstParam;
+
+typedef struct AstFunc
+{
+  NodeId type;
+  Atom name;          // NO_NAME for main
+  NodeId params;
+  NodeId body;        // block
+  NodeId next;
+  int line;
+  uint32_t seq;
+} AstFunc;
+
+#define AST_VECTOR(type) struct { type* items; uint32_t count; uint32_t capacity; }
+
+typedef struct Ast
+{
+  AST_VECTOR(AstType) types;
+  AST_VECTOR(AstExpr) exprs;
+  AST_VECTOR(AstVar) vars;
+  AST_VECTOR(AstAssign) assigns;
+  AST_VECTOR(AstArg) args;
+  AST_VECTOR(AstCall) calls;
+  AST_VECTOR(AstCond) conds;
+  AST_VECTOR(AstIter) iters;
+  AST_VECTOR(AstIf) ifs;
+  AST_VECTOR(AstStmt) stmts;
+  AST_VECTOR(AstBlock) blocks;
+  AST_VECTOR(AstParam) params;
+  AST_VECTOR(AstFunc) funcs;
+
+  NodeId main;        // func, or NO_NODE if only functions were parsed
+  NodeId functions;   // user defined functions after main
+  int complete;       // set once the whole program is parsed
+
+  uint32_t seq;       // number of nodes built so far
+  int discard;        // nothing is built, see the builders
+} Ast;
+
+// Head and tail of a list being built
+typedef struct AstList
+{
+  NodeId first;
+  NodeId last;
+} AstList;
+
+void astInit(Ast* ast);
+void astFree(Ast* ast);
+
+/*
+  Builders, called by the parser as it reduces. Each one appends a node
+  to the vector of its kind and returns its index. While discard is set
+  they do nothing and return NO_NODE, which the lists take as empty.
+*/
+NodeId astType(Ast* ast, int line, int dtype);
+NodeId astExpr(Ast* ast, int line, ExprKind kind, char op, NodeId lhs, NodeId rhs, Atom name);
+NodeId astArraySize(Ast* ast, int line, ArraySize size, int length);
+NodeId astVar(Ast* ast, int line, NodeId var, Atom name, NodeId next);
+NodeId astAssign(Ast* ast, int line, Atom name, NodeId expr);
+NodeId astArg(Ast* ast, int line, ArgKind kind, Atom name);
+NodeId astCall(Ast* ast, int line, Atom function, NodeId args);
+void astCallTarget(Ast* ast, int line, NodeId call, Atom target);
+NodeId astCond(Ast* ast, int line, int relop, NodeId lhs, NodeId rhs);
+NodeId astIter(Ast* ast, int line, IterKind kind, NodeId init, NodeId cond, NodeId step, NodeId body);
+NodeId astIf(Ast* ast, int line, NodeId cond, NodeId then_body, NodeId else_body);
+NodeId astStmt(Ast* ast, int line, StmtKind kind, NodeId a, NodeId b);
+NodeId astOpenBlock(Ast* ast, int line);
+void astCloseBlock(Ast* ast, NodeId block, NodeId first);
+NodeId astParam(Ast* ast, int line, NodeId type, Atom name);
+NodeId astFunc(Ast* ast, int line, NodeId type, Atom name, NodeId params, NodeId body);
+
+// Lists of statements, possibly empty; appending NO_NODE does nothing
+AstList astAppendStmt(Ast* ast, AstList list, NodeId stmt);
+AstList astConcatStmts(Ast* ast, AstList head, AstList tail);
+
+// Add a node at the end of a list of the same kind, possibly empty. The
+// logic operator of a condition joins the one before it to it.
+AstList astAppendArg(Ast* ast, AstList list, NodeId arg);
+AstList astAppendCond(Ast* ast, AstList list, int logic, NodeId cond);
+AstList astAppendParam(Ast* ast, AstList list, NodeId param);
+AstList astAppendFunc(Ast* ast, AstList list, NodeId func);
+
+// Set the roots once the whole program is parsed
+void astProgram(Ast* ast, NodeId main, NodeId functions);
+
+/*
+  Callbacks of a pass over the tree. Each one is optional and gets the
+  index of its node. Nodes are visited children first, in the order the
+  parser reduced them, so a pass sees the program in the same order as
+  actions in the grammar would; a block is entered before its statements.
+*/
+typedef struct AstVisitor
+{
+  void (*type)(void* arg, NodeId type);
+  void (*expr)(void* arg, NodeId expr);
+  void (*var)(void* arg, NodeId var);
+  void (*assign)(void* arg, NodeId assign);
+  void (*arg)(void* arg, NodeId call_arg);
+  void (*call)(void* arg, NodeId call);
+  void (*cond)(void* arg, NodeId cond);
+  void (*stmt)(void* arg, NodeId stmt);
+  void (*enterBlock)(void* arg, NodeId block);
+  void (*exitBlock)(void* arg, NodeId block);
+  void (*param)(void* arg, NodeId param);
+  void (*func)(void* arg, NodeId func);
+} AstVisitor;
+
+/*
+  Visit the whole program. If the parse stopped early, the tree is still a
+  forest of the parts parsed so far, and these are visited in the order
+  they were built, so a pass covers everything up to the error.
+*/
+void astVisit(const Ast* ast, const AstVisitor* visitor, void* arg);
+
+/*
+  Visit parts of a complete program on their own, for a pass that handles
+  the functions separately: the result type and the parameters of a
+  function, or a block and everything in it.
+*/
+void astVisitSignature(const Ast* ast, NodeId func, const AstVisitor* visitor, void* arg);
+void astVisitBlock(const Ast* ast, NodeId block, const AstVisitor* visitor, void* arg);
+
+#endif
@@ -0,0 +1,295 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+
+void pathListInit(PathList* list)
+{
+  list->paths = NULL;
+  list->count = list->capacity = 0;
+}
+
+void pathListFree(PathList* list)
+{
+  for (size_t i = 0; i < list->count; i++)
+    free(list->paths[i]);
+  free(list->paths);
+  pathListInit(list);
+}
+
+static void append(PathList* list, char* path)
+{
+  if (list->count == list->capacity)
+  {
+    list->capacity = list->capacity ? 2 * list->capacity : 64;
+    list->paths = (char**) realloc(list->paths, list->capacity * sizeof(char*));
+  }
+
+  list->paths[list->count++] = path;
+}
+
+static int isSource(const char* name)
+{
+  size_t len = strlen(name);
+  return len > 2 && strcmp(name + len - 2, ".c") == 0;
+}
+
+static int skipHidden(const struct dirent* entry)
+{
+  return entry->d_name[0] != '.';
+}
+
+int pathListAdd(PathList* list, const char* path)
+{
+  struct stat info;
+  if (stat(path, &info) != 0)
+    return -1;
+
+  if (!S_ISDIR(info.st_mode))
+  {
+    append(list, strdup(path));
+    return 0;
+  }
+
+  struct dirent** entries;
+  int n = scandir(path, &entries, skipHidden, alphasort);
+  if (n < 0)
+    return -1;
+
+  int result = 0;
+  for (int i = 0; i < n; i++)
+  {
+    size_t len = strlen(path) + strlen(entries[i]->d_name) + 2;
+    char* child = (char*) malloc(len);
+    snprintf(child, len, "%s/%s", path, entries[i]->d_name);
+
+    // Only sources are picked up from inside a directory
+    if (stat(child, &info) == 0 && S_ISDIR(info.st_mode))
+      result |= pathListAdd(list, child);
+    else if (isSource(child))
+    {
+      append(list, child);
+      child = NULL;
+    }
+
+    free(child);
+    free(entries[i]);
+  }
+
+  free(entries);
+  return result;
+}
+
+int pathListRead(PathList* list, const char* listfile)
+{
+  FILE* file = strcmp(listfile, "-") == 0 ? stdin : fopen(listfile, "r");
+  if (file == NULL)
+    return -1;
+
+  char* line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  int result = 0;
+
+  while ((len = getline(&line, &size, file)) >= 0)
+  {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      line[--len] = '\0';
+    if (len > 0 && pathListAdd(list, line) != 0)
+    {
+      fprintf(stderr, "cannot read %s\n", line);
+      result = -1;
+    }
+  }
+
+  free(line);
+  if (file != stdin)
+    fclose(file);
+  return result;
+}
+
+// Indices [begin, end) not yet taken from one thread's range
+typedef struct Range
+{
+  pthread_mutex_t lock;
+  size_t begin;
+  size_t end;
+} Range;
+
+typedef struct Batch
+{
+  Range* ranges;
+  int threads;
+
+  void (*run)(size_t, void*);
+  void (*emit)(size_t, void*);
+  void* arg;
+
+  // In-order emission of the results
+  pthread_mutex_t emit_lock;
+  unsigned char* done;
+  size_t next_emit;
+} Batch;
+
+typedef struct Worker
+{
+  Batch* batch;
+  int id;
+} Worker;
+
+// Take the next index of a range, or return 0 if it is empty
+static int takeFront(Range* range, size_t* index)
+{
+  pthread_mutex_lock(&range->lock);
+  int found = range->begin < range->end;
+  if (found)
+    *index = range->begin++;
+  pthread_mutex_unlock(&range->lock);
+  return found;
+}
+
+// Move the back half of the largest other range into the range of id.
+// Returns 0 once every range is empty; no work is ever added, so the
+// thread can then stop.
+static int steal(Batch* batch, int id)
+{
+  for (;;)
+  {
+    int victim = -1;
+    size_t most = 0;
+
+    for (int i = 0; i < batch->threads; i++)
+    {
+      Range* range = &batch->ranges[i];
+      pthread_mutex_lock(&range->lock);
+      size_t left = range->end - range->begin;
+      pthread_mutex_unlock(&range->lock);
+
+      if (i != id && left > most)
+      {
+        victim = i;
+        most = left;
+      }
+    }
+
+    if (victim < 0)
+      return 0;
+
+    Range* from = &batch->ranges[victim];
+    size_t begin, end;
+
+    pthread_mutex_lock(&from->lock);
+    size_t left = from->end - from->begin;
+    end = from->end;
+    begin = from->end - (left + 1) / 2;
+    from->end = begin;
+    pthread_mutex_unlock(&from->lock);
+
+    // The victim may have drained in the meantime; look again
+    if (begin == end)
+      continue;
+
+    Range* own = &batch->ranges[id];
+    pthread_mutex_lock(&own->lock);
+    own->begin = begin;
+    own->end = end;
+    pthread_mutex_unlock(&own->lock);
+    return 1;
+  }
+}
+
+static void finish(Batch* batch, size_t index)
+{
+  pthread_mutex_lock(&batch->emit_lock);
+  batch->done[index] = 1;
+  // done[count] is never set, which stops the loop after the last index
+  while (batch->done[batch->next_emit])
+  {
+    batch->emit(batch->next_emit, batch->arg);
+    batch->next_emit++;
+  }
+  pthread_mutex_unlock(&batch->emit_lock);
+}
+
+static void* work(void* arg)
+{
+  Worker* worker = (Worker*) arg;
+  Batch* batch = worker->batch;
+  size_t index;
+
+  do
+  {
+    while (takeFront(&batch->ranges[worker->id], &index))
+    {
+      batch->run(index, batch->arg);
+      finish(batch, index);
+    }
+  } while (steal(batch, worker->id));
+
+  return NULL;
+}
+
+void batchRun(size_t count, int threads,
+              void (*run)(size_t i, void* arg),
+              void (*emit)(size_t i, void* arg),
+              void* arg)
+{
+  if (count == 0)
+    return;
+  if (threads < 1)
+    threads = 1;
+  if ((size_t) threads > count)
+    threads = (int) count;
+
+  Batch batch;
+  batch.threads = threads;
+  batch.run = run;
+  batch.emit = emit;
+  batch.arg = arg;
+  batch.done = (unsigned char*) calloc(count + 1, 1);
+  batch.next_emit = 0;
+  pthread_mutex_init(&batch.emit_lock, NULL);
+
+  // Thread i starts with the i-th of threads equal slices
+  batch.ranges = (Range*) malloc(threads * sizeof(Range));
+  for (int i = 0; i < threads; i++)
+  {
+    pthread_mutex_init(&batch.ranges[i].lock, NULL);
+    batch.ranges[i].begin = count * i / threads;
+    batch.ranges[i].end = count * (i + 1) / threads;
+  }
+
+  Worker* workers = (Worker*) malloc(threads * sizeof(Worker));
+  pthread_t* ids = (pthread_t*) malloc(threads * sizeof(pthread_t));
+
+  // The calling thread is worker 0
+  for (int i = 0; i < threads; i++)
+  {
+    workers[i].batch = &batch;
+    workers[i].id = i;
+    if (i > 0)
+      pthread_create(&ids[i], NULL, work, &workers[i]);
+  }
+  work(&workers[0]);
+  for (int i = 1; i < threads; i++)
+    pthread_join(ids[i], NULL);
+
+  for (int i = 0; i < threads; i++)
+    pthread_mutex_destroy(&batch.ranges[i].lock);
+  pthread_mutex_destroy(&batch.emit_lock);
+  free(batch.ranges);
+  free(batch.done);
+  free(workers);
+  free(ids);
+}
+
+int batchDefaultThreads(void)
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int) n : 1;
+}
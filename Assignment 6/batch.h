@@ -0,0 +1,45 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+// Paths of the files to check, in the order their results are printed
+typedef struct PathList
+{
+  char** paths;
+  size_t count;
+  size_t capacity;
+} PathList;
+
+void pathListInit(PathList* list);
+void pathListFree(PathList* list);
+
+// Add a file, or every .c file under a directory in sorted order.
+// Returns 0, or -1 if path cannot be read.
+int pathListAdd(PathList* list, const char* path);
+
+// Add every path listed one per line in a file, "-" being stdin.
+// Returns 0, or -1 if the list cannot be read.
+int pathListRead(PathList* list, const char* listfile);
+
+/*
+  Run run(i, arg) for every i in [0, count) on up to threads threads.
+
+  Work is spread with work stealing: every thread owns a contiguous range
+  of the indices and takes them from the front, and a thread that runs
+  out steals the back half of the largest range left. Since every thread
+  starts on its own range, nearby files are checked by the same thread.
+
+  emit(i, arg) is called once for every i in increasing order, as soon as
+  run has finished for 0..i, so results come out in input order however
+  the work was spread. Calls to emit never overlap.
+*/
+void batchRun(size_t count, int threads,
+              void (*run)(size_t i, void* arg),
+              void (*emit)(size_t i, void* arg),
+              void* arg);
+
+// Number of online processors, at least 1
+int batchDefaultThreads(void);
+
+#endif
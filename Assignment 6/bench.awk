@@ -0,0 +1,14 @@
+# Writes a program of main and n functions for "make bench", run as
+#   awk -v n=20000 -f bench.awk
+# Every function has a bit of each construct, and the program has no
+# errors, so both parsers read all of it and the checks report nothing.
+BEGIN {
+  print "int main()\n{\n  int a, b[10];\n  a = 1;\n}";
+  for (i = 0; i < n; i++) {
+    printf "int f%d(int x%d, float y%d)\n{\n  int i, s;\n  float z;\n", i, i, i;
+    printf "  s = (x%d + 2) * 3 - x%d / 4 %% 5;\n  z = y%d * 2.5 + z;\n", i, i, i;
+    printf "  for (i = 0; i < x%d; i++)\n  {\n    s = s + i;\n    if (s > 10)\n      s = s - 1;\n    else\n    {\n      z = z + 1.5;\n    }\n  }\n", i;
+    print "  while (s > 0)\n    s = s - 1;\n  {\n    int t;\n    t = s;\n  }";
+    printf "  s = f%d(x%d, 1, y%d);\n  return s;\n}\n", i, i, i;
+  }
+}
@@ -0,0 +1,227 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cache.h"
+
+// First line of every entry; entries of another format are ignored
+#define CACHE_MAGIC "a6-unit-cache 1"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+void hashInit(Hasher* hasher)
+{
+  hasher->state = FNV_OFFSET;
+}
+
+void hashBytes(Hasher* hasher, const void* data, size_t size)
+{
+  const unsigned char* bytes = (const unsigned char*) data;
+  for (size_t i = 0; i < size; i++)
+  {
+    hasher->state ^= bytes[i];
+    hasher->state *= FNV_PRIME;
+  }
+}
+
+void hashInt(Hasher* hasher, int64_t value)
+{
+  hashBytes(hasher, &value, sizeof(value));
+}
+
+void hashString(Hasher* hasher, const char* text)
+{
+  if (text == NULL)
+  {
+    hashInt(hasher, -1);
+    return;
+  }
+
+  size_t length = strlen(text);
+  hashInt(hasher, (int64_t) length);
+  hashBytes(hasher, text, length);
+}
+
+void unitResultInit(UnitResult* result)
+{
+  result->records = NULL;
+  result->count = result->capacity = 0;
+  result->globals = NULL;
+  result->global_count = result->global_capacity = 0;
+}
+
+void unitResultFree(UnitResult* result)
+{
+  for (size_t i = 0; i < result->count; i++)
+    free(result->records[i].arg);
+  for (size_t i = 0; i < result->global_count; i++)
+    free(result->globals[i].name);
+  free(result->records);
+  free(result->globals);
+  unitResultInit(result);
+}
+
+void unitResultAddRecord(UnitResult* result, DiagCode code, int line, const char* arg)
+{
+  if (result->count == result->capacity)
+  {
+    result->capacity = result->capacity ? 2 * result->capacity : 16;
+    result->records = (Diagnostic*) realloc(result->records, result->capacity * sizeof(Diagnostic));
+  }
+
+  Diagnostic* record = &result->records[result->count++];
+  record->code = code;
+  record->line = line;
+  record->order = 0;
+  record->arg = arg ? strdup(arg) : NULL;
+}
+
+void unitResultAddGlobal(UnitResult* result, const char* name, int dtype)
+{
+  if (result->global_count == result->global_capacity)
+  {
+    result->global_capacity = result->global_capacity ? 2 * result->global_capacity : 8;
+    result->globals = (UnitGlobal*) realloc(result->globals, result->global_capacity * sizeof(UnitGlobal));
+  }
+
+  UnitGlobal* global = &result->globals[result->global_count++];
+  global->name = strdup(name);
+  global->dtype = dtype;
+}
+
+static void entryPath(char* path, size_t size, const char* dir, uint64_t key)
+{
+  snprintf(path, size, "%s/%016" PRIx64, dir, key);
+}
+
+// Strings are stored as their length and bytes, -1 for NULL
+static void writeString(FILE* out, const char* text)
+{
+  if (text == NULL)
+  {
+    fprintf(out, "-1\n");
+    return;
+  }
+
+  fprintf(out, "%zu ", strlen(text));
+  fputs(text, out);
+  fputc('\n', out);
+}
+
+static int readString(FILE* in, char** text)
+{
+  long length;
+  if (fscanf(in, "%ld", &length) != 1)
+    return -1;
+
+  if (length < 0)
+  {
+    *text = NULL;
+    return fgetc(in) == '\n' ? 0 : -1;
+  }
+
+  if (fgetc(in) != ' ')
+    return -1;
+
+  *text = (char*) malloc((size_t) length + 1);
+  if (fread(*text, 1, (size_t) length, in) != (size_t) length || fgetc(in) != '\n')
+  {
+    free(*text);
+    return -1;
+  }
+  (*text)[length] = '\0';
+  return 0;
+}
+
+int cacheLoad(const char* dir, uint64_t key, UnitResult* result)
+{
+  char path[4096];
+  entryPath(path, sizeof(path), dir, key);
+
+  FILE* in = fopen(path, "r");
+  if (in == NULL)
+    return -1;
+
+  char magic[64];
+  size_t globals, records;
+  int status = -1;
+
+  if (fgets(magic, sizeof(magic), in) == NULL || strcmp(magic, CACHE_MAGIC "\n") != 0 ||
+      fscanf(in, "globals %zu\n", &globals) != 1)
+    goto done;
+
+  for (size_t i = 0; i < globals; i++)
+  {
+    int dtype;
+    char* name;
+    if (fscanf(in, "%d", &dtype) != 1 || fgetc(in) != ' ' || readString(in, &name) != 0 || name == NULL)
+      goto done;
+    unitResultAddGlobal(result, name, dtype);
+    free(name);
+  }
+
+  if (fscanf(in, "records %zu\n", &records) != 1)
+    goto done;
+
+  for (size_t i = 0; i < records; i++)
+  {
+    int code, line;
+    char* arg;
+    if (fscanf(in, "%d %d", &code, &line) != 2 || code < 0 || code >= DIAG_CODE_COUNT ||
+        fgetc(in) != ' ' || readString(in, &arg) != 0)
+      goto done;
+    unitResultAddRecord(result, (DiagCode) code, line, arg);
+    free(arg);
+  }
+  status = 0;
+
+done:
+  fclose(in);
+  if (status != 0)
+    unitResultFree(result);
+  return status;
+}
+
+int cacheStore(const char* dir, uint64_t key, const UnitResult* result)
+{
+  char path[4096], temp[4096 + 8];
+  entryPath(path, sizeof(path), dir, key);
+  snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+
+  int fd = mkstemp(temp);
+  if (fd < 0)
+    return -1;
+
+  FILE* out = fdopen(fd, "w");
+  if (out == NULL)
+  {
+    close(fd);
+    unlink(temp);
+    return -1;
+  }
+
+  fprintf(out, CACHE_MAGIC "\n");
+  fprintf(out, "globals %zu\n", result->global_count);
+  for (size_t i = 0; i < result->global_count; i++)
+  {
+    fprintf(out, "%d ", result->globals[i].dtype);
+    writeString(out, result->globals[i].name);
+  }
+
+  fprintf(out, "records %zu\n", result->count);
+  for (size_t i = 0; i < result->count; i++)
+  {
+    fprintf(out, "%d %d ", (int) result->records[i].code, result->records[i].line);
+    writeString(out, result->records[i].arg);
+  }
+
+  if (fclose(out) != 0 || rename(temp, path) != 0)
+  {
+    unlink(temp);
+    return -1;
+  }
+  return 0;
+}
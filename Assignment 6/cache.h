@@ -0,0 +1,60 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "diag.h"
+
+// 64-bit FNV-1a hash of a stream of values
+typedef struct Hasher
+{
+  uint64_t state;
+} Hasher;
+
+void hashInit(Hasher* hasher);
+void hashBytes(Hasher* hasher, const void* data, size_t size);
+void hashInt(Hasher* hasher, int64_t value);
+void hashString(Hasher* hasher, const char* text);  // NULL differs from ""
+
+// Symbol a unit left in the outermost scope
+typedef struct UnitGlobal
+{
+  char* name;
+  int dtype;
+} UnitGlobal;
+
+/*
+  What checking one top-level function (a unit) produced: its diagnostics,
+  with lines relative to the first line of the unit, and the symbols it
+  declared in the outermost scope, which later units see.
+*/
+typedef struct UnitResult
+{
+  Diagnostic* records;
+  size_t count;
+  size_t capacity;
+
+  UnitGlobal* globals;
+  size_t global_count;
+  size_t global_capacity;
+} UnitResult;
+
+void unitResultInit(UnitResult* result);
+void unitResultFree(UnitResult* result);
+void unitResultAddRecord(UnitResult* result, DiagCode code, int line, const char* arg);
+void unitResultAddGlobal(UnitResult* result, const char* name, int dtype);
+
+/*
+  On-disk cache of unit results, one file per key in dir. Entries are
+  written to a temporary file and renamed into place, so concurrent
+  checkers never see a partial entry.
+*/
+
+// Returns 0 and fills result if dir has an entry for key
+int cacheLoad(const char* dir, uint64_t key, UnitResult* result);
+
+// Returns 0 if the entry was stored
+int cacheStore(const char* dir, uint64_t key, const UnitResult* result);
+
+#endif
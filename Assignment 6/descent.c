@@ -0,0 +1,798 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "descent.h"
+
+// Reentrant lexer generated from lexrules.l
+int yylex(YYSTYPE* lvalp, void* scanner);
+
+// No token has been scanned ahead
+#define NO_TOKEN (-1)
+
+// Binding power of the tightest binary operators
+#define MAX_POWER 2
+
+// Shorthands for the builders, as in the grammar actions
+#define AST (&p->ctx->ast)
+#define LINE (p->ctx->lineno)
+
+// How far a part of the program was parsed
+typedef enum Parsed
+{
+  PARSED,   // all of it
+  FAILED,   // up to a syntax error, which was reported
+  ABORTED   // the parse is given up
+} Parsed;
+
+// Where a statement is, which decides where an error in it is recovered
+typedef enum StmtContext
+{
+  IN_BLOCK,      // before the first nested block: at ';' or the end of the block
+  AFTER_NESTED,  // after a nested block: at ';'
+  IN_BODY        // the body of a loop or if without braces: at ';'
+} StmtContext;
+
+// A nested block and the statements after it
+typedef struct Nested
+{
+  NodeId block;
+  AstList stmts;
+} Nested;
+
+typedef struct Descent
+{
+  Checker* ctx;
+  void* scanner;
+  int token;          // scanned ahead, or NO_TOKEN
+  YYSTYPE lval;
+
+  NodeId* vars;       // variables of the declaration being parsed
+  Atom* names;        // and their names
+  size_t var_capacity;
+
+  Nested* nested;     // nested blocks of all the blocks being parsed
+  size_t nested_count;
+  size_t nested_capacity;
+} Descent;
+
+static int peek(Descent* p)
+{
+  if (p->token == NO_TOKEN)
+    p->token = yylex(&p->lval, p->scanner);
+  return p->token;
+}
+
+static void advance(Descent* p)
+{
+  p->token = NO_TOKEN;
+}
+
+static Parsed fail(Descent* p)
+{
+  report(p->ctx, DIAG_SYNTAX, "syntax error");
+  return FAILED;
+}
+
+static Parsed expect(Descent* p, int token)
+{
+  if (peek(p) != token)
+    return fail(p);
+
+  advance(p);
+  return PARSED;
+}
+
+static int isType(int token)
+{
+  return token == INT_TOK || token == FLOAT_TOK;
+}
+
+static int startsExpr(int token)
+{
+  return token == INT_CONST_TOK || token == REALCONST_TOK || token == ID_TOK || token == '(';
+}
+
+static int startsArg(int token)
+{
+  return token == INT_CONST_TOK || token == REALCONST_TOK || token == ID_TOK;
+}
+
+static int startsStmt(int token)
+{
+  switch (token)
+  {
+    case RETURN_TOK:
+    case INT_TOK:
+    case FLOAT_TOK:
+    case ID_TOK:
+    case FOR_TOK:
+    case WHILE_TOK:
+    case DO_TOK:
+    case IF_TOK:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static int isRelop(int token)
+{
+  switch (token)
+  {
+    case LEQ_TOK:
+    case '<':
+    case GEQ_TOK:
+    case '>':
+    case EQEQ_TOK:
+    case NOT_EQ_TOK:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+// Binding power of a binary operator, 0 for any other token
+static int bindingPower(int token)
+{
+  switch (token)
+  {
+    case '+':
+    case '-':
+      return 1;
+    case '*':
+    case '/':
+    case '%':
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+// DATATYPE, which is the lookahead
+static NodeId parseType(Descent* p)
+{
+  NodeId type = astType(AST, LINE, peek(p) == FLOAT_TOK);
+  advance(p);
+  return type;
+}
+
+static Parsed parseExpr(Descent* p, NodeId* expr);
+
+static Parsed parsePrimary(Descent* p, NodeId* expr)
+{
+  NodeId inner;
+
+  switch (peek(p))
+  {
+    case INT_CONST_TOK:
+      *expr = astExpr(AST, LINE, EXPR_INT, 0, NO_NODE, NO_NODE, NO_NAME);
+      advance(p);
+      return PARSED;
+    case REALCONST_TOK:
+      *expr = astExpr(AST, LINE, EXPR_REAL, 0, NO_NODE, NO_NODE, NO_NAME);
+      advance(p);
+      return PARSED;
+    case ID_TOK:
+      *expr = astExpr(AST, LINE, EXPR_ID, 0, NO_NODE, NO_NODE, p->lval.atom);
+      advance(p);
+      return PARSED;
+    case '(':
+      advance(p);
+      if (parseExpr(p, &inner) != PARSED || expect(p, ')') != PARSED)
+        return FAILED;
+      *expr = astExpr(AST, LINE, EXPR_PAREN, 0, inner, NO_NODE, NO_NAME);
+      return PARSED;
+    default:
+      return fail(p);
+  }
+}
+
+/*
+  Apply the operators that follow *expr and bind at least min tightly.
+  The right operand of an operator takes the operators binding tighter
+  than it, so those group first and equal ones group to the left. Nothing
+  binds tighter than the tightest operators, so their right operand is
+  complete without looking at the token after it.
+*/
+static Parsed parseOperators(Descent* p, int min, NodeId* expr)
+{
+  for (;;)
+  {
+    int op = peek(p);
+    int power = bindingPower(op);
+    if (power == 0 || power < min)
+      return PARSED;
+
+    NodeId rhs;
+    advance(p);
+    if (parsePrimary(p, &rhs) != PARSED)
+      return FAILED;
+    if (power < MAX_POWER && parseOperators(p, power + 1, &rhs) != PARSED)
+      return FAILED;
+
+    *expr = astExpr(AST, LINE, EXPR_BINARY, (char) op, *expr, rhs, NO_NAME);
+  }
+}
+
+static Parsed parseExpr(Descent* p, NodeId* expr)
+{
+  if (parsePrimary(p, expr) != PARSED)
+    return FAILED;
+
+  return parseOperators(p, 1, expr);
+}
+
+// CONDITION: EXPRESSION RELAT_OP EXPRESSION
+static Parsed parseCondition(Descent* p, NodeId* cond)
+{
+  NodeId lhs, rhs;
+  if (parseExpr(p, &lhs) != PARSED)
+    return FAILED;
+
+  int relop = peek(p);
+  if (!isRelop(relop))
+    return fail(p);
+  advance(p);
+
+  if (parseExpr(p, &rhs) != PARSED)
+    return FAILED;
+
+  *cond = astCond(AST, LINE, relop, lhs, rhs);
+  return PARSED;
+}
+
+// CONDITIONS, joined by logic operators
+static Parsed parseConditions(Descent* p, NodeId* first)
+{
+  NodeId cond;
+  if (parseCondition(p, &cond) != PARSED)
+    return FAILED;
+
+  AstList conds = { cond, cond };
+  *first = cond;
+  for (;;)
+  {
+    int logic = peek(p);
+    if (logic != AND_TOK && logic != OR_TOK)
+      return PARSED;
+    advance(p);
+
+    if (parseCondition(p, &cond) != PARSED)
+      return FAILED;
+    conds = astAppendCond(AST, conds, logic, cond);
+  }
+}
+
+// COND_PART, which may be empty
+static Parsed parseCondPart(Descent* p, NodeId* cond)
+{
+  *cond = NO_NODE;
+  if (!startsExpr(peek(p)))
+    return PARSED;
+
+  return parseConditions(p, cond);
+}
+
+// FN_SIGN from its '(', the name of the function having been parsed
+static Parsed parseCall(Descent* p, Atom function, NodeId* call)
+{
+  AstList args = { NO_NODE, NO_NODE };
+
+  advance(p);
+  if (startsArg(peek(p)))
+  {
+    for (;;)
+    {
+      int token = peek(p);
+      if (!startsArg(token))
+        return fail(p);
+
+      ArgKind kind = token == ID_TOK ? ARG_ID : token == INT_CONST_TOK ? ARG_INT : ARG_REAL;
+      NodeId arg = astArg(AST, LINE, kind, token == ID_TOK ? p->lval.atom : NO_NAME);
+      advance(p);
+
+      args = astAppendArg(AST, args, arg);
+
+      if (peek(p) != ',')
+        break;
+      advance(p);
+    }
+  }
+
+  if (expect(p, ')') != PARSED)
+    return FAILED;
+
+  *call = astCall(AST, LINE, function, args.first);
+  return PARSED;
+}
+
+static void pushVar(Descent* p, size_t count, NodeId var, Atom name)
+{
+  if (count == p->var_capacity)
+  {
+    p->var_capacity = p->var_capacity ? 2 * p->var_capacity : 16;
+    p->vars = (NodeId*) realloc(p->vars, p->var_capacity * sizeof(NodeId));
+    p->names = (Atom*) realloc(p->names, p->var_capacity * sizeof(Atom));
+  }
+
+  p->vars[count] = var;
+  p->names[count] = name;
+}
+
+// DECLARATION, which starts with its DATATYPE
+static Parsed parseDeclaration(Descent* p, NodeId* type, NodeId* first)
+{
+  size_t count = 0;
+  *type = parseType(p);
+
+  for (;;)
+  {
+    if (peek(p) != ID_TOK)
+      return fail(p);
+    Atom name = p->lval.atom;
+    advance(p);
+
+    NodeId var;
+    if (peek(p) == '[')
+    {
+      advance(p);
+      int token = peek(p);
+      if (token != INT_CONST_TOK && token != REALCONST_TOK)
+        return fail(p);
+      int length = token == INT_CONST_TOK ? p->lval.number : 0;
+      advance(p);
+
+      if (expect(p, ']') != PARSED)
+        return FAILED;
+      var = astArraySize(AST, LINE, token == INT_CONST_TOK ? ARRAY_INT : ARRAY_REAL, length);
+    }
+    else
+      var = astArraySize(AST, LINE, ARRAY_NONE, 0);
+
+    pushVar(p, count++, var, name);
+    if (peek(p) != ',')
+      break;
+    advance(p);
+  }
+
+  // The variables are named from the last one back, as the right
+  // recursive VARS of the grammar reduces them
+  NodeId next = NO_NODE;
+  for (size_t i = count; i-- > 0;)
+    next = astVar(AST, LINE, p->vars[i], p->names[i], next);
+
+  *first = next;
+  return PARSED;
+}
+
+// ASSIGN or FN_CALL, from the name they start with
+static Parsed parseNamed(Descent* p, NodeId* stmt)
+{
+  Atom name = p->lval.atom;
+  NodeId call, expr;
+  advance(p);
+
+  if (peek(p) == '(')
+  {
+    if (parseCall(p, name, &call) != PARSED || expect(p, ';') != PARSED)
+      return FAILED;
+    *stmt = astStmt(AST, LINE, STMT_CALL, call, NO_NODE);
+    return PARSED;
+  }
+
+  if (expect(p, '=') != PARSED)
+    return FAILED;
+
+  if (peek(p) == ID_TOK)
+  {
+    // Only the token after a name tells a call from a variable
+    Atom other = p->lval.atom;
+    advance(p);
+
+    if (peek(p) == '(')
+    {
+      if (parseCall(p, other, &call) != PARSED)
+        return FAILED;
+      astCallTarget(AST, LINE, call, name);
+      if (expect(p, ';') != PARSED)
+        return FAILED;
+      *stmt = astStmt(AST, LINE, STMT_CALL, call, NO_NODE);
+      return PARSED;
+    }
+
+    expr = astExpr(AST, LINE, EXPR_ID, 0, NO_NODE, NO_NODE, other);
+    if (parseOperators(p, 1, &expr) != PARSED)
+      return FAILED;
+  }
+  else if (parseExpr(p, &expr) != PARSED)
+    return FAILED;
+
+  NodeId assign = astAssign(AST, LINE, name, expr);
+  if (expect(p, ';') != PARSED)
+    return FAILED;
+
+  *stmt = astStmt(AST, LINE, STMT_ASSIGN, assign, NO_NODE);
+  return PARSED;
+}
+
+static Parsed parseStmt(Descent* p, NodeId* stmt);
+static Parsed parseBlock(Descent* p, NodeId* block);
+
+/*
+  Skip to where the statement with a syntax error ends, as the error rules
+  of the grammar do: its ';', or in the statements of a block before any
+  nested block, the block's '}'. Returns that token, once it was taken, or
+  0 if the input ended first or there have been too many errors.
+*/
+static int recoverStmt(Descent* p, StmtContext context)
+{
+  for (;;)
+  {
+    int token = peek(p);
+    if (token == 0)
+      return 0;
+
+    advance(p);
+    if (token == ';' || (token == '}' && context == IN_BLOCK))
+      return recover(p->ctx) ? 0 : token;
+  }
+}
+
+// INNER_BODY: a block, or a single statement made a block of its own
+static Parsed parseBody(Descent* p, NodeId* body)
+{
+  if (peek(p) == '{')
+    return parseBlock(p, body);
+
+  *body = astOpenBlock(AST, LINE);
+  NodeId stmt = NO_NODE;
+  Parsed parsed = startsStmt(peek(p)) ? parseStmt(p, &stmt) : fail(p);
+
+  if (parsed == ABORTED)
+    return ABORTED;
+  if (parsed == FAILED)
+  {
+    stmt = NO_NODE;
+    if (recoverStmt(p, IN_BODY) == 0)
+      return ABORTED;
+  }
+
+  astCloseBlock(AST, *body, stmt);
+  return PARSED;
+}
+
+static Parsed parseIf(Descent* p, NodeId* node)
+{
+  NodeId cond, then_body, else_body = NO_NODE;
+
+  advance(p);
+  if (expect(p, '(') != PARSED || parseCondPart(p, &cond) != PARSED || expect(p, ')') != PARSED)
+    return FAILED;
+
+  Parsed parsed = parseBody(p, &then_body);
+  if (parsed != PARSED)
+    return parsed;
+
+  // An else belongs to the innermost if
+  if (peek(p) == ELSE_TOK)
+  {
+    advance(p);
+    parsed = parseBody(p, &else_body);
+    if (parsed != PARSED)
+      return parsed;
+  }
+
+  *node = astIf(AST, LINE, cond, then_body, else_body);
+  return PARSED;
+}
+
+static Parsed parseIter(Descent* p, NodeId* iter)
+{
+  NodeId init = NO_NODE, cond, step = NO_NODE, body;
+  Parsed parsed;
+
+  switch (peek(p))
+  {
+    case FOR_TOK:
+      advance(p);
+      if (expect(p, '(') != PARSED)
+        return FAILED;
+
+      if (peek(p) == ID_TOK)
+      {
+        Atom name = p->lval.atom;
+        NodeId expr;
+        advance(p);
+        if (expect(p, '=') != PARSED || parseExpr(p, &expr) != PARSED)
+          return FAILED;
+        init = astAssign(AST, LINE, name, expr);
+      }
+
+      if (expect(p, ';') != PARSED || parseCondPart(p, &cond) != PARSED || expect(p, ';') != PARSED)
+        return FAILED;
+
+      if (peek(p) == ID_TOK)
+      {
+        Atom name = p->lval.atom;
+        advance(p);
+        int op = peek(p);
+        if (op != '+' && op != '-')
+          return fail(p);
+        advance(p);
+        if (expect(p, op) != PARSED)
+          return FAILED;
+        step = astExpr(AST, LINE, op == '+' ? EXPR_INCREMENT : EXPR_DECREMENT, 0, NO_NODE, NO_NODE, name);
+      }
+
+      if (expect(p, ')') != PARSED)
+        return FAILED;
+      if ((parsed = parseBody(p, &body)) != PARSED)
+        return parsed;
+
+      *iter = astIter(AST, LINE, ITER_FOR, init, cond, step, body);
+      return PARSED;
+
+    case WHILE_TOK:
+      advance(p);
+      if (expect(p, '(') != PARSED || parseCondPart(p, &cond) != PARSED || expect(p, ')') != PARSED)
+        return FAILED;
+      if ((parsed = parseBody(p, &body)) != PARSED)
+        return parsed;
+
+      *iter = astIter(AST, LINE, ITER_WHILE, NO_NODE, cond, NO_NODE, body);
+      return PARSED;
+
+    default:
+      advance(p);
+      if ((parsed = parseBody(p, &body)) != PARSED)
+        return parsed;
+      if (expect(p, WHILE_TOK) != PARSED || expect(p, '(') != PARSED || parseCondPart(p, &cond) != PARSED
+          || expect(p, ')') != PARSED || expect(p, ';') != PARSED)
+        return FAILED;
+
+      *iter = astIter(AST, LINE, ITER_DO, NO_NODE, cond, NO_NODE, body);
+      return PARSED;
+  }
+}
+
+// STMT, which starts with the lookahead
+static Parsed parseStmt(Descent* p, NodeId* stmt)
+{
+  NodeId a, b;
+  Parsed parsed;
+
+  switch (peek(p))
+  {
+    case RETURN_TOK:
+      advance(p);
+      if (parseExpr(p, &a) != PARSED || expect(p, ';') != PARSED)
+        return FAILED;
+      *stmt = astStmt(AST, LINE, STMT_RETURN, a, NO_NODE);
+      return PARSED;
+
+    case INT_TOK:
+    case FLOAT_TOK:
+      if (parseDeclaration(p, &a, &b) != PARSED || expect(p, ';') != PARSED)
+        return FAILED;
+      *stmt = astStmt(AST, LINE, STMT_DECLARATION, a, b);
+      return PARSED;
+
+    case ID_TOK:
+      return parseNamed(p, stmt);
+
+    case IF_TOK:
+      if ((parsed = parseIf(p, &a)) != PARSED)
+        return parsed;
+      *stmt = astStmt(AST, LINE, STMT_IF, a, NO_NODE);
+      return PARSED;
+
+    default:
+      if ((parsed = parseIter(p, &a)) != PARSED)
+        return parsed;
+      *stmt = astStmt(AST, LINE, STMT_ITER, a, NO_NODE);
+      return PARSED;
+  }
+}
+
+/*
+  STMTS, appended to list, up to a token no statement starts with. A
+  statement with a syntax error is left out. Sets *closed if the error
+  was recovered from at the '}' of the block.
+*/
+static Parsed parseStmts(Descent* p, StmtContext context, AstList* list, int* closed)
+{
+  for (;;)
+  {
+    int token = peek(p);
+    NodeId stmt;
+    Parsed parsed;
+
+    if (startsStmt(token))
+      parsed = parseStmt(p, &stmt);
+    else if (token == '{' || token == '}')
+      return PARSED;
+    else
+      parsed = fail(p);
+
+    if (parsed == PARSED)
+    {
+      *list = astAppendStmt(AST, *list, stmt);
+      continue;
+    }
+    if (parsed == ABORTED)
+      return ABORTED;
+
+    token = recoverStmt(p, context);
+    if (token == 0)
+      return ABORTED;
+    if (token == '}')
+    {
+      *closed = 1;
+      return PARSED;
+    }
+  }
+}
+
+static void pushNested(Descent* p, NodeId block, AstList stmts)
+{
+  if (p->nested_count == p->nested_capacity)
+  {
+    p->nested_capacity = p->nested_capacity ? 2 * p->nested_capacity : 16;
+    p->nested = (Nested*) realloc(p->nested, p->nested_capacity * sizeof(Nested));
+  }
+
+  p->nested[p->nested_count].block = block;
+  p->nested[p->nested_count].stmts = stmts;
+  p->nested_count++;
+}
+
+/*
+  BLK, which starts with the lookahead '{'. Its own statements come
+  first, then each nested block with the statements after it. The grammar
+  chains those from the last one back once the '}' is seen, so that is
+  when the statements holding the nested blocks are built.
+*/
+static Parsed parseBlock(Descent* p, NodeId* block)
+{
+  AstList stmts = { NO_NODE, NO_NODE };
+  size_t base = p->nested_count;
+  int closed = 0;
+
+  advance(p);
+  *block = astOpenBlock(AST, LINE);
+
+  Parsed parsed = parseStmts(p, IN_BLOCK, &stmts, &closed);
+  while (parsed == PARSED && !closed && peek(p) == '{')
+  {
+    NodeId inner;
+    AstList after = { NO_NODE, NO_NODE };
+    parsed = parseBlock(p, &inner);
+    if (parsed == PARSED)
+      parsed = parseStmts(p, AFTER_NESTED, &after, &closed);
+    pushNested(p, inner, after);
+  }
+
+  if (parsed == PARSED && !closed)
+  {
+    AstList rest = { NO_NODE, NO_NODE };
+    for (size_t i = p->nested_count; i-- > base;)
+    {
+      AstList nested = { NO_NODE, NO_NODE };
+      nested = astAppendStmt(AST, nested, astStmt(AST, LINE, STMT_BLOCK, p->nested[i].block, NO_NODE));
+      rest = astConcatStmts(AST, astConcatStmts(AST, nested, p->nested[i].stmts), rest);
+    }
+    stmts = astConcatStmts(AST, stmts, rest);
+    advance(p);
+  }
+
+  p->nested_count = base;
+  if (parsed != PARSED)
+    return parsed;
+
+  astCloseBlock(AST, *block, stmts.first);
+  return PARSED;
+}
+
+// US_DEF_FN, which starts with its DATATYPE
+static Parsed parseFunction(Descent* p, NodeId* func)
+{
+  NodeId type = parseType(p);
+  AstList params = { NO_NODE, NO_NODE };
+  NodeId body;
+
+  if (peek(p) != ID_TOK)
+    return fail(p);
+  Atom name = p->lval.atom;
+  advance(p);
+
+  if (expect(p, '(') != PARSED)
+    return FAILED;
+
+  if (isType(peek(p)))
+  {
+    for (;;)
+    {
+      if (!isType(peek(p)))
+        return fail(p);
+      NodeId param_type = parseType(p);
+      if (peek(p) != ID_TOK)
+        return fail(p);
+
+      NodeId param = astParam(AST, LINE, param_type, p->lval.atom);
+      advance(p);
+      params = astAppendParam(AST, params, param);
+
+      if (peek(p) != ',')
+        break;
+      advance(p);
+    }
+  }
+
+  if (expect(p, ')') != PARSED)
+    return FAILED;
+  if (peek(p) != '{')
+    return fail(p);
+  if (parseBlock(p, &body) != PARSED)
+    return ABORTED;
+
+  *func = astFunc(AST, LINE, type, name, params.first, body);
+  return PARSED;
+}
+
+// S: main, then the user defined functions. Outside of the blocks there
+// is nothing to recover at, so any syntax error there ends the parse.
+static Parsed parseProgram(Descent* p)
+{
+  NodeId type, body;
+
+  if (!isType(peek(p)))
+    return fail(p);
+  type = parseType(p);
+
+  if (expect(p, MAIN_TOK) != PARSED || expect(p, '(') != PARSED || expect(p, ')') != PARSED)
+    return FAILED;
+  if (peek(p) != '{')
+    return fail(p);
+  if (parseBlock(p, &body) != PARSED)
+    return ABORTED;
+
+  NodeId main = astFunc(AST, LINE, type, NO_NAME, NO_NODE, body);
+  AstList funcs = { NO_NODE, NO_NODE };
+
+  while (isType(peek(p)))
+  {
+    NodeId func;
+    Parsed parsed = parseFunction(p, &func);
+    if (parsed != PARSED)
+      return parsed;
+
+    funcs = astAppendFunc(AST, funcs, func);
+  }
+
+  // The program is complete before anything after it is found to be wrong
+  astProgram(AST, main, funcs.first);
+  return peek(p) == 0 ? PARSED : fail(p);
+}
+
+int parseDescent(Checker* ctx, void* scanner)
+{
+  Descent p;
+  p.ctx = ctx;
+  p.scanner = scanner;
+  p.token = NO_TOKEN;
+  p.vars = NULL;
+  p.names = NULL;
+  p.var_capacity = 0;
+  p.nested = NULL;
+  p.nested_count = 0;
+  p.nested_capacity = 0;
+
+  memset(&p.lval, 0, sizeof(p.lval));
+
+  Parsed parsed = parseProgram(&p);
+
+  free(p.vars);
+  free(p.names);
+  free(p.nested);
+  return parsed != PARSED;
+}
@@ -0,0 +1,24 @@
+#ifndef DESCENT_H
+#define DESCENT_H
+
+#include "y.tab.h"
+
+/*
+  Recursive descent parser for the same language as the grammar in
+  lexparser.y, with a Pratt parser for expressions. It takes its tokens
+  from the same lexer and builds the same tree with the same builders, so
+  the checks that run over the tree afterwards cannot tell the two apart.
+
+  Nodes are built exactly where the LALR parser reduces them, and a token
+  is only scanned ahead where that parser needs a lookahead, so every node
+  gets the same line and sequence number. Syntax errors are recovered from
+  as the error rules of the grammar do: in the innermost list of
+  statements, up to the next ';', or to the '}' that ends a block when in
+  the statements before its first nested block.
+*/
+
+// Parse the program scanner reads into ctx->ast. Returns 0 if it was
+// parsed to the end, and 1 if the parse was given up.
+int parseDescent(Checker* ctx, void* scanner);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  String interning pool shared by the lexer and the parser.
+
+  The lexer interns every identifier once and passes its Atom in yylval.
+  Equal names always get the same Atom, so the parser and the symbol table
+  compare identifiers as integers and never copy or rehash the text.
+  Atoms are dense, starting from 0.
+
+  A pool belongs to one parse, so independent parses never share state.
+*/
+typedef uint32_t Atom;
+
+typedef struct InternPool
+{
+  struct NameChunk* chunks;    // storage for the names, newest first
+  struct InternEntry* entries; // names by Atom
+  size_t count;
+  size_t entries_capacity;
+  Atom* index;                 // open-addressing index from names to Atoms
+  size_t index_capacity;
+} InternPool;
+
+void internInit(InternPool* pool);
+
+// Atom of the len bytes at text, adding them to the pool if new
+Atom internAtom(InternPool* pool, const char* text, size_t len);
+
+// The name an Atom stands for, valid until internFree()
+const char* atomName(const InternPool* pool, Atom atom);
+
+// Number of distinct names interned so far
+size_t internCount(const InternPool* pool);
+
+// Release every name in the pool
+void internFree(InternPool* pool);
+
+#endif
@@ -1,243 +1,684 @@
+%code top
+{
+// For fopencookie()
+#define _GNU_SOURCE
+}
+
+%code requires
+{
+#include <stdio.h>
+
+#include "ast.h"
+#include "diag.h"
+#include "symstats.h"
+#include "symtable.h"
+#include "types.h"
+
+// A nested block and the statements after it, waiting for the end of the
+// block around them
+typedef struct NestedBlock
+{
+  NodeId block;
+  AstList stmts;
+} NestedBlock;
+
+/*
+  All the state of one parse. The parser is pure and is fed one token at
+  a time with yypush_parse(), so any number of parses can be in progress
+  at once, each with its own Checker. The lexer of a parse keeps its line
+  number and names here too. The parser only builds the tree in ast; the
+  checks run over it afterwards, and every message of the parse is
+  recorded in diag.
+*/
+typedef struct Checker
+{
+  Diagnostics diag;
+  int lineno;        // line being scanned
+  int syntax_errors; // recovered from so far
+  Ast ast;
+  NodeId* var_sizes;   // array sizes of the variables of the declaration being parsed
+  Atom* var_names;     // and their names
+  size_t var_count;
+  size_t var_capacity;
+  NestedBlock* nested; // nested blocks of the blocks being parsed
+  size_t nested_count;
+  size_t nested_capacity;
+  int scope;         // current scope depth of the checks
+  TypeId dtype;        // datatype of the declaration being checked
+  TypeId* expr_types;  // type of every expression, NO_TYPE if unknown
+  TypeId* func_types;  // signature of every function
+  TypeTable types;
+  Symtable table;      // symbols visible where the checks are
+  Symtable* scopes;    // the table on entry to each open block
+  size_t scopes_capacity;
+  SymPool pool;        // nodes of every version of the table
+  int threads;         // functions checked at once
+  SymtableStats* stats;  // kept if not NULL
+  InternPool names;  // identifiers seen by the lexer
+  int syntax_only;   // nothing is built, named or checked, see checkSyntax()
+} Checker;
+}
+
+%code provides
+{
+// Record a diagnostic at the point the parse has reached
+void report(Checker* ctx, DiagCode code, const char* arg);
+
+// Count a syntax error recovered from; 1 if the parse is to be given up
+int recover(Checker* ctx);
+}
+
+%define api.pure full
+%define api.push-pull push
+%parse-param { Checker* ctx }
+
+%union
+{
+  int number;     // for integer constants and operator tokens
+  float decimal;  // for floating point numbers
+  Atom atom;      // for name of identifiers
+  NodeId node;    // for nodes of the tree
+  AstList list;   // for statements of a block and the other lists
+  size_t base;    // for the first nested block of a block in the Checker
+  struct { NodeId type; NodeId vars; } decl;  // for declarations
+}
+
 %{
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
-// Maximum size of the symbol table.
-#define TABLE_SIZE 100
+#include "batch.h"
+#include "cache.h"
+#include "descent.h"
+#include "preproc.h"
 
-int yylex();
-void yyerror(char* s);
+void yyerror(Checker* ctx, char* s);
 
-// Keeps track of the current line being parsed.
-int yylineno;
+// Syntax errors recovered from before the parse is given up
+#define MAX_SYNTAX_ERRORS 20
 
-// Tracks scope during parsing
-int scope = 0;
+// Shorthands for the builders of the grammar actions
+#define AST (&ctx->ast)
+#define LINE (ctx->lineno)
 
-// Stores datatype during parsing
-int dtype;
-
-// Structure for a symbol's entry in a symbol table
-typedef struct Symbol
+// Initialize the state of one parse
+void __init__(Checker* ctx, int quiet)
 {
-  char name[10]; // name of the identifier
-  int dtype;     // 0 for int; 1 for float
-  int scope;     // scope of this symbol
-  struct Symbol* next;
-} Symbol;
+  diagInit(&ctx->diag, quiet);
+  ctx->lineno = 1;
+  ctx->syntax_errors = 0;
+  astInit(&ctx->ast);
+  ctx->var_sizes = NULL;
+  ctx->var_names = NULL;
+  ctx->var_count = 0;
+  ctx->var_capacity = 0;
+  ctx->nested = NULL;
+  ctx->nested_count = 0;
+  ctx->nested_capacity = 0;
+  ctx->scope = 0;
+  ctx->dtype = TYPE_INT;
+  ctx->expr_types = NULL;
+  ctx->func_types = NULL;
+  typeTableInit(&ctx->types);
+  internInit(&ctx->names);
+  ctx->table = symtableEmpty();
+  ctx->scopes = NULL;
+  ctx->scopes_capacity = 0;
+  symPoolInit(&ctx->pool);
+  ctx->threads = 1;
+  ctx->stats = NULL;
+  ctx->syntax_only = 0;
+}
 
-// Symbol table structure
-typedef struct Symtable
+// Start over on another part of the same input: the interned names and
+// the line number are kept, everything the parse and the checks built is not
+void resetParse(Checker* ctx)
 {
-  Symbol* entry[TABLE_SIZE];
-} Symtable;
+  diagFree(&ctx->diag);
+  astFree(&ctx->ast);
+  astInit(&ctx->ast);
+  free(ctx->func_types);
+  ctx->func_types = NULL;
+  typeTableFree(&ctx->types);
+  typeTableInit(&ctx->types);
+  symPoolFree(&ctx->pool);
+  ctx->table = symtableEmpty();
+  ctx->syntax_errors = 0;
+  ctx->var_count = 0;
+  ctx->nested_count = 0;
+  ctx->scope = 0;
+  ctx->dtype = TYPE_INT;
+}
 
 /*
-  http://www.cse.yorku.ca/~oz/hash.html -> djb2 algorithm
+  Messages are ordered as if the checks ran while parsing. The lexer and
+  the parser report between the nodes built so far and the next one, and
+  the checks of a node report just after it was built: record order 2*seq
+  comes before node seq, and 2*seq+1 right after it.
+*/
+void report(Checker* ctx, DiagCode code, const char* arg)
+{
+  diagReport(&ctx->diag, 2 * (uint64_t) ctx->ast.seq, code, ctx->lineno, arg);
+}
 
-  this algorithm (k=33) was first reported by dan bernstein many years ago in
-  comp.lang.c. another version of this algorithm (now favored by bernstein)
-  uses xor: hash(i) = hash(i - 1) * 33 ^ str[i]; the magic of number 33 (why
-  it works better than many other constants, prime or not) has never
-  been adequately explained.
+/*
+  Count a syntax error the parser recovered from. A bad file can go on
+  producing errors that only follow from the first ones, so the parse is
+  given up once there have been MAX_SYNTAX_ERRORS; returns 1 then.
 */
-int hash(char *str)
+int recover(Checker* ctx)
 {
-  int hash = 5381;
-  int c;
+  // Only the first error is wanted then
+  if (ctx->syntax_only)
+    return 1;
 
-  while ((c = *str++))
-    hash = ((hash << 5) + hash) + c; // hash * 33 + c
+  if (++ctx->syntax_errors < MAX_SYNTAX_ERRORS)
+    return 0;
 
-  return hash % TABLE_SIZE;
+  report(ctx, DIAG_TOO_MANY_ERRORS, NULL);
+  return 1;
 }
 
-// Global variable for symbol table
-Symtable table;
+/*
+  The lists of the grammar are left recursive, so the parser stack does not
+  grow with their length. Variables and nested blocks still get their nodes
+  where the right recursive lists they replace built them: once the whole
+  declaration or block is read, and from the last one back. Until then
+  they wait here.
+*/
+void pushVar(Checker* ctx, NodeId size, Atom name)
+{
+  if (ctx->syntax_only)
+    return;
+
+  if (ctx->var_count == ctx->var_capacity)
+  {
+    ctx->var_capacity = ctx->var_capacity ? 2 * ctx->var_capacity : 16;
+    ctx->var_sizes = (NodeId*) realloc(ctx->var_sizes, ctx->var_capacity * sizeof(NodeId));
+    ctx->var_names = (Atom*) realloc(ctx->var_names, ctx->var_capacity * sizeof(Atom));
+  }
+
+  ctx->var_sizes[ctx->var_count] = size;
+  ctx->var_names[ctx->var_count] = name;
+  ctx->var_count++;
+}
 
-// Initialize all pointers in the symbol table to NULL
-void __init__()
+// Nodes of the variables of the declaration that ends; returns the first
+NodeId buildVars(Checker* ctx)
 {
-  for (int i = 0; i < TABLE_SIZE; i++)
-    table.entry[i] = NULL;
+  NodeId next = NO_NODE;
+  while (ctx->var_count > 0)
+  {
+    ctx->var_count--;
+    next = astVar(AST, LINE, ctx->var_sizes[ctx->var_count], ctx->var_names[ctx->var_count], next);
+  }
+  return next;
 }
 
-// Function to add a new entry to symbol table
-void add(char* symb)
+void pushNested(Checker* ctx, NodeId block, AstList stmts)
 {
-  int hval = hash(symb);
-  Symbol* head = table.entry[hval];
+  if (ctx->syntax_only)
+    return;
 
-  // No collision
-  if (head == NULL)
+  if (ctx->nested_count == ctx->nested_capacity)
   {
-    head = ( Symbol* )malloc(sizeof(Symbol));
-    strcpy(head->name, symb);
-    head->dtype = dtype;
-    head->scope = scope;
-    head->next = NULL;
-    table.entry[hval] = head;
-    return;
+    ctx->nested_capacity = ctx->nested_capacity ? 2 * ctx->nested_capacity : 16;
+    ctx->nested = (NestedBlock*) realloc(ctx->nested, ctx->nested_capacity * sizeof(NestedBlock));
   }
 
-  // For collision, add this new symbol to the end of list
-  while(head->next != NULL)
-    head = head->next;
+  ctx->nested[ctx->nested_count].block = block;
+  ctx->nested[ctx->nested_count].stmts = stmts;
+  ctx->nested_count++;
+}
 
-  head->next = ( Symbol* )malloc(sizeof(Symbol));
-  strcpy(head->name, symb);
-  head->dtype = dtype;
-  head->scope = scope;
-  head->next = NULL;
+// Statements holding the nested blocks from base on, each followed by the
+// statements after it, for the block that ends
+AstList buildNested(Checker* ctx, size_t base)
+{
+  AstList rest = { NO_NODE, NO_NODE };
+  while (ctx->nested_count > base)
+  {
+    NestedBlock* nested = &ctx->nested[--ctx->nested_count];
+    AstList head = { NO_NODE, NO_NODE };
+    head = astAppendStmt(AST, head, astStmt(AST, LINE, STMT_BLOCK, nested->block, NO_NODE));
+    rest = astConcatStmts(AST, astConcatStmts(AST, head, nested->stmts), rest);
+  }
+  return rest;
+}
+
+// Record a diagnostic of the checks of a node
+void reportAt(Checker* ctx, uint32_t seq, int line, DiagCode code, const char* arg)
+{
+  diagReport(&ctx->diag, 2 * (uint64_t) seq + 1, code, line, arg);
+}
+
+// Function to add a new entry to symbol table
+void add(Checker* ctx, Atom symb, TypeId type)
+{
+  ctx->table = symtableInsert(&ctx->pool, ctx->table, symb, type, ctx->scope);
+  if (ctx->stats != NULL)
+    ctx->stats->inserts++;
+}
+
+// Innermost symbol with the given name, counted and timed if stats are kept
+const Symbol* lookup(Checker* ctx, Atom symb)
+{
+  if (ctx->stats == NULL)
+    return symtableLookup(ctx->table, symb);
+
+  uint64_t start = statsClock();
+  const Symbol* symbol = symtableLookup(ctx->table, symb);
+  uint64_t ns = statsClock() - start;
+  statsLookup(ctx->stats, symtableDepth(ctx->table, symb), symbol != NULL, ns);
+  return symbol;
 }
 
 // Function to check if the variable is being redefined within a function in same scope
-int existsInSameScope(char* symb)
+int existsInSameScope(Checker* ctx, Atom symb, TypeId type)
 {
-  int hval = hash(symb);
-  Symbol* head = table.entry[hval];
-  if (head == NULL)
+  // A symbol of the current scope is always the innermost one of its name
+  const Symbol* symbol = lookup(ctx, symb);
+  if (symbol == NULL || symbol->scope != ctx->scope)
     return 0;
 
-  while (head != NULL)
-  {
-    // If the symbol names match and
-    // the current scope is same as its scope.
-    if (strcmp(head->name, symb) == 0 && head->scope == scope)
-    {
-      // redeclaration
-      if (dtype == head->dtype)
-        return 1;
+  // redeclaration
+  if (type == (TypeId) symbol->dtype)
+    return 1;
 
-      // conflicting types
-      else
-        return 2;
-
-    }
-    head = head->next;
-  }
-  return 0;
+  // conflicting types
+  else
+    return 2;
 }
 
 // Function to check if hashtable contains a particular symbol.
-int contains(char* symb)
+int contains(Checker* ctx, Atom symb)
 {
-  int hval = hash(symb);
-  Symbol* head = table.entry[hval];
-  if (head == NULL)
-    return 0;
+  return lookup(ctx, symb) != NULL;
+}
+
+// Function to get the type of the value a symbol present in symbol table
+// stands for, which for an array is its element type
+TypeId getSymbolDataType(Checker* ctx, Atom symb)
+{
+  const Symbol* symbol = lookup(ctx, symb);
+
+  // not needed since the symbol is known to exist in the table
+  if (symbol == NULL)
+    return TYPE_INT;
 
-  while (head != NULL)
+  return typeValue(&ctx->types, symbol->dtype);
+}
+
+// Function to open a new scope when entering a block
+void enterScope(Checker* ctx)
+{
+  if ((size_t) ctx->scope == ctx->scopes_capacity)
   {
-    // If the symbol names match
-    // then it implies that this identifier is already present
-    if (strcmp(head->name, symb) == 0)
-      return 1;
-    head = head->next;
+    ctx->scopes_capacity = ctx->scopes_capacity ? 2 * ctx->scopes_capacity : 16;
+    ctx->scopes = (Symtable*) realloc(ctx->scopes, ctx->scopes_capacity * sizeof(Symtable));
   }
-  return 0;
+
+  ctx->scopes[ctx->scope] = ctx->table;
+  ctx->scope += 1;
 }
 
-// Function to get the data type of a symbol present in symbol table
-int getSymbolDataType(char* symb)
+// Function to drop the symbols of a scope when coming out of that scope:
+// the table goes back to what it was when the scope was entered
+void exitScope(Checker* ctx)
 {
-  int hval = hash(symb);
-  Symbol* head = table.entry[hval];
-  while (head != NULL)
-  {
-    if (strcmp(head->name, symb) == 0)
-      return head->dtype;
+  if (ctx->scope == 0)
+    return;
 
-    head = head->next;
+  ctx->scope -= 1;
+  if (ctx->stats != NULL)
+  {
+    ctx->stats->scope_exits++;
+    ctx->stats->dropped += ctx->table.size - ctx->scopes[ctx->scope].size;
   }
-  // not needed since the symbol is known to exist in the table
-  return 0;
+  ctx->table = ctx->scopes[ctx->scope];
 }
 
-// Function to delete symbols of a scope when coming out of that scope
-void deleteScopeSymbols(int scope)
+// Declare name with the given type, unless it clashes in this scope
+void declare(Checker* ctx, Atom name, TypeId type, uint32_t seq, int line)
 {
-  for (int i = 0; i < TABLE_SIZE; i++)
-  {
-    Symbol* head = table.entry[i];
-    Symbol* temp;
-    if (head == NULL)
-      continue;
+  int exists = existsInSameScope(ctx, name, type);
+  if (exists == 1)
+    reportAt(ctx, seq, line, DIAG_REDEFINITION, atomName(&ctx->names, name));
+  else if (exists == 2)
+    reportAt(ctx, seq, line, DIAG_CONFLICTING_TYPES, atomName(&ctx->names, name));
+  else
+    add(ctx, name, type);
+}
 
-    // Delete "matching scope" symbols at the start of the list
-    while (head != NULL && head->scope == scope)
-    {
-      temp = head;
-      head = head->next;
-      free(temp);
-      table.entry[i] = head;
-    }
+// Report name unless it is declared
+void checkDefined(Checker* ctx, Atom name, uint32_t seq, int line)
+{
+  if (!contains(ctx, name))
+    reportAt(ctx, seq, line, DIAG_UNDEFINED, atomName(&ctx->names, name));
+}
 
-    // Look for the required symbols using the previous pointer
-    while (head != NULL && head->next != NULL)
-    {
-      // Delete the next symbol
-      if (head->next->scope == scope)
+// Checks of each kind of node, run by the visitor in parse order
+
+void checkType(void* arg, NodeId id)
+{
+  Checker* ctx = (Checker*) arg;
+  const AstType* type = &ctx->ast.types.items[id];
+
+  ctx->dtype = type->dtype;
+  reportAt(ctx, type->seq, type->line, type->dtype ? DIAG_FLOAT_DECLARED : DIAG_INT_DECLARED, NULL);
+}
+
+void checkExpr(void* arg, NodeId id)
+{
+  Checker* ctx = (Checker*) arg;
+  const AstExpr* expr = &ctx->ast.exprs.items[id];
+  TypeId* types = ctx->expr_types;
+
+  switch (expr->kind)
+  {
+    case EXPR_INT:
+      types[id] = TYPE_INT;
+      break;
+    case EXPR_REAL:
+      types[id] = TYPE_FLOAT;
+      break;
+    case EXPR_ID:
+      if (!contains(ctx, expr->name))
       {
-        temp = head->next;
-        head->next = temp->next;
-        free(temp);
+        reportAt(ctx, expr->seq, expr->line, DIAG_UNDEFINED, atomName(&ctx->names, expr->name));
+        types[id] = NO_TYPE;
       }
-
-      // Move the pointer forward
       else
-        head = head->next;
-
-    }
+        types[id] = getSymbolDataType(ctx, expr->name);
+      break;
+    case EXPR_PAREN:
+      types[id] = types[expr->lhs];
+      break;
+    case EXPR_BINARY:
+      if (types[expr->lhs] != types[expr->rhs])
+        reportAt(ctx, expr->seq, expr->line, DIAG_EXPRESSION_TYPE, NULL);
+      types[id] = types[expr->lhs];
+      break;
+    case EXPR_INCREMENT:
+    case EXPR_DECREMENT:
+      checkDefined(ctx, expr->name, expr->seq, expr->line);
+      types[id] = NO_TYPE;
+      break;
   }
 }
 
-// Helper function to print symbols in symbol table
-void printSymbolTable()
+void checkVar(void* arg, NodeId id)
+{
+  Checker* ctx = (Checker*) arg;
+  const AstVar* var = &ctx->ast.vars.items[id];
+
+  if (var->array == ARRAY_REAL)
+    reportAt(ctx, var->array_seq, var->array_line, DIAG_ARRAY_SIZE, NULL);
+
+  // The parse stopped before the variable was named
+  if (var->name == NO_NAME)
+    return;
+
+  TypeId type = ctx->dtype;
+  if (var->array == ARRAY_INT)
+    type = typeArray(&ctx->types, type, (uint32_t) var->length);
+
+  declare(ctx, var->name, type, var->seq, var->line);
+}
+
+void checkAssign(void* arg, NodeId id)
+{
+  Checker* ctx = (Checker*) arg;
+  const AstAssign* assign = &ctx->ast.assigns.items[id];
+
+  if (!contains(ctx, assign->name))
+    reportAt(ctx, assign->seq, assign->line, DIAG_UNDEFINED, atomName(&ctx->names, assign->name));
+  else if (getSymbolDataType(ctx, assign->name) != ctx->expr_types[assign->expr])
+    reportAt(ctx, assign->seq, assign->line, DIAG_ASSIGNMENT_TYPE, NULL);
+}
+
+void checkArg(void* arg, NodeId id)
+{
+  Checker* ctx = (Checker*) arg;
+  const AstArg* call_arg = &ctx->ast.args.items[id];
+
+  if (call_arg->kind == ARG_ID)
+    checkDefined(ctx, call_arg->name, call_arg->seq, call_arg->line);
+}
+
+void checkCall(void* arg, NodeId id)
+{
+  Checker* ctx = (Checker*) arg;
+  const AstCall* call = &ctx->ast.calls.items[id];
+
+  if (call->target != NO_NAME)
+    checkDefined(ctx, call->target, call->seq, call->line);
+}
+
+void checkCond(void* arg, NodeId id)
+{
+  Checker* ctx = (Checker*) arg;
+  const AstCond* cond = &ctx->ast.conds.items[id];
+
+  if (ctx->expr_types[cond->lhs] != ctx->expr_types[cond->rhs])
+    reportAt(ctx, cond->seq, cond->line, DIAG_OPERAND_TYPE, NULL);
+}
+
+void checkStmt(void* arg, NodeId id)
+{
+  static const DiagCode notes[] = {
+    [STMT_RETURN]      = DIAG_RETURN_OK,
+    [STMT_DECLARATION] = DIAG_DECLARATION_OK,
+    [STMT_ASSIGN]      = DIAG_ASSIGNMENT_OK,
+    [STMT_CALL]        = DIAG_CALL_OK,
+    [STMT_ITER]        = DIAG_ITERATION_OK,
+    [STMT_IF]          = DIAG_CONDITIONAL_OK,
+  };
+  Checker* ctx = (Checker*) arg;
+  const AstStmt* stmt = &ctx->ast.stmts.items[id];
+
+  // Nested blocks are not statements of the grammar
+  if (stmt->kind != STMT_BLOCK)
+    reportAt(ctx, stmt->seq, stmt->line, notes[stmt->kind], NULL);
+}
+
+void checkEnterBlock(void* arg, NodeId id)
+{
+  (void) id;
+  enterScope((Checker*) arg);
+}
+
+void checkExitBlock(void* arg, NodeId id)
+{
+  (void) id;
+  exitScope((Checker*) arg);
+}
+
+void checkParam(void* arg, NodeId id)
+{
+  Checker* ctx = (Checker*) arg;
+  const AstParam* param = &ctx->ast.params.items[id];
+
+  declare(ctx, param->name, ctx->dtype, param->seq, param->line);
+}
+
+void checkFunc(void* arg, NodeId id)
 {
-  for (int i = 0; i < TABLE_SIZE; i++)
+  Checker* ctx = (Checker*) arg;
+  const Ast* ast = &ctx->ast;
+  const AstFunc* func = &ast->funcs.items[id];
+
+  uint32_t count = 0;
+  for (NodeId param = func->params; param != NO_NODE; param = ast->params.items[param].next)
+    count++;
+
+  TypeId* params = (TypeId*) malloc((count + 1) * sizeof(TypeId));
+  count = 0;
+  for (NodeId param = func->params; param != NO_NODE; param = ast->params.items[param].next)
+    params[count++] = ast->types.items[ast->params.items[param].type].dtype;
+
+  TypeId result = ast->types.items[func->type].dtype;
+  ctx->func_types[id] = typeFunction(&ctx->types, result, params, count);
+  free(params);
+
+  reportAt(ctx, func->seq, func->line, func->name == NO_NAME ? DIAG_MAIN_OK : DIAG_FUNCTION_OK, NULL);
+}
+
+const AstVisitor checks = {
+  .type = checkType,
+  .expr = checkExpr,
+  .var = checkVar,
+  .assign = checkAssign,
+  .arg = checkArg,
+  .call = checkCall,
+  .cond = checkCond,
+  .stmt = checkStmt,
+  .enterBlock = checkEnterBlock,
+  .exitBlock = checkExitBlock,
+  .param = checkParam,
+  .func = checkFunc,
+};
+
+// The bodies of the functions of a program, checked at once
+typedef struct FunctionChecks
+{
+  Checker base;        // what every body shares
+  Checker* ctx;
+  NodeId* funcs;       // main, then the user defined functions
+  Symtable* outer;     // the table each body starts from
+  Diagnostics* diags;  // what the checks of each body reported
+  SymtableStats* stats;  // of the table of each body, if kept
+} FunctionChecks;
+
+void checkBody(size_t i, void* arg)
+{
+  FunctionChecks* bodies = (FunctionChecks*) arg;
+
+  // The tree, the names and the expression types are shared, and each
+  // body only sets the types of its own expressions. Anything a body
+  // adds to the table or the types is its own.
+  Checker worker = bodies->base;
+  diagInit(&worker.diag, bodies->base.diag.quiet);
+  typeTableInit(&worker.types);
+  worker.table = bodies->outer[i];
+  worker.scope = 0;
+  worker.scopes = NULL;
+  worker.scopes_capacity = 0;
+  symPoolInit(&worker.pool);
+  if (worker.stats != NULL)
   {
-    if (table.entry[i] == NULL)
-      continue;
+    worker.stats = &bodies->stats[i];
+    statsInit(worker.stats);
+  }
 
-    printf("\nPrinting at index %d\n",i);
-    Symbol* head = table.entry[i];
-    while (head != NULL)
-    {
-      printf("%s %d %d\n",head->name, head->dtype, head->scope);
-      head = head->next;
-    }
+  astVisitBlock(&worker.ast, worker.ast.funcs.items[bodies->funcs[i]].body, &checks, &worker);
+
+  bodies->diags[i] = worker.diag;
+  free(worker.scopes);
+  symPoolFree(&worker.pool);
+  typeTableFree(&worker.types);
+}
+
+// Records are ordered by node, so they fall in place whenever they come
+void mergeBody(size_t i, void* arg)
+{
+  FunctionChecks* bodies = (FunctionChecks*) arg;
+  Diagnostics* diag = &bodies->diags[i];
+
+  for (size_t k = 0; k < diag->count; k++)
+  {
+    const Diagnostic* record = &diag->records[k];
+    diagReport(&bodies->ctx->diag, record->order, record->code, record->line, record->arg);
   }
+  diagFree(diag);
+
+  if (bodies->ctx->stats != NULL)
+    statsMerge(bodies->ctx->stats, &bodies->stats[i]);
 }
 
-// Free all the DMA space of hashtable
-void __freeMemory__()
+/*
+  Check the functions of a complete program on ctx->threads threads. The
+  result types and parameters are checked first, in program order, which
+  declares the parameters in the outermost scope. The table right after
+  the parameters of a function is what its body sees when the program is
+  checked in order, and since the table is persistent, keeping it is
+  keeping a snapshot. The bodies only read their snapshots and add to
+  versions of their own, so they are checked in parallel.
+*/
+void checkFunctions(Checker* ctx)
 {
-  for (int i = 0; i < TABLE_SIZE; i++)
+  const Ast* ast = &ctx->ast;
+  FunctionChecks bodies;
+  size_t count = 0;
+
+  bodies.ctx = ctx;
+  bodies.funcs = (NodeId*) malloc((ast->funcs.count + 1) * sizeof(NodeId));
+  bodies.outer = (Symtable*) malloc((ast->funcs.count + 1) * sizeof(Symtable));
+  bodies.diags = (Diagnostics*) malloc((ast->funcs.count + 1) * sizeof(Diagnostics));
+  bodies.stats = ctx->stats ? (SymtableStats*) malloc((ast->funcs.count + 1) * sizeof(SymtableStats)) : NULL;
+
+  if (ast->main != NO_NODE)
+    bodies.funcs[count++] = ast->main;
+  for (NodeId func = ast->functions; func != NO_NODE; func = ast->funcs.items[func].next)
+    bodies.funcs[count++] = func;
+
+  for (size_t i = 0; i < count; i++)
   {
-    Symbol* head = table.entry[i];
-    Symbol* temp;
-    while (head!=NULL)
-    {
-      temp = head;
-      head = head->next;
-      free(temp);
-    }
+    astVisitSignature(ast, bodies.funcs[i], &checks, ctx);
+    bodies.outer[i] = ctx->table;
+    checkFunc(ctx, bodies.funcs[i]);
   }
+
+  bodies.base = *ctx;
+  batchRun(count, ctx->threads, checkBody, mergeBody, &bodies);
+
+  free(bodies.funcs);
+  free(bodies.outer);
+  free(bodies.diags);
+  free(bodies.stats);
 }
 
-%}
+// Run the checks over the tree, or whatever part of it was parsed
+void checkTree(Checker* ctx)
+{
+  ctx->expr_types = (TypeId*) malloc((ctx->ast.exprs.count + 1) * sizeof(TypeId));
+  ctx->func_types = (TypeId*) malloc((ctx->ast.funcs.count + 1) * sizeof(TypeId));
+  if (ctx->threads > 1 && ctx->ast.complete)
+    checkFunctions(ctx);
+  else
+    astVisit(&ctx->ast, &checks, ctx);
+  free(ctx->expr_types);
+  ctx->expr_types = NULL;
+}
 
-%union
+// Helper function to print symbols in symbol table
+void printSymbolTable(Checker* ctx)
 {
-  int number;     // for integer constants
-  float decimal;  // for floating point numbers
-  char* string;   // for name of identifiers
-  int dtype;      // for datatype of expressions
+  symtablePrint(ctx->table, &ctx->names);
 }
 
+// Free all the DMA space of hashtable
+void __freeMemory__(Checker* ctx)
+{
+  symPoolFree(&ctx->pool);
+  free(ctx->scopes);
+  free(ctx->var_sizes);
+  free(ctx->var_names);
+  free(ctx->nested);
+  astFree(&ctx->ast);
+  free(ctx->func_types);
+  typeTableFree(&ctx->types);
+  internFree(&ctx->names);
+  diagFree(&ctx->diag);
+}
+
+%}
+
 // Keywords
 %token          AUTO_TOK
 %token          BREAK_TOK
@@ -305,14 +746,26 @@ void __freeMemory__()
 
 %token          ID_TOK
 
+// Never scanned: put in front of the tokens of a user defined function
+// to parse it on its own
+%token          FUNCTION_UNIT_TOK
+
 %nonassoc       LOWER_THAN_ELSE
 %nonassoc       ELSE_TOK
 
 // %type tells bison which member of the yylval union is used by which expression
 %type<number>   INT_CONST_TOK
-%type<string>   ID_TOK
+%type<atom>     ID_TOK
 %type<decimal>  REALCONST_TOK
-%type<dtype>    EXPRESSION
+%type<node>     EXPRESSION DATATYPE MAIN_FN BLK BLK_START STMT ARRAY_OPTN ASSIGN
+%type<node>     COND ELSE_PART ITER INNER_BODY BODY_START INIT_PART CHANGE_PART
+%type<node>     COND_PART CONDITION FN_CALL FN_SIGN OPTIONS PARAM
+%type<node>     US_DEF_FN OPTIONS_FORMAL PARAM_FORMAL
+%type<list>     STMTS CONDITIONS PARAMS US_DEF_FNS PARAMS_FORMAL
+%type<base>     BLKS
+%type<decl>     DECLARATION
+%type<number>   LOGIC_OP RELAT_OP
+%type<atom>     FN_NAME
 
 %left           '+' '-'
 %left           '*' '/' '%'
@@ -321,313 +774,866 @@ void __freeMemory__()
 
 %%
 
-S:              MAIN_FN US_DEF_FNS
+S:              MAIN_FN US_DEF_FNS            { astProgram(AST, $1, $2.first); }
+                |
+                FUNCTION_UNIT_TOK US_DEF_FN   { astProgram(AST, NO_NODE, $2); }
                 ;
-MAIN_FN:        DATATYPE MAIN_TOK '(' ')' BLK {printf("\nSyntax of main function is correct");}
+MAIN_FN:        DATATYPE MAIN_TOK '(' ')' BLK { $$ = astFunc(AST, LINE, $1, NO_NAME, NO_NODE, $5); }
                 ;
-BLK:            BLK_START STMTS BLKS BLK_END
+BLK:            BLK_START STMTS BLKS BLK_END  { astCloseBlock(AST, $1, astConcatStmts(AST, $2, buildNested(ctx, $3)).first);
+                                                $$ = $1;
+                                              }
+                |
+                BLK_START STMTS error BLK_END { if (recover(ctx)) YYABORT;
+                                                yyerrok;
+                                                astCloseBlock(AST, $1, $2.first);
+                                                $$ = $1;
+                                              }
                 ;
-BLK_START:      '{'                           { scope += 1; }
+BLK_START:      '{'                           { $$ = astOpenBlock(AST, LINE); }
                 ;
-BLK_END:        '}'                           { deleteScopeSymbols(scope); scope -= 1; }
+BLK_END:        '}'
                 ;
-BLKS:           BLK STMTS BLKS
-                |
+BLKS:           BLKS BLK STMTS                { pushNested(ctx, $2, $3);
+                                                $$ = $1;
+                                              }
+                |                             { $$ = ctx->nested_count; }
                 ;
-STMTS:          STMTS STMT
-                |
+STMTS:          STMTS STMT                    { $$ = astAppendStmt(AST, $1, $2); }
+                |                             { $$.first = $$.last = NO_NODE; }
                 ;
-STMT:           RETURN_TOK EXPRESSION ';'     {printf("\nSyntax of return statement is correct");}
+STMT:           RETURN_TOK EXPRESSION ';'     { $$ = astStmt(AST, LINE, STMT_RETURN, $2, NO_NODE); }
+                |
+                DECLARATION ';'               { $$ = astStmt(AST, LINE, STMT_DECLARATION, $1.type, $1.vars); }
                 |
-                DECLARATION ';'               {printf("\nSyntax of declaration statement is correct");}
+                ASSIGN ';'                    { $$ = astStmt(AST, LINE, STMT_ASSIGN, $1, NO_NODE); }
                 |
-                ASSIGN ';'                    {printf("\nSyntax of assignment statement is correct");}
+                FN_CALL ';'                   { $$ = astStmt(AST, LINE, STMT_CALL, $1, NO_NODE); }
                 |
-                FN_CALL ';'                   {printf("\nSyntax of function call is correct");}
+                ITER                          { $$ = astStmt(AST, LINE, STMT_ITER, $1, NO_NODE); }
                 |
-                ITER                          {printf("\nSyntax of iterative statement is correct");}
+                COND                          { $$ = astStmt(AST, LINE, STMT_IF, $1, NO_NODE); }
                 |
-                COND                          {printf("\nSyntax of conditional statement is correct");}
+                error ';'                     { if (recover(ctx)) YYABORT;
+                                                yyerrok;
+                                                $$ = NO_NODE;
+                                              }
                 ;
-DECLARATION:    DATATYPE VARS
+DECLARATION:    DATATYPE VARS                 { $$.type = $1; $$.vars = buildVars(ctx); }
                 ;
-DATATYPE:       INT_TOK                       { dtype = 0;
-                                                printf("\n Integer declared in line %d.\n", yylineno);
-                                              }
+DATATYPE:       INT_TOK                       { $$ = astType(AST, LINE, 0); }
                 |
-                FLOAT_TOK                     { dtype = 1;
-                                                printf("\n Float declared in line %d\n", yylineno);
-                                              }
+                FLOAT_TOK                     { $$ = astType(AST, LINE, 1); }
                 ;
-VARS:           ID_TOK ARRAY_OPTN             { int type = existsInSameScope($1);
-                                                if (type == 1)
-                                                {
-                                                  char buff[50];
-                                                  sprintf(buff,": Multiple definitions of the identifier %s",$1);
-                                                  yyerror(buff);
-                                                }
-                                                else if (type == 2)
-                                                {
-                                                  char buff[50];
-                                                  sprintf(buff,": Conflicting types for the identifier %s",$1);
-                                                  yyerror(buff);
-                                                }
-                                                else
-                                                {
-                                                  add($1);
-                                                }
+VARS:           ID_TOK ARRAY_OPTN             { ctx->var_count = 0;
+                                                pushVar(ctx, $2, $1);
                                               }
                 |
-                ID_TOK ARRAY_OPTN ',' VARS    { int type = existsInSameScope($1);
-                                                if (type == 1)
-                                                {
-                                                  char buff[50];
-                                                  sprintf(buff,": Multiple definitions of the identifier %s",$1);
-                                                  yyerror(buff);
-                                                }
-                                                else if (type == 2)
-                                                {
-                                                  char buff[50];
-                                                  sprintf(buff,": Conflicting types for the identifier %s",$1);
-                                                  yyerror(buff);
-                                                }
-                                                else
-                                                {
-                                                  add($1);
-                                                }
-                                              }
+                VARS ',' ID_TOK ARRAY_OPTN    { pushVar(ctx, $4, $3); }
                 ;
-ARRAY_OPTN:     '[' INT_CONST_TOK ']'
-                |
-                '[' REALCONST_TOK ']'         { char buff[40];
-                                                sprintf(buff,": Incorrect Array Declaration");
-                                                yyerror(buff);
-                                              }
+ARRAY_OPTN:     '[' INT_CONST_TOK ']'         { $$ = astArraySize(AST, LINE, ARRAY_INT, $2); }
                 |
+                '[' REALCONST_TOK ']'         { $$ = astArraySize(AST, LINE, ARRAY_REAL, 0); }
+                |                             { $$ = astArraySize(AST, LINE, ARRAY_NONE, 0); }
                 ;
-ASSIGN:         ID_TOK '=' EXPRESSION         { if (!contains($1))
-                                                {
-                                                  char buff[40];
-                                                  sprintf(buff,": Undefined identifier %s",$1);
-                                                  yyerror(buff);
-                                                }
-                                                else
-                                                {
-                                                  if (getSymbolDataType($1)!=$3)
-                                                  {
-                                                    char buff[50];
-                                                    sprintf(buff,": Illegal assignment (Type Error) detected");
-                                                    yyerror(buff);
-                                                  }
-                                                }
-                                            }
+ASSIGN:         ID_TOK '=' EXPRESSION         { $$ = astAssign(AST, LINE, $1, $3); }
                 ;
-EXPRESSION:     '(' EXPRESSION ')'          { $$ = $2; }
+EXPRESSION:     '(' EXPRESSION ')'          { $$ = astExpr(AST, LINE, EXPR_PAREN, 0, $2, NO_NODE, NO_NAME); }
                 |
-                EXPRESSION '+' EXPRESSION   { if ($1 != $3)
-                                              {
-                                                char buff[40];
-                                                sprintf(buff,": Type error in expression");
-                                                yyerror(buff);
-                                              }
-                                              $$ = $1;
-                                            }
+                EXPRESSION '+' EXPRESSION   { $$ = astExpr(AST, LINE, EXPR_BINARY, '+', $1, $3, NO_NAME); }
                 |
-                EXPRESSION '-' EXPRESSION   { if ($1 != $3)
-                                              {
-                                                char buff[40];
-                                                sprintf(buff,": Type error in expression");
-                                                yyerror(buff);
-                                              }
-                                              $$ = $1;
-                                            }
+                EXPRESSION '-' EXPRESSION   { $$ = astExpr(AST, LINE, EXPR_BINARY, '-', $1, $3, NO_NAME); }
                 |
-                EXPRESSION '*' EXPRESSION   { if ($1 != $3)
-                                              {
-                                                char buff[40];
-                                                sprintf(buff,": Type error in expression");
-                                                yyerror(buff);
-                                              }
-                                              $$ = $1;
-                                            }
+                EXPRESSION '*' EXPRESSION   { $$ = astExpr(AST, LINE, EXPR_BINARY, '*', $1, $3, NO_NAME); }
                 |
-                EXPRESSION '/' EXPRESSION   { if ($1 != $3)
-                                              {
-                                                char buff[40];
-                                                sprintf(buff,": Type error in expression");
-                                                yyerror(buff);
-                                              }
-                                              $$ = $1;
-                                            }
+                EXPRESSION '/' EXPRESSION   { $$ = astExpr(AST, LINE, EXPR_BINARY, '/', $1, $3, NO_NAME); }
                 |
-                EXPRESSION '%' EXPRESSION   { if ($1 != $3)
-                                              {
-                                                char buff[40];
-                                                sprintf(buff,": Type error in expression");
-                                                yyerror(buff);
-                                              }
-                                              $$ = $1;
-                                            }
+                EXPRESSION '%' EXPRESSION   { $$ = astExpr(AST, LINE, EXPR_BINARY, '%', $1, $3, NO_NAME); }
                 |
-                INT_CONST_TOK               { $$ = 0; }
+                INT_CONST_TOK               { $$ = astExpr(AST, LINE, EXPR_INT, 0, NO_NODE, NO_NODE, NO_NAME); }
                 |
-                REALCONST_TOK               { $$ = 1; }
+                REALCONST_TOK               { $$ = astExpr(AST, LINE, EXPR_REAL, 0, NO_NODE, NO_NODE, NO_NAME); }
                 |
-                ID_TOK                      { if (!contains($1))
-                                              {
-                                                char buff[40];
-                                                sprintf(buff,": Undefined identifier %s",$1);
-                                                yyerror(buff);
-                                              }
-                                              else
-                                              {
-                                                $$ = getSymbolDataType($1);
-                                              }
-                                            }
-
-LOGIC_OP:       AND_TOK
+                ID_TOK                      { $$ = astExpr(AST, LINE, EXPR_ID, 0, NO_NODE, NO_NODE, $1); }
+                ;
+LOGIC_OP:       AND_TOK                     { $$ = AND_TOK; }
                 |
-                OR_TOK
+                OR_TOK                      { $$ = OR_TOK; }
                 ;
-RELAT_OP:       LEQ_TOK
+RELAT_OP:       LEQ_TOK                     { $$ = LEQ_TOK; }
                 |
-                '<'
+                '<'                         { $$ = '<'; }
                 |
-                GEQ_TOK
+                GEQ_TOK                     { $$ = GEQ_TOK; }
                 |
-                '>'
+                '>'                         { $$ = '>'; }
                 |
-                EQEQ_TOK
+                EQEQ_TOK                    { $$ = EQEQ_TOK; }
                 |
-                NOT_EQ_TOK
+                NOT_EQ_TOK                  { $$ = NOT_EQ_TOK; }
                 ;
 COND:           IF_TOK '(' COND_PART ')' INNER_BODY %prec LOWER_THAN_ELSE
+                                            { $$ = astIf(AST, LINE, $3, $5, NO_NODE); }
                 |
                 IF_TOK '(' COND_PART ')' INNER_BODY ELSE_PART
+                                            { $$ = astIf(AST, LINE, $3, $5, $6); }
                 ;
-ELSE_PART:      ELSE_TOK INNER_BODY
+ELSE_PART:      ELSE_TOK INNER_BODY         { $$ = $2; }
                 ;
 ITER:           FOR_TOK '(' INIT_PART ';' COND_PART ';' CHANGE_PART ')' INNER_BODY
+                                            { $$ = astIter(AST, LINE, ITER_FOR, $3, $5, $7, $9); }
                 |
                 WHILE_TOK '(' COND_PART ')' INNER_BODY
+                                            { $$ = astIter(AST, LINE, ITER_WHILE, NO_NODE, $3, NO_NODE, $5); }
                 |
                 DO_TOK INNER_BODY WHILE_TOK '(' COND_PART ')' ';'
+                                            { $$ = astIter(AST, LINE, ITER_DO, NO_NODE, $5, NO_NODE, $2); }
                 ;
-INNER_BODY:     BODY_START STMT              { deleteScopeSymbols(scope); scope -= 1; }
+INNER_BODY:     BODY_START STMT             { astCloseBlock(AST, $1, $2);
+                                              $$ = $1;
+                                            }
                 |
                 BLK
                 ;
-BODY_START:     {scope+=1;}
+BODY_START:                                 { $$ = astOpenBlock(AST, LINE); }
                 ;
 INIT_PART:      ASSIGN
-                |
+                |                           { $$ = NO_NODE; }
                 ;
-CHANGE_PART:    ID_TOK '+' '+'                {if (!contains($1))
-                                                {
-                                                  char buff[40];
-                                                  sprintf(buff,": Undefined identifier %s",$1);
-                                                  yyerror(buff);
-                                                }
-                                              }
-                |
-                ID_TOK '-' '-'                {if (!contains($1))
-                                                {
-                                                  char buff[40];
-                                                  sprintf(buff,": Undefined identifier %s",$1);
-                                                  yyerror(buff);
-                                                }
-                                              }
+CHANGE_PART:    ID_TOK '+' '+'              { $$ = astExpr(AST, LINE, EXPR_INCREMENT, 0, NO_NODE, NO_NODE, $1); }
                 |
+                ID_TOK '-' '-'              { $$ = astExpr(AST, LINE, EXPR_DECREMENT, 0, NO_NODE, NO_NODE, $1); }
+                |                           { $$ = NO_NODE; }
                 ;
-COND_PART:      CONDITIONS
-                |
+COND_PART:      CONDITIONS                  { $$ = $1.first; }
+                |                           { $$ = NO_NODE; }
                 ;
-CONDITIONS:     CONDITION
+CONDITIONS:     CONDITION                   { $$.first = $$.last = $1; }
                 |
-                CONDITION LOGIC_OP CONDITIONS
+                CONDITIONS LOGIC_OP CONDITION
+                                            { $$ = astAppendCond(AST, $1, $2, $3); }
                 ;
-CONDITION:      EXPRESSION RELAT_OP EXPRESSION  { if ($1 != $3)
-                                                  {
-                                                    char buff[40];
-                                                    sprintf(buff,": Type mismatch in operands");
-                                                    yyerror(buff);
-                                                  }
-                                                }
+CONDITION:      EXPRESSION RELAT_OP EXPRESSION
+                                            { $$ = astCond(AST, LINE, $2, $1, $3); }
                 ;
-FN_CALL:        ID_TOK '=' FN_SIGN              {if (!contains($1))
-                                                  {
-                                                    char buff[40];
-                                                    sprintf(buff,": Undefined identifier %s",$1);
-                                                    yyerror(buff);
-                                                  }
-                                                }
+FN_CALL:        ID_TOK '=' FN_SIGN          { astCallTarget(AST, LINE, $3, $1);
+                                              $$ = $3;
+                                            }
                 |
                 FN_SIGN
                 ;
-FN_SIGN:        ID_TOK '(' OPTIONS ')'
+FN_SIGN:        ID_TOK '(' OPTIONS ')'      { $$ = astCall(AST, LINE, $1, $3); }
                 ;
-OPTIONS:        PARAMS
-                |
+OPTIONS:        PARAMS                      { $$ = $1.first; }
+                |                           { $$ = NO_NODE; }
                 ;
-PARAMS:         PARAM
+PARAMS:         PARAM                       { $$.first = $$.last = $1; }
                 |
-                PARAM ',' PARAMS
+                PARAMS ',' PARAM            { $$ = astAppendArg(AST, $1, $3); }
                 ;
-PARAM:          ID_TOK                           {if (!contains($1))
-                                                    { char buff[40];
-                                                      sprintf(buff,": Undefined identifier %s",$1);
-                                                      yyerror(buff);
-                                                    }
-                                                  }
+PARAM:          ID_TOK                      { $$ = astArg(AST, LINE, ARG_ID, $1); }
                 |
-                INT_CONST_TOK
+                INT_CONST_TOK               { $$ = astArg(AST, LINE, ARG_INT, NO_NAME); }
                 |
-                REALCONST_TOK
+                REALCONST_TOK               { $$ = astArg(AST, LINE, ARG_REAL, NO_NAME); }
                 ;
-US_DEF_FNS:     US_DEF_FN US_DEF_FNS
-                |
+US_DEF_FNS:     US_DEF_FNS US_DEF_FN        { $$ = astAppendFunc(AST, $1, $2); }
+                |                           { $$.first = $$.last = NO_NODE; }
                 ;
-US_DEF_FN:      DATATYPE FN_NAME '(' OPTIONS_FORMAL ')' BLK    {printf("\nSyntax of user defined function is correct");}
+US_DEF_FN:      DATATYPE FN_NAME '(' OPTIONS_FORMAL ')' BLK
+                                            { $$ = astFunc(AST, LINE, $1, $2, $4, $6); }
                 ;
 FN_NAME:        ID_TOK
                 ;
-OPTIONS_FORMAL: PARAMS_FORMAL
-                |
-                ;
-PARAMS_FORMAL:  PARAM_FORMAL
-                |
-                PARAM_FORMAL ',' PARAMS_FORMAL
-                ;
-PARAM_FORMAL:   DATATYPE ID_TOK { int type = existsInSameScope($2);
-                                  if(type == 1)
-                                  {
-                                    char buff[50];
-                                    sprintf(buff,": Multiple definitions of the identifier %s",$2);
-                                    yyerror(buff);
-                                  }
-                                  else if(type == 2)
-                                  {
-                                    char buff[50];
-                                    sprintf(buff,": Conflicting types for the identifier %s",$2);
-                                    yyerror(buff);
-                                  }
-                                  else
-                                  {
-                                    add($2);
-                                  }
-                                }
+OPTIONS_FORMAL: PARAMS_FORMAL               { $$ = $1.first; }
+                |                           { $$ = NO_NODE; }
+                ;
+PARAMS_FORMAL:  PARAM_FORMAL                { $$.first = $$.last = $1; }
+                |
+                PARAMS_FORMAL ',' PARAM_FORMAL
+                                            { $$ = astAppendParam(AST, $1, $3); }
+                ;
+PARAM_FORMAL:   DATATYPE ID_TOK             { $$ = astParam(AST, LINE, $1, $2); }
+                ;
 %%
 
-int main()
+// Reentrant lexer generated from lexrules.l
+int yylex(YYSTYPE* lvalp, void* scanner);
+int yylex_init_extra(Checker* ctx, void** scanner);
+void yyset_in(FILE* in, void* scanner);
+int yylex_destroy(void* scanner);
+
+// Parse one file, pushing each token to the parser as soon as it is scanned
+int check(Checker* ctx, FILE* in)
 {
-    __init__();
-    if (yyparse() == 0)
-      printf("\nParse Complete.\n");
-    __freeMemory__();
-    return 0;
+  void* scanner;
+  yylex_init_extra(ctx, &scanner);
+  yyset_in(in, scanner);
+
+  yypstate* parser = yypstate_new();
+  int status;
+
+  do
+  {
+    YYSTYPE lval;
+    int token = yylex(&lval, scanner);
+    status = yypush_parse(parser, token, &lval, ctx);
+  } while (status == YYPUSH_MORE);
+
+  yypstate_delete(parser);
+  yylex_destroy(scanner);
+
+  checkTree(ctx);
+  return status;
+}
+
+// Parse one file with the recursive descent parser instead
+int checkDescent(Checker* ctx, FILE* in)
+{
+  void* scanner;
+  yylex_init_extra(ctx, &scanner);
+  yyset_in(in, scanner);
+
+  int status = parseDescent(ctx, scanner);
+  yylex_destroy(scanner);
+
+  checkTree(ctx);
+  return status;
+}
+
+/*
+  Only find out whether a file parses, as fast as the lexer and the parser
+  go: the actions build no tree, the lexer interns no names and nothing is
+  checked. The parse stops at the first error, before the token after it
+  is even pushed, so that error is the only diagnostic recorded. Returns 0
+  if the file parses.
+*/
+int checkSyntax(Checker* ctx, FILE* in)
+{
+  ctx->syntax_only = 1;
+  ctx->ast.discard = 1;
+
+  void* scanner;
+  yylex_init_extra(ctx, &scanner);
+  yyset_in(in, scanner);
+
+  yypstate* parser = yypstate_new();
+  int status = YYPUSH_MORE;
+
+  while (status == YYPUSH_MORE && ctx->diag.errors == 0)
+  {
+    YYSTYPE lval;
+    int token = yylex(&lval, scanner);
+    if (ctx->diag.errors == 0)
+      status = yypush_parse(parser, token, &lval, ctx);
+  }
+
+  yypstate_delete(parser);
+  yylex_destroy(scanner);
+  return ctx->diag.errors != 0 || status != 0;
+}
+
+// A token scanned ahead of parsing
+typedef struct Token
+{
+  int token;
+  YYSTYPE lval;
+  int line;          // line the lexer was on once it was scanned
+  size_t diag_end;   // end of the lexer diagnostics reported up to it
+} Token;
+
+// All the tokens of a file, the last one being the end of input
+typedef struct TokenList
+{
+  Token* tokens;
+  size_t count;
+  size_t capacity;
+  Diagnostics lexed;  // every diagnostic of the lexer, in order
+} TokenList;
+
+void scanTokens(Checker* ctx, FILE* in, TokenList* list)
+{
+  void* scanner;
+  yylex_init_extra(ctx, &scanner);
+  yyset_in(in, scanner);
+
+  list->tokens = NULL;
+  list->count = list->capacity = 0;
+
+  Token* token;
+  do
+  {
+    if (list->count == list->capacity)
+    {
+      list->capacity = list->capacity ? 2 * list->capacity : 1024;
+      list->tokens = (Token*) realloc(list->tokens, list->capacity * sizeof(Token));
+    }
+
+    // unitKey() hashes the values of constants, so none is left unset
+    token = &list->tokens[list->count++];
+    memset(&token->lval, 0, sizeof(token->lval));
+    token->token = yylex(&token->lval, scanner);
+    token->line = ctx->lineno;
+    token->diag_end = ctx->diag.count;
+  } while (token->token != 0);
+
+  yylex_destroy(scanner);
+
+  // The diagnostics are reported again as the tokens are parsed
+  list->lexed = ctx->diag;
+  diagInit(&ctx->diag, ctx->diag.quiet);
+}
+
+void freeTokens(TokenList* list)
+{
+  free(list->tokens);
+  diagFree(&list->lexed);
+}
+
+/*
+  Push tokens [begin, end) to a new parser, followed by the end of input
+  if they do not end with it, and check the tree. Each token is preceded
+  by the diagnostics the lexer reported while scanning it, so everything
+  is recorded as if the lexer ran along. A unit is a user defined
+  function parsed on its own.
+*/
+int parseTokens(Checker* ctx, const TokenList* list, size_t begin, size_t end, int unit)
+{
+  yypstate* parser = yypstate_new();
+  int status = YYPUSH_MORE;
+  YYSTYPE none = { 0 };
+
+  if (unit)
+    status = yypush_parse(parser, FUNCTION_UNIT_TOK, &none, ctx);
+
+  for (size_t i = begin; i < end && status == YYPUSH_MORE; i++)
+  {
+    const Token* token = &list->tokens[i];
+    for (size_t j = i ? list->tokens[i - 1].diag_end : 0; j < token->diag_end; j++)
+    {
+      const Diagnostic* record = &list->lexed.records[j];
+      ctx->lineno = record->line;
+      report(ctx, record->code, record->arg);
+    }
+
+    YYSTYPE lval = token->lval;
+    ctx->lineno = token->line;
+    status = yypush_parse(parser, token->token, &lval, ctx);
+  }
+
+  if (status == YYPUSH_MORE)
+    status = yypush_parse(parser, 0, &none, ctx);
+
+  yypstate_delete(parser);
+  checkTree(ctx);
+  return status;
+}
+
+/*
+  Key of the result of checking tokens [begin, end) as a unit: everything
+  the checks of a top-level function depend on. Lines are taken relative
+  to its first token, so a function that only moved keeps its key, and
+  the symbols left in the outermost scope by the functions before it are
+  included, since it sees them.
+*/
+uint64_t unitKey(const Checker* ctx, const TokenList* list, size_t begin, size_t end, int unit, const UnitResult* scope)
+{
+  Hasher hasher;
+  hashInit(&hasher);
+  hashString(&hasher, "lexparser unit");
+  hashInt(&hasher, DIAG_CODE_COUNT);
+  hashInt(&hasher, ctx->diag.quiet);
+  hashInt(&hasher, unit);
+
+  hashInt(&hasher, (int64_t) scope->global_count);
+  for (size_t i = 0; i < scope->global_count; i++)
+  {
+    hashInt(&hasher, scope->globals[i].dtype);
+    hashString(&hasher, scope->globals[i].name);
+  }
+
+  int start = list->tokens[begin].line;
+  hashInt(&hasher, (int64_t) (end - begin));
+  for (size_t i = begin; i < end; i++)
+  {
+    const Token* token = &list->tokens[i];
+    hashInt(&hasher, token->token);
+    hashInt(&hasher, token->line - start);
+
+    if (token->token == ID_TOK)
+      hashString(&hasher, atomName(&ctx->names, token->lval.atom));
+    else if (token->token == INT_CONST_TOK)
+      hashInt(&hasher, token->lval.number);
+    else if (token->token == REALCONST_TOK)
+      hashBytes(&hasher, &token->lval.decimal, sizeof(float));
+
+    for (size_t j = i ? list->tokens[i - 1].diag_end : 0; j < token->diag_end; j++)
+    {
+      const Diagnostic* record = &list->lexed.records[j];
+      hashInt(&hasher, record->code);
+      hashInt(&hasher, record->line - start);
+      hashString(&hasher, record->arg);
+    }
+  }
+
+  return hasher.state;
+}
+
+// Symbols a unit declared in the outermost scope
+typedef struct UnitGlobals
+{
+  const Checker* ctx;
+  Symtable preset;     // the outermost scope before the unit
+  UnitResult* result;
+} UnitGlobals;
+
+void addUnitGlobal(const Symbol* symbol, void* arg)
+{
+  UnitGlobals* globals = (UnitGlobals*) arg;
+  if (symtableLookup(globals->preset, symbol->name) == NULL)
+    unitResultAddGlobal(globals->result, atomName(&globals->ctx->names, symbol->name), symbol->dtype);
+}
+
+int compareGlobals(const void* a, const void* b)
+{
+  return strcmp(((const UnitGlobal*) a)->name, ((const UnitGlobal*) b)->name);
+}
+
+// Check tokens [begin, end) as a unit, seeing the given symbols in the
+// outermost scope. Returns 0 and fills result if it had no syntax errors.
+int checkUnit(Checker* ctx, const TokenList* list, size_t begin, size_t end, int unit,
+              const UnitResult* scope, UnitResult* result)
+{
+  resetParse(ctx);
+  for (size_t i = 0; i < scope->global_count; i++)
+  {
+    const char* name = scope->globals[i].name;
+    add(ctx, internAtom(&ctx->names, name, strlen(name)), scope->globals[i].dtype);
+  }
+  Symtable preset = ctx->table;
+
+  if (parseTokens(ctx, list, begin, end, unit) != 0 || ctx->syntax_errors != 0)
+    return 1;
+
+  int start = list->tokens[begin].line;
+  for (size_t i = 0; i < ctx->diag.count; i++)
+  {
+    const Diagnostic* record = &ctx->diag.records[i];
+    unitResultAddRecord(result, record->code, record->line - start, record->arg);
+  }
+
+  // Every inner scope is closed again, so only outermost symbols are left,
+  // and the unit declared those that were not there before it
+  UnitGlobals globals = { ctx, preset, result };
+  symtableForEach(ctx->table, addUnitGlobal, &globals);
+
+  // Atoms, and so the order of the table, depend on the rest of the file
+  if (result->global_count > 0)
+    qsort(result->globals, result->global_count, sizeof(UnitGlobal), compareGlobals);
+  return 0;
+}
+
+/*
+  Check a file one top-level function at a time, reusing the results
+  cached in dir for the functions that did not change, and caching the
+  others. The file is split after every '}' that closes a function. If
+  that does not split it into functions that parse on their own, it is
+  checked as a whole instead. Returns like check().
+*/
+int checkIncremental(Checker* ctx, FILE* in, const char* dir)
+{
+  TokenList list;
+  scanTokens(ctx, in, &list);
+
+  size_t* ends = (size_t*) malloc(list.count * sizeof(size_t));
+  size_t units = 0;
+  int depth = 0;
+
+  for (size_t i = 0; i + 1 < list.count && depth >= 0; i++)
+  {
+    if (list.tokens[i].token == '{')
+      depth++;
+    else if (list.tokens[i].token == '}' && --depth == 0)
+      ends[units++] = i + 1;
+  }
+
+  int split = depth == 0 && units > 0 && ends[units - 1] == list.count - 1;
+
+  Diagnostics file;
+  diagInit(&file, ctx->diag.quiet);
+  UnitResult scope;
+  unitResultInit(&scope);
+
+  for (size_t k = 0; k < units && split; k++)
+  {
+    size_t begin = k ? ends[k - 1] : 0;
+    uint64_t key = unitKey(ctx, &list, begin, ends[k], k != 0, &scope);
+
+    UnitResult result;
+    unitResultInit(&result);
+    if (cacheLoad(dir, key, &result) != 0)
+    {
+      if (checkUnit(ctx, &list, begin, ends[k], k != 0, &scope, &result) != 0)
+        split = 0;
+      else
+        cacheStore(dir, key, &result);
+    }
+
+    int start = list.tokens[begin].line;
+    for (size_t i = 0; i < result.count && split; i++)
+      diagReport(&file, 0, result.records[i].code, result.records[i].line + start, result.records[i].arg);
+    for (size_t i = 0; i < result.global_count; i++)
+      unitResultAddGlobal(&scope, result.globals[i].name, result.globals[i].dtype);
+
+    unitResultFree(&result);
+  }
+
+  int status = 0;
+  if (split)
+  {
+    // What the lexer reported after the last function
+    const Token* last = &list.tokens[list.count - 1];
+    for (size_t j = list.count > 1 ? list.tokens[list.count - 2].diag_end : 0; j < last->diag_end; j++)
+      diagReport(&file, 0, list.lexed.records[j].code, list.lexed.records[j].line, list.lexed.records[j].arg);
+
+    resetParse(ctx);
+    diagFree(&ctx->diag);
+    ctx->diag = file;
+    ctx->lineno = last->line;
+  }
+  else
+  {
+    diagFree(&file);
+    resetParse(ctx);
+    status = parseTokens(ctx, &list, 0, list.count, 0);
+  }
+
+  unitResultFree(&scope);
+  free(ends);
+  freeTokens(&list);
+  return status;
+}
+
+// How the diagnostics of every file are printed
+typedef struct Options
+{
+  int quiet;          // errors only
+  int json;
+  const char* cache;  // directory of cached function results, or NULL
+  const char** include_dirs;  // searched by #include, in order
+  size_t include_count;
+  int threads;        // functions of a file checked at once
+  int stats;          // keep statistics of the symbol table
+  int descent;        // parse with the recursive descent parser
+  int syntax_only;    // only the syntax, and only its first error
+} Options;
+
+// How much of a file is read to see whether it needs preprocessing
+#define SOURCE_HEAD 65536
+
+// The first bytes of a file, already read, and the stream after them
+typedef struct SourceStream
+{
+  char* head;
+  size_t size;
+  size_t at;      // bytes of head handed out so far
+  FILE* rest;
+} SourceStream;
+
+ssize_t readSourceStream(void* cookie, char* buffer, size_t size)
+{
+  SourceStream* stream = (SourceStream*) cookie;
+  if (stream->at == stream->size)
+    return (ssize_t) fread(buffer, 1, size, stream->rest);
+
+  if (size > stream->size - stream->at)
+    size = stream->size - stream->at;
+  memcpy(buffer, stream->head + stream->at, size);
+  stream->at += size;
+  return (ssize_t) size;
+}
+
+// Read the rest of in after the size bytes of text, which fill its
+// capacity. Returns the whole of the file.
+char* readSource(FILE* in, char* text, size_t capacity, size_t* size)
+{
+  size_t read;
+  text = (char*) realloc(text, capacity *= 2);
+
+  while ((read = fread(text + *size, 1, capacity - *size, in)) > 0)
+  {
+    *size += read;
+    if (*size == capacity)
+      text = (char*) realloc(text, capacity *= 2);
+  }
+  return text;
+}
+
+// Check one file, or report that in could not be opened, and print its
+// diagnostics to out. Statistics of the symbol table go to stats if
+// options ask for them. Returns 1 if the file has errors.
+int checkFile(const char* path, FILE* in, FILE* out, const Options* options, SymtableStats* stats)
+{
+  Checker ctx;
+  __init__(&ctx, options->quiet || options->syntax_only);
+  ctx.threads = options->threads;
+  if (options->stats)
+  {
+    ctx.stats = stats;
+    statsInit(stats);
+  }
+
+  if (in == NULL)
+    report(&ctx, DIAG_CANNOT_OPEN, path);
+  else
+  {
+    SourceStream stream = { (char*) malloc(SOURCE_HEAD), 0, 0, in };
+    stream.size = fread(stream.head, 1, SOURCE_HEAD, in);
+    char* text;
+    size_t size = stream.size;
+    FILE* source;
+    Preprocessor pp;
+    preprocInit(&pp, &ctx.diag, options->include_dirs, options->include_count);
+
+    // A file that goes on past its first block without a '#' in it is
+    // parsed as it streams in. Only a shorter one, or one that may need
+    // preprocessing, is read whole.
+    if (size == SOURCE_HEAD && memchr(stream.head, '#', size) == NULL)
+    {
+      cookie_io_functions_t io = { readSourceStream, NULL, NULL, NULL };
+      source = fopencookie(&stream, "r", io);
+      text = stream.head;
+    }
+    else
+    {
+      text = size == SOURCE_HEAD ? readSource(in, stream.head, SOURCE_HEAD, &size) : stream.head;
+
+      // A file without a single '#' has nothing to preprocess
+      if (memchr(text, '#', size) != NULL)
+      {
+        preprocess(&pp, path, text, size);
+        if (pp.out.data != NULL)
+        {
+          free(text);
+          text = pp.out.data;
+          size = pp.out.size;
+          pp.out.data = NULL;
+        }
+        else
+          size = 0;
+      }
+      source = fmemopen(text, size, "r");
+    }
+
+    int status;
+    if (options->syntax_only)
+      status = ctx.diag.errors != 0 || checkSyntax(&ctx, source);
+    else if (options->cache)
+      status = checkIncremental(&ctx, source, options->cache);
+    else if (options->descent)
+      status = checkDescent(&ctx, source);
+    else
+      status = check(&ctx, source);
+    if (status == 0 && ctx.syntax_errors == 0)
+      report(&ctx, DIAG_PARSED, NULL);
+
+    fclose(source);
+    free(text);
+    preprocFree(&pp);
+  }
+
+  // The preprocessor may have reported more than the first error
+  Diagnostics shown = ctx.diag;
+  if (options->syntax_only && shown.count > 1)
+    shown.count = 1;
+
+  if (options->json)
+    diagWriteJson(&shown, out, path);
+  else
+    diagWriteText(&shown, out);
+
+  int failed = ctx.diag.errors != 0;
+  __freeMemory__(&ctx);
+  return failed;
+}
+
+// Files of a batch and their messages, kept until printed in order
+typedef struct CheckBatch
+{
+  PathList files;
+  Options options;
+  char** texts;
+  size_t* sizes;
+  int* failed;
+  int failures;
+  SymtableStats* stats;  // of each file, if kept
+  SymtableStats total;
+} CheckBatch;
+
+void runBatchFile(size_t i, void* arg)
+{
+  CheckBatch* batch = (CheckBatch*) arg;
+  FILE* out = open_memstream(&batch->texts[i], &batch->sizes[i]);
+  FILE* in = fopen(batch->files.paths[i], "r");
+
+  batch->failed[i] = checkFile(batch->files.paths[i], in, out, &batch->options, &batch->stats[i]);
+
+  if (in != NULL)
+    fclose(in);
+  fclose(out);
+}
+
+void emitBatchFile(size_t i, void* arg)
+{
+  CheckBatch* batch = (CheckBatch*) arg;
+
+  if (batch->options.json)
+  {
+    printf(i ? ",\n" : "");
+    fwrite(batch->texts[i], 1, batch->sizes[i], stdout);
+  }
+
+  // Quiet runs leave out the files without errors altogether
+  else if (!batch->options.quiet || batch->sizes[i] != 0)
+  {
+    printf("==> %s <==", batch->files.paths[i]);
+    fwrite(batch->texts[i], 1, batch->sizes[i], stdout);
+    printf("\n");
+  }
+
+  free(batch->texts[i]);
+  batch->failures += batch->failed[i];
+  if (batch->options.stats)
+    statsMerge(&batch->total, &batch->stats[i]);
+}
+
+void usage(const char* program)
+{
+  fprintf(stderr, "usage: %s [-q] [-f text|json] [-c cachedir] [-I dir]... [-p threads] [-s] [-r] [--syntax-only] <file\n", program);
+  fprintf(stderr, "       %s [-q] [-f text|json] [-c cachedir] [-I dir]... [-p threads] [-s] [-r] [--syntax-only] [-j threads] [-l listfile] [file|directory]...\n", program);
+}
+
+int main(int argc, char *argv[])
+{
+  CheckBatch batch;
+  pathListInit(&batch.files);
+  batch.options.quiet = 0;
+  batch.options.json = 0;
+  batch.options.cache = NULL;
+  batch.options.include_dirs = NULL;
+  batch.options.include_count = 0;
+  batch.options.threads = 1;
+  batch.options.stats = 0;
+  batch.options.descent = 0;
+  batch.options.syntax_only = 0;
+  int threads = batchDefaultThreads();
+  int batch_mode = 0;
+  int opt;
+
+  static const struct option long_options[] =
+  {
+    { "syntax-only", no_argument, NULL, 'S' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  while ((opt = getopt_long(argc, argv, "qf:c:I:j:p:srl:", long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 'q':
+        batch.options.quiet = 1;
+        break;
+      case 'f':
+        if (strcmp(optarg, "json") == 0)
+          batch.options.json = 1;
+        else if (strcmp(optarg, "text") != 0)
+        {
+          usage(argv[0]);
+          return 2;
+        }
+        break;
+      case 'c':
+        // Missing parts of the path are not created; an unusable cache
+        // only means every function is checked
+        mkdir(optarg, 0777);
+        batch.options.cache = optarg;
+        break;
+      case 'I':
+        batch.options.include_dirs = (const char**) realloc(batch.options.include_dirs,
+                                                            (batch.options.include_count + 1) * sizeof(char*));
+        batch.options.include_dirs[batch.options.include_count++] = optarg;
+        break;
+      case 'j':
+        threads = atoi(optarg);
+        batch_mode = 1;
+        break;
+      case 'p':
+        batch.options.threads = atoi(optarg);
+        break;
+      case 's':
+        batch.options.stats = 1;
+        break;
+      case 'r':
+        batch.options.descent = 1;
+        break;
+      case 'S':
+        batch.options.syntax_only = 1;
+        break;
+      case 'l':
+        if (pathListRead(&batch.files, optarg) != 0)
+          fprintf(stderr, "%s: cannot read all of %s\n", argv[0], optarg);
+        batch_mode = 1;
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+
+  // Without any files, the program on stdin is checked as it always was
+  if (!batch_mode && optind == argc)
+  {
+    int failed = checkFile("<stdin>", stdin, stdout, &batch.options, &batch.total);
+    if (batch.options.json)
+      printf("\n");
+    if (batch.options.stats)
+      statsPrint(&batch.total, "trie level", stderr);
+    free(batch.options.include_dirs);
+
+    // An editor asking whether the program parses goes by the status
+    return batch.options.syntax_only && failed;
+  }
+
+  for (int i = optind; i < argc; i++)
+    if (pathListAdd(&batch.files, argv[i]) != 0)
+      fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[i]);
+
+  batch.texts = (char**) calloc(batch.files.count, sizeof(char*));
+  batch.sizes = (size_t*) calloc(batch.files.count, sizeof(size_t));
+  batch.failed = (int*) calloc(batch.files.count, sizeof(int));
+  batch.failures = 0;
+  batch.stats = (SymtableStats*) calloc(batch.files.count, sizeof(SymtableStats));
+  statsInit(&batch.total);
+
+  if (batch.options.json)
+    printf("[\n");
+  batchRun(batch.files.count, threads, runBatchFile, emitBatchFile, &batch);
+  if (batch.options.json)
+    printf("\n]\n");
+  fprintf(stderr, "%d of %zu files failed\n", batch.failures, batch.files.count);
+  if (batch.options.stats)
+    statsPrint(&batch.total, "trie level", stderr);
+
+  free(batch.texts);
+  free(batch.sizes);
+  free(batch.failed);
+  free(batch.stats);
+  free(batch.options.include_dirs);
+  pathListFree(&batch.files);
+  return batch.failures != 0;
 }
 
-void yyerror(char* msg)
+void yyerror(Checker* ctx, char* msg)
 {
-  printf("\nParsing failed at line %d %s\n", yylineno, msg);
+  report(ctx, DIAG_SYNTAX, msg);
 }
@@ -0,0 +1,1372 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "preproc.h"
+
+// Includes nested deeper than this are taken to include themselves
+#define MAX_INCLUDE_DEPTH 200
+
+typedef enum Directive
+{
+  DIRECTIVE_NONE,     // a line of text
+  DIRECTIVE_EMPTY,    // a '#' on its own
+  DIRECTIVE_INCLUDE,
+  DIRECTIVE_DEFINE,
+  DIRECTIVE_UNDEF,
+  DIRECTIVE_IF,
+  DIRECTIVE_IFDEF,
+  DIRECTIVE_IFNDEF,
+  DIRECTIVE_ELIF,
+  DIRECTIVE_ELSE,
+  DIRECTIVE_ENDIF,
+  DIRECTIVE_ERROR,
+  DIRECTIVE_PRAGMA,
+  DIRECTIVE_UNKNOWN
+} Directive;
+
+static const char* directive_names[] =
+{
+  [DIRECTIVE_INCLUDE] = "include",
+  [DIRECTIVE_DEFINE]  = "define",
+  [DIRECTIVE_UNDEF]   = "undef",
+  [DIRECTIVE_IF]      = "if",
+  [DIRECTIVE_IFDEF]   = "ifdef",
+  [DIRECTIVE_IFNDEF]  = "ifndef",
+  [DIRECTIVE_ELIF]    = "elif",
+  [DIRECTIVE_ELSE]    = "else",
+  [DIRECTIVE_ENDIF]   = "endif",
+  [DIRECTIVE_ERROR]   = "error",
+  [DIRECTIVE_PRAGMA]  = "pragma",
+};
+
+// An identifier in a text, by offset
+typedef struct Ident
+{
+  uint32_t begin;
+  uint32_t length;
+  uint32_t hash;
+} Ident;
+
+typedef struct IdentList
+{
+  Ident* idents;
+  size_t count;
+  size_t capacity;
+} IdentList;
+
+// A line of a file, with the lines it continues onto if it is a directive
+typedef struct SourceLine
+{
+  uint32_t begin;        // first byte
+  uint32_t end;          // end of the text, before the newline
+  uint32_t args;         // of a directive: first byte after its name
+  uint32_t newlines;     // newlines it spans and ends with
+  uint32_t idents;       // of text: first of its identifiers in the file
+  uint32_t ident_count;
+  uint64_t mask;         // bits of the hashes of its identifiers
+  uint8_t directive;
+} SourceLine;
+
+typedef struct SourceFile
+{
+  char* path;
+  const char* data;
+  size_t size;
+  size_t id;             // index in the cache
+  SourceLine* lines;
+  size_t line_count;
+  size_t line_capacity;
+  IdentList idents;
+  char* guard;           // macro of the include guard, or NULL
+  int once;              // has #pragma once
+} SourceFile;
+
+typedef struct Macro
+{
+  int defined;
+  int function;          // takes arguments
+  int expanding;         // being expanded, so not expanded again
+  size_t param_count;
+  char* body;            // replacement text
+  size_t body_length;
+  IdentList idents;      // identifiers of the body
+  int* params;           // for each of them the parameter it names, or -1
+} Macro;
+
+// Files read so far by any thread, by their resolved path; never unmapped
+static struct
+{
+  pthread_mutex_t lock;
+  InternPool paths;
+  int ready;
+  SourceFile** files;
+  size_t count;
+  size_t capacity;
+} cache = { PTHREAD_MUTEX_INITIALIZER, { 0 }, 0, NULL, 0, 0 };
+
+static void textReserve(TextBuffer* text, size_t size)
+{
+  if (text->size + size <= text->capacity)
+    return;
+
+  while (text->size + size > text->capacity)
+    text->capacity = text->capacity ? 2 * text->capacity : 4096;
+  text->data = (char*) realloc(text->data, text->capacity);
+}
+
+static void textAppend(TextBuffer* text, const char* data, size_t size)
+{
+  if (size == 0)
+    return;
+  textReserve(text, size);
+  memcpy(text->data + text->size, data, size);
+  text->size += size;
+}
+
+static void textNewlines(TextBuffer* text, size_t count)
+{
+  textReserve(text, count);
+  memset(text->data + text->size, '\n', count);
+  text->size += count;
+}
+
+static void textFree(TextBuffer* text)
+{
+  free(text->data);
+  text->data = NULL;
+  text->size = text->capacity = 0;
+}
+
+static void report(Preprocessor* pp, int line, const char* format, ...)
+{
+  char message[512];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+
+  diagReport(pp->diag, 0, DIAG_PREPROCESSOR, line, message);
+}
+
+static int isIdentStart(char c)
+{
+  return isalpha((unsigned char) c) || c == '_';
+}
+
+static int isIdentChar(char c)
+{
+  return isalnum((unsigned char) c) || c == '_';
+}
+
+static size_t skipSpace(const char* text, size_t i, size_t end)
+{
+  while (i < end && isspace((unsigned char) text[i]))
+    i++;
+  return i;
+}
+
+static size_t skipIdent(const char* text, size_t i, size_t end)
+{
+  while (i < end && isIdentChar(text[i]))
+    i++;
+  return i;
+}
+
+static uint32_t hashName(const char* name, size_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++)
+    hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+  return hash;
+}
+
+static uint64_t hashBit(uint32_t hash)
+{
+  return 1ULL << (hash & 63);
+}
+
+/*
+  Add the identifiers in [begin, end) of text to list, skipping string and
+  character constants and numbers. Returns the bits of their hashes.
+*/
+static uint64_t scanIdents(const char* text, size_t begin, size_t end, IdentList* list)
+{
+  uint64_t mask = 0;
+  size_t i = begin;
+
+  while (i < end)
+  {
+    char c = text[i];
+    if (c == '"' || c == '\'')
+    {
+      for (i++; i < end && text[i] != c; i++)
+        if (text[i] == '\\' && i + 1 < end)
+          i++;
+      i = i < end ? i + 1 : end;
+    }
+    else if (isdigit((unsigned char) c) || (c == '.' && i + 1 < end && isdigit((unsigned char) text[i + 1])))
+    {
+      // A number, with whatever letters it goes on with
+      while (i < end && (isIdentChar(text[i]) || text[i] == '.'))
+        i++;
+    }
+    else if (isIdentStart(c))
+    {
+      size_t start = i;
+      i = skipIdent(text, i, end);
+
+      if (list->count == list->capacity)
+      {
+        list->capacity = list->capacity ? 2 * list->capacity : 64;
+        list->idents = (Ident*) realloc(list->idents, list->capacity * sizeof(Ident));
+      }
+
+      Ident* ident = &list->idents[list->count++];
+      ident->begin = (uint32_t) start;
+      ident->length = (uint32_t) (i - start);
+      ident->hash = hashName(text + start, i - start);
+      mask |= hashBit(ident->hash);
+    }
+    else
+      i++;
+  }
+
+  return mask;
+}
+
+/*
+  Copy the arguments of a directive to args, joining continued lines and
+  dropping comments, so they can be read as one line of text
+*/
+static void directiveArgs(const SourceFile* file, const SourceLine* line, TextBuffer* args)
+{
+  const char* data = file->data;
+  size_t end = line->end;
+  args->size = 0;
+
+  for (size_t i = line->args; i < end; i++)
+  {
+    if (data[i] == '\\' && i + 1 < end && data[i + 1] == '\n')
+    {
+      textAppend(args, " ", 1);
+      i++;
+    }
+    else if (data[i] == '/' && i + 1 < end && data[i + 1] == '/')
+      break;
+    else if (data[i] == '/' && i + 1 < end && data[i + 1] == '*')
+    {
+      for (i += 2; i + 1 < end && !(data[i] == '*' && data[i + 1] == '/'); i++)
+        ;
+      i++;
+      textAppend(args, " ", 1);
+    }
+    else if (data[i] == '"' || data[i] == '\'')
+    {
+      size_t start = i;
+      for (i++; i < end && data[i] != data[start]; i++)
+        if (data[i] == '\\' && i + 1 < end)
+          i++;
+      textAppend(args, data + start, (i < end ? i + 1 : end) - start);
+    }
+    else
+      textAppend(args, data + i, 1);
+  }
+
+  // Trailing blanks are not part of a macro body
+  while (args->size > 0 && isspace((unsigned char) args->data[args->size - 1]))
+    args->size--;
+}
+
+// The name a directive starts with, by offset, or length 0
+static size_t firstName(const char* text, size_t end, size_t* begin)
+{
+  *begin = skipSpace(text, 0, end);
+  if (*begin == end || !isIdentStart(text[*begin]))
+    return 0;
+  return skipIdent(text, *begin, end) - *begin;
+}
+
+static int blankLine(const SourceFile* file, const SourceLine* line)
+{
+  if (line->directive == DIRECTIVE_EMPTY)
+    return 1;
+  if (line->directive != DIRECTIVE_NONE)
+    return 0;
+  return skipSpace(file->data, line->begin, line->end) == line->end;
+}
+
+/*
+  A file has an include guard if its first line is #ifndef NAME, its
+  second #define NAME, and its last the #endif closing the first, not
+  counting blank lines
+*/
+static void findGuard(SourceFile* file)
+{
+  size_t first = 0;
+  while (first < file->line_count && blankLine(file, &file->lines[first]))
+    first++;
+  size_t second = first + 1;
+  while (second < file->line_count && blankLine(file, &file->lines[second]))
+    second++;
+  size_t last = file->line_count;
+  while (last > 0 && blankLine(file, &file->lines[last - 1]))
+    last--;
+
+  if (second >= file->line_count ||
+      file->lines[first].directive != DIRECTIVE_IFNDEF ||
+      file->lines[second].directive != DIRECTIVE_DEFINE)
+    return;
+
+  int depth = 0;
+  size_t i;
+  for (i = first; i < file->line_count; i++)
+  {
+    uint8_t directive = file->lines[i].directive;
+    if (directive == DIRECTIVE_IF || directive == DIRECTIVE_IFDEF || directive == DIRECTIVE_IFNDEF)
+      depth++;
+    else if (directive == DIRECTIVE_ENDIF && --depth == 0)
+      break;
+  }
+  if (i + 1 != last)
+    return;
+
+  TextBuffer args = { 0 };
+  size_t begin, length;
+  directiveArgs(file, &file->lines[first], &args);
+  length = firstName(args.data, args.size, &begin);
+  char* name = strndup(args.data + begin, length);
+
+  directiveArgs(file, &file->lines[second], &args);
+  size_t defined_begin, defined_length = firstName(args.data, args.size, &defined_begin);
+
+  if (length != 0 && defined_length == length && memcmp(args.data + defined_begin, name, length) == 0)
+    file->guard = name;
+  else
+    free(name);
+  textFree(&args);
+}
+
+// Split a file into lines, and the lines of text into identifiers
+static void scanSource(SourceFile* file)
+{
+  const char* data = file->data;
+  size_t size = file->size;
+  size_t i = 0;
+
+  while (i < size)
+  {
+    if (file->line_count == file->line_capacity)
+    {
+      file->line_capacity = file->line_capacity ? 2 * file->line_capacity : 256;
+      file->lines = (SourceLine*) realloc(file->lines, file->line_capacity * sizeof(SourceLine));
+    }
+
+    SourceLine* line = &file->lines[file->line_count++];
+    memset(line, 0, sizeof(*line));
+    line->begin = (uint32_t) i;
+
+    size_t mark = i;
+    while (mark < size && (data[mark] == ' ' || data[mark] == '\t'))
+      mark++;
+    int directive = mark < size && data[mark] == '#';
+
+    // A directive goes on over every line ending in a backslash
+    size_t end = i;
+    for (;;)
+    {
+      const char* newline = (const char*) memchr(data + end, '\n', size - end);
+      end = newline ? (size_t) (newline - data) : size;
+      if (!directive || newline == NULL || end == i || data[end - 1] != '\\')
+        break;
+      line->newlines++;
+      end++;
+    }
+
+    line->end = (uint32_t) end;
+    line->newlines += end < size;
+    i = end < size ? end + 1 : size;
+
+    if (!directive)
+    {
+      line->directive = DIRECTIVE_NONE;
+      line->idents = (uint32_t) file->idents.count;
+      line->mask = scanIdents(data, line->begin, end, &file->idents);
+      line->ident_count = (uint32_t) (file->idents.count - line->idents);
+      continue;
+    }
+
+    size_t name = skipSpace(data, mark + 1, end);
+    size_t name_end = skipIdent(data, name, end);
+    line->args = (uint32_t) name_end;
+
+    if (name == name_end)
+      line->directive = name == end ? DIRECTIVE_EMPTY : DIRECTIVE_UNKNOWN;
+    else
+    {
+      line->directive = DIRECTIVE_UNKNOWN;
+      for (int d = DIRECTIVE_INCLUDE; d < DIRECTIVE_UNKNOWN; d++)
+        if (strlen(directive_names[d]) == name_end - name &&
+            memcmp(directive_names[d], data + name, name_end - name) == 0)
+          line->directive = (uint8_t) d;
+    }
+
+    if (line->directive == DIRECTIVE_PRAGMA)
+    {
+      size_t word = skipSpace(data, name_end, end);
+      size_t word_end = skipIdent(data, word, end);
+      if (word_end - word == 4 && memcmp(data + word, "once", 4) == 0)
+        file->once = 1;
+    }
+  }
+
+  findGuard(file);
+}
+
+// The cached file at a path, reading it the first time; NULL if it cannot be
+static SourceFile* loadSource(const char* path)
+{
+  char real[PATH_MAX];
+  if (realpath(path, real) == NULL)
+    return NULL;
+
+  pthread_mutex_lock(&cache.lock);
+  if (!cache.ready)
+  {
+    internInit(&cache.paths);
+    cache.ready = 1;
+  }
+
+  Atom atom = internAtom(&cache.paths, real, strlen(real));
+  SourceFile* file = NULL;
+
+  if (atom < cache.count)
+    file = cache.files[atom];
+  else
+  {
+    // A file that cannot be read is remembered as missing
+    if (cache.count == cache.capacity)
+    {
+      cache.capacity = cache.capacity ? 2 * cache.capacity : 64;
+      cache.files = (SourceFile**) realloc(cache.files, cache.capacity * sizeof(SourceFile*));
+    }
+
+    int fd = open(real, O_RDONLY);
+    struct stat info;
+    if (fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && (uint64_t) info.st_size < UINT32_MAX)
+    {
+      file = (SourceFile*) calloc(1, sizeof(SourceFile));
+      file->path = strdup(real);
+      file->size = (size_t) info.st_size;
+      file->id = atom;
+
+      if (file->size > 0)
+      {
+        void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        file->data = data == MAP_FAILED ? NULL : (const char*) data;
+        if (file->data == NULL)
+          file->size = 0;
+      }
+      scanSource(file);
+    }
+    if (fd >= 0)
+      close(fd);
+
+    cache.files[cache.count++] = file;
+  }
+
+  pthread_mutex_unlock(&cache.lock);
+  return file;
+}
+
+static Macro* macroAt(Preprocessor* pp, const char* name, size_t length)
+{
+  Atom atom = internAtom(&pp->names, name, length);
+  if (atom >= pp->macros_capacity)
+  {
+    size_t capacity = pp->macros_capacity ? pp->macros_capacity : 64;
+    while (capacity <= atom)
+      capacity *= 2;
+    pp->macros = (Macro*) realloc(pp->macros, capacity * sizeof(Macro));
+    memset(pp->macros + pp->macros_capacity, 0, (capacity - pp->macros_capacity) * sizeof(Macro));
+    pp->macros_capacity = capacity;
+  }
+  return &pp->macros[atom];
+}
+
+// The macro a name stands for, or NULL. Never moves the macros, so
+// expansions in progress can hold on to theirs.
+static Macro* findMacro(Preprocessor* pp, const char* name, size_t length, uint32_t hash)
+{
+  if (!(pp->macro_mask & hashBit(hash)))
+    return NULL;
+
+  Atom atom = internAtom(&pp->names, name, length);
+  if (atom >= pp->macros_capacity || !pp->macros[atom].defined)
+    return NULL;
+  return &pp->macros[atom];
+}
+
+static void clearMacro(Macro* macro)
+{
+  free(macro->body);
+  free(macro->idents.idents);
+  free(macro->params);
+  memset(macro, 0, sizeof(*macro));
+}
+
+static void expand(Preprocessor* pp, TextBuffer* out, const char* text, size_t begin, size_t end,
+                   const Ident* idents, size_t count, int line);
+
+// A macro argument, by offset
+typedef struct Span
+{
+  size_t begin;
+  size_t end;
+} Span;
+
+/*
+  Split the arguments of a call whose '(' is at open. Returns the offset of
+  the closing ')', or end if there is none.
+*/
+static size_t splitArgs(const char* text, size_t open, size_t end, Span** args, size_t* count)
+{
+  size_t capacity = 4;
+  *args = (Span*) malloc(capacity * sizeof(Span));
+  *count = 0;
+
+  int depth = 0;
+  size_t start = open + 1;
+
+  for (size_t i = open + 1; i < end; i++)
+  {
+    char c = text[i];
+    if (c == '"' || c == '\'')
+    {
+      for (i++; i < end && text[i] != c; i++)
+        if (text[i] == '\\' && i + 1 < end)
+          i++;
+      if (i == end)
+        break;
+    }
+    else if (c == '(')
+      depth++;
+    else if ((c == ',' && depth == 0) || (c == ')' && depth-- == 0))
+    {
+      if (*count == capacity)
+      {
+        capacity *= 2;
+        *args = (Span*) realloc(*args, capacity * sizeof(Span));
+      }
+
+      Span* arg = &(*args)[(*count)++];
+      arg->begin = skipSpace(text, start, i);
+      arg->end = i;
+      while (arg->end > arg->begin && isspace((unsigned char) text[arg->end - 1]))
+        arg->end--;
+      start = i + 1;
+
+      if (c == ')')
+        return i;
+    }
+  }
+
+  return end;
+}
+
+// Put the expanded arguments in place of the parameters of a macro body
+static void substitute(Preprocessor* pp, const Macro* macro, const char* text, const Span* args,
+                       TextBuffer* out, int line)
+{
+  size_t copied = 0;
+  IdentList arg_idents = { 0 };
+
+  for (size_t i = 0; i < macro->idents.count; i++)
+  {
+    int param = macro->params[i];
+    if (param < 0)
+      continue;
+
+    const Ident* ident = &macro->idents.idents[i];
+    textAppend(out, macro->body + copied, ident->begin - copied);
+    copied = ident->begin + ident->length;
+
+    // Arguments are expanded on their own before they are put in
+    arg_idents.count = 0;
+    scanIdents(text, args[param].begin, args[param].end, &arg_idents);
+    expand(pp, out, text, args[param].begin, args[param].end, arg_idents.idents, arg_idents.count, line);
+  }
+
+  textAppend(out, macro->body + copied, macro->body_length - copied);
+  free(arg_idents.idents);
+}
+
+/*
+  Append [begin, end) of text to out with its macros expanded. idents are
+  the identifiers in that range. Only the identifiers are looked at, and
+  the text between them is copied as it is.
+*/
+static void expand(Preprocessor* pp, TextBuffer* out, const char* text, size_t begin, size_t end,
+                   const Ident* idents, size_t count, int line)
+{
+  size_t copied = begin;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const Ident* ident = &idents[i];
+    if (ident->begin < copied)
+      continue;
+
+    Macro* macro = findMacro(pp, text + ident->begin, ident->length, ident->hash);
+    if (macro == NULL || macro->expanding)
+      continue;
+
+    size_t after = ident->begin + ident->length;
+
+    if (!macro->function)
+    {
+      textAppend(out, text + copied, ident->begin - copied);
+      macro->expanding = 1;
+      expand(pp, out, macro->body, 0, macro->body_length, macro->idents.idents, macro->idents.count, line);
+      macro->expanding = 0;
+      copied = after;
+      continue;
+    }
+
+    // A function-like macro not followed by arguments is an ordinary name
+    size_t open = skipSpace(text, after, end);
+    if (open == end || text[open] != '(')
+      continue;
+
+    Span* args;
+    size_t arg_count;
+    size_t close = splitArgs(text, open, end, &args, &arg_count);
+    int name_length = (int) ident->length;
+    const char* name = text + ident->begin;
+
+    if (close == end)
+      report(pp, line, "Unterminated call of macro %.*s", name_length, name);
+    else if (arg_count == 1 && macro->param_count == 0 && args[0].begin == args[0].end)
+      arg_count = 0;
+
+    if (close != end && arg_count != macro->param_count)
+      report(pp, line, "Macro %.*s takes %zu arguments, not %zu", name_length, name, macro->param_count, arg_count);
+    else if (close != end)
+    {
+      TextBuffer replaced = { 0 };
+      IdentList replaced_idents = { 0 };
+      substitute(pp, macro, text, args, &replaced, line);
+      scanIdents(replaced.data, 0, replaced.size, &replaced_idents);
+
+      textAppend(out, text + copied, ident->begin - copied);
+      macro->expanding = 1;
+      expand(pp, out, replaced.data, 0, replaced.size, replaced_idents.idents, replaced_idents.count, line);
+      macro->expanding = 0;
+      copied = close + 1;
+
+      textFree(&replaced);
+      free(replaced_idents.idents);
+    }
+    free(args);
+  }
+
+  textAppend(out, text + copied, end - copied);
+}
+
+static void define(Preprocessor* pp, const char* args, size_t length, int line)
+{
+  size_t begin;
+  size_t name_length = firstName(args, length, &begin);
+  if (name_length == 0)
+  {
+    report(pp, line, "Macro name missing in #define");
+    return;
+  }
+
+  Macro* macro = macroAt(pp, args + begin, name_length);
+  clearMacro(macro);
+
+  size_t i = begin + name_length;
+  Span params[64];
+
+  // Parameters follow the name without a space in between
+  if (i < length && args[i] == '(')
+  {
+    macro->function = 1;
+    i = skipSpace(args, i + 1, length);
+
+    while (i < length && args[i] != ')')
+    {
+      size_t end = skipIdent(args, i, length);
+      if (end == i || !isIdentStart(args[i]) || macro->param_count == 64)
+      {
+        report(pp, line, "Bad parameter list of macro %.*s", (int) name_length, args + begin);
+        clearMacro(macro);
+        return;
+      }
+
+      params[macro->param_count].begin = i;
+      params[macro->param_count++].end = end;
+      i = skipSpace(args, end, length);
+      if (i < length && args[i] == ',')
+        i = skipSpace(args, i + 1, length);
+    }
+
+    if (i == length)
+    {
+      report(pp, line, "Unterminated parameter list of macro %.*s", (int) name_length, args + begin);
+      clearMacro(macro);
+      return;
+    }
+    i++;
+  }
+
+  i = skipSpace(args, i, length);
+  macro->defined = 1;
+  macro->body_length = length - i;
+  macro->body = strndup(args + i, length - i);
+  scanIdents(macro->body, 0, macro->body_length, &macro->idents);
+
+  macro->params = (int*) malloc((macro->idents.count + 1) * sizeof(int));
+  for (size_t k = 0; k < macro->idents.count; k++)
+  {
+    const Ident* ident = &macro->idents.idents[k];
+    macro->params[k] = -1;
+    for (size_t p = 0; p < macro->param_count; p++)
+      if (params[p].end - params[p].begin == ident->length &&
+          memcmp(args + params[p].begin, macro->body + ident->begin, ident->length) == 0)
+        macro->params[k] = (int) p;
+  }
+
+  pp->macro_mask |= hashBit(hashName(args + begin, name_length));
+}
+
+static int isDefined(Preprocessor* pp, const char* name, size_t length)
+{
+  return findMacro(pp, name, length, hashName(name, length)) != NULL;
+}
+
+// Constant expression of an #if, over text with its macros expanded
+typedef struct Eval
+{
+  const char* text;
+  size_t at;
+  size_t end;
+  const char* error;
+} Eval;
+
+static long long evalConditional(Eval* eval);
+
+static int evalAccept(Eval* eval, const char* op)
+{
+  size_t length = strlen(op);
+  eval->at = skipSpace(eval->text, eval->at, eval->end);
+  if (eval->end - eval->at < length || memcmp(eval->text + eval->at, op, length) != 0)
+    return 0;
+  eval->at += length;
+  return 1;
+}
+
+static long long evalUnary(Eval* eval)
+{
+  eval->at = skipSpace(eval->text, eval->at, eval->end);
+  if (eval->at == eval->end)
+  {
+    eval->error = "Missing expression in #if";
+    return 0;
+  }
+
+  const char* text = eval->text;
+  char c = text[eval->at];
+
+  if (evalAccept(eval, "("))
+  {
+    long long value = evalConditional(eval);
+    if (!evalAccept(eval, ")"))
+      eval->error = "Missing ')' in #if";
+    return value;
+  }
+  if (evalAccept(eval, "!"))
+    return !evalUnary(eval);
+  if (evalAccept(eval, "~"))
+    return ~evalUnary(eval);
+  if (evalAccept(eval, "-"))
+    return (long long) (0ULL - (unsigned long long) evalUnary(eval));
+  if (evalAccept(eval, "+"))
+    return evalUnary(eval);
+
+  if (isdigit((unsigned char) c))
+  {
+    char number[64];
+    size_t end = eval->at;
+    while (end < eval->end && isIdentChar(text[end]))
+      end++;
+    size_t length = end - eval->at < sizeof(number) ? end - eval->at : sizeof(number) - 1;
+    memcpy(number, text + eval->at, length);
+    number[length] = '\0';
+
+    char* rest;
+    long long value = (long long) strtoull(number, &rest, 0);
+    while (*rest == 'u' || *rest == 'U' || *rest == 'l' || *rest == 'L')
+      rest++;
+    if (*rest != '\0')
+      eval->error = "Bad number in #if";
+    eval->at = end;
+    return value;
+  }
+
+  if (c == '\'' && eval->at + 2 < eval->end)
+  {
+    size_t at = eval->at + 1;
+    long long value = (unsigned char) text[at];
+    if (text[at] == '\\' && at + 1 < eval->end)
+    {
+      at++;
+      value = text[at] == 'n' ? '\n' : text[at] == 't' ? '\t' : text[at] == '0' ? 0 : (unsigned char) text[at];
+    }
+    if (at + 1 >= eval->end || text[at + 1] != '\'')
+      eval->error = "Bad character constant in #if";
+    eval->at = at + 2;
+    return value;
+  }
+
+  // A name left over once macros are expanded counts as 0
+  if (isIdentStart(c))
+  {
+    eval->at = skipIdent(text, eval->at, eval->end);
+    return 0;
+  }
+
+  eval->error = "Unexpected character in #if";
+  eval->at = eval->end;
+  return 0;
+}
+
+// Binary operators, longer ones first, with their precedence
+static const struct
+{
+  const char* op;
+  int precedence;
+} binary_ops[] =
+{
+  { "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 }, { ">=", 7 },
+  { "<<", 8 }, { ">>", 8 }, { "|", 3 }, { "^", 4 }, { "&", 5 }, { "<", 7 }, { ">", 7 },
+  { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 },
+};
+
+static long long evalBinary(Eval* eval, int min_precedence)
+{
+  long long left = evalUnary(eval);
+
+  while (eval->error == NULL)
+  {
+    eval->at = skipSpace(eval->text, eval->at, eval->end);
+
+    size_t k;
+    size_t count = sizeof(binary_ops) / sizeof(binary_ops[0]);
+    for (k = 0; k < count; k++)
+    {
+      size_t length = strlen(binary_ops[k].op);
+      if (eval->end - eval->at >= length && memcmp(eval->text + eval->at, binary_ops[k].op, length) == 0)
+        break;
+    }
+    if (k == count || binary_ops[k].precedence < min_precedence)
+      break;
+
+    const char* op = binary_ops[k].op;
+    eval->at += strlen(op);
+    long long right = evalBinary(eval, binary_ops[k].precedence + 1);
+    unsigned long long l = (unsigned long long) left, r = (unsigned long long) right;
+
+    switch (op[0])
+    {
+      case '|': left = op[1] ? (left || right) : (long long) (l | r); break;
+      case '&': left = op[1] ? (left && right) : (long long) (l & r); break;
+      case '^': left = (long long) (l ^ r); break;
+      case '=': left = left == right; break;
+      case '!': left = left != right; break;
+      case '<': left = op[1] == '<' ? (long long) (l << (r & 63)) : op[1] ? left <= right : left < right; break;
+      case '>': left = op[1] == '>' ? left >> (r & 63) : op[1] ? left >= right : left > right; break;
+      case '+': left = (long long) (l + r); break;
+      case '-': left = (long long) (l - r); break;
+      case '*': left = (long long) (l * r); break;
+      default:
+        if (right == 0)
+          eval->error = "Division by zero in #if";
+        else if (right == -1)
+          left = op[0] == '/' ? (long long) (0ULL - l) : 0;
+        else
+          left = op[0] == '/' ? left / right : left % right;
+    }
+  }
+
+  return left;
+}
+
+static long long evalConditional(Eval* eval)
+{
+  long long condition = evalBinary(eval, 1);
+  if (eval->error != NULL || !evalAccept(eval, "?"))
+    return condition;
+
+  long long then = evalConditional(eval);
+  if (!evalAccept(eval, ":"))
+  {
+    eval->error = "Missing ':' in #if";
+    return 0;
+  }
+  long long otherwise = evalConditional(eval);
+  return condition ? then : otherwise;
+}
+
+// Value of the expression of an #if or #elif
+static int evaluate(Preprocessor* pp, const char* args, size_t length, int line)
+{
+  IdentList idents = { 0 };
+  scanIdents(args, 0, length, &idents);
+
+  // defined NAME and defined(NAME) are replaced before macros are expanded
+  TextBuffer resolved = { 0 };
+  size_t copied = 0;
+  for (size_t i = 0; i < idents.count; i++)
+  {
+    const Ident* ident = &idents.idents[i];
+    if (ident->begin < copied || ident->length != 7 || memcmp(args + ident->begin, "defined", 7) != 0)
+      continue;
+
+    size_t at = skipSpace(args, ident->begin + 7, length);
+    int paren = at < length && args[at] == '(';
+    if (paren)
+      at = skipSpace(args, at + 1, length);
+    size_t name_end = skipIdent(args, at, length);
+    size_t end = paren ? skipSpace(args, name_end, length) : name_end;
+
+    if (name_end == at || (paren && (end == length || args[end] != ')')))
+    {
+      report(pp, line, "Bad operand of defined in #if");
+      break;
+    }
+
+    textAppend(&resolved, args + copied, ident->begin - copied);
+    textAppend(&resolved, isDefined(pp, args + at, name_end - at) ? " 1 " : " 0 ", 3);
+    copied = paren ? end + 1 : end;
+  }
+  textAppend(&resolved, args + copied, length - copied);
+
+  idents.count = 0;
+  scanIdents(resolved.data, 0, resolved.size, &idents);
+  TextBuffer expanded = { 0 };
+  expand(pp, &expanded, resolved.data, 0, resolved.size, idents.idents, idents.count, line);
+
+  Eval eval = { expanded.data, 0, expanded.size, NULL };
+  long long value = evalConditional(&eval);
+  if (eval.error == NULL && skipSpace(eval.text, eval.at, eval.end) != eval.end)
+    eval.error = "Missing operator in #if";
+  if (eval.error != NULL)
+  {
+    report(pp, line, "%s", eval.error);
+    value = 0;
+  }
+
+  free(idents.idents);
+  textFree(&resolved);
+  textFree(&expanded);
+  return value != 0;
+}
+
+static void processFile(Preprocessor* pp, const SourceFile* file);
+
+// The file an #include names, NULL if there is none
+static SourceFile* resolveInclude(Preprocessor* pp, const SourceFile* from, const char* name, size_t length, int quoted)
+{
+  const char* slash = strrchr(from->path, '/');
+  size_t dir_length = slash ? (size_t) (slash - from->path) : 1;
+  const char* dir = slash ? from->path : ".";
+
+  // Resolved once per including directory and name
+  TextBuffer key = { 0 };
+  textAppend(&key, quoted ? "\"" : "<", 1);
+  textAppend(&key, name, length);
+  if (quoted)
+  {
+    textAppend(&key, "\n", 1);
+    textAppend(&key, dir, dir_length);
+  }
+
+  Atom atom = internAtom(&pp->includes, key.data, key.size);
+  textFree(&key);
+
+  if (atom < pp->resolved_capacity && pp->resolved[atom] != NULL)
+    return pp->resolved[atom];
+
+  if (atom >= pp->resolved_capacity)
+  {
+    size_t capacity = pp->resolved_capacity ? 2 * pp->resolved_capacity : 64;
+    while (capacity <= atom)
+      capacity *= 2;
+    pp->resolved = (SourceFile**) realloc(pp->resolved, capacity * sizeof(SourceFile*));
+    memset(pp->resolved + pp->resolved_capacity, 0, (capacity - pp->resolved_capacity) * sizeof(SourceFile*));
+    pp->resolved_capacity = capacity;
+  }
+
+  char path[PATH_MAX];
+  SourceFile* file = NULL;
+
+  if (name[0] == '/')
+  {
+    snprintf(path, sizeof(path), "%.*s", (int) length, name);
+    file = loadSource(path);
+  }
+  if (file == NULL && quoted && name[0] != '/')
+  {
+    snprintf(path, sizeof(path), "%.*s/%.*s", (int) dir_length, dir, (int) length, name);
+    file = loadSource(path);
+  }
+  for (size_t i = 0; file == NULL && name[0] != '/' && i < pp->include_count; i++)
+  {
+    snprintf(path, sizeof(path), "%s/%.*s", pp->include_dirs[i], (int) length, name);
+    file = loadSource(path);
+  }
+
+  pp->resolved[atom] = file;
+  return file;
+}
+
+/*
+  Include the file named by the arguments of an #include. Returns 1 if its
+  text was put in the output, followed by a newline.
+*/
+static int include(Preprocessor* pp, const SourceFile* from, const char* args, size_t length, int line)
+{
+  TextBuffer expanded = { 0 };
+  size_t at = skipSpace(args, 0, length);
+
+  // #include MACRO names the file with the text of the macro
+  if (at < length && args[at] != '"' && args[at] != '<')
+  {
+    IdentList idents = { 0 };
+    scanIdents(args, 0, length, &idents);
+    expand(pp, &expanded, args, 0, length, idents.idents, idents.count, line);
+    free(idents.idents);
+    args = expanded.data;
+    length = expanded.size;
+    at = skipSpace(args, 0, length);
+  }
+
+  int status = 0;
+  const char* close = at < length ? memchr(args + at + 1, args[at] == '<' ? '>' : '"', length - at - 1) : NULL;
+
+  if (at == length || (args[at] != '"' && args[at] != '<') || close == NULL)
+    report(pp, line, "#include expects \"FILENAME\" or <FILENAME>");
+  else
+  {
+    int quoted = args[at] == '"';
+    const char* name = args + at + 1;
+    size_t name_length = (size_t) (close - name);
+    SourceFile* file = name_length ? resolveInclude(pp, from, name, name_length, quoted) : NULL;
+
+    // System headers are not part of the language the checker knows, so
+    // a missing one is left out quietly
+    if (file == NULL && quoted)
+      report(pp, line, "Cannot find include file %.*s", (int) name_length, name);
+    else if (file == NULL)
+      ;
+    else if (file->once && file->id < pp->included_capacity && pp->included[file->id])
+      ;
+    else if (file->guard != NULL && isDefined(pp, file->guard, strlen(file->guard)))
+      ;
+    else if (pp->depth == MAX_INCLUDE_DEPTH)
+      report(pp, line, "#include nested too deeply");
+    else
+    {
+      if (file->id >= pp->included_capacity)
+      {
+        size_t capacity = pp->included_capacity ? pp->included_capacity : 64;
+        while (capacity <= file->id)
+          capacity *= 2;
+        pp->included = (unsigned char*) realloc(pp->included, capacity);
+        memset(pp->included + pp->included_capacity, 0, capacity - pp->included_capacity);
+        pp->included_capacity = capacity;
+      }
+      pp->included[file->id] = 1;
+
+      char marker[PATH_MAX + 32];
+      textAppend(&pp->out, marker, snprintf(marker, sizeof(marker), "# 1 \"%s\"\n", file->path));
+
+      pp->depth++;
+      processFile(pp, file);
+      pp->depth--;
+
+      if (pp->out.size > 0 && pp->out.data[pp->out.size - 1] != '\n')
+        textNewlines(&pp->out, 1);
+      status = 1;
+    }
+  }
+
+  textFree(&expanded);
+  return status;
+}
+
+// How far a text line, with the lines joined to it, has been looked at for
+// a call of a function-like macro that its line does not close
+typedef struct CallScan
+{
+  size_t scanned;   // identifiers looked at
+  size_t at;        // the first byte not looked at
+  int depth;        // of parentheses in the open call, 0 when there is none
+} CallScan;
+
+/*
+  Whether text up to end leaves a call of a function-like macro open, so
+  that the line after it has to be joined on. Goes on from where scan
+  stopped last time, so joining many lines stays linear.
+*/
+static int callOpen(Preprocessor* pp, const char* text, size_t end, const Ident* idents, size_t count,
+                    CallScan* scan)
+{
+  for (;;)
+  {
+    for (size_t i = scan->at; scan->depth > 0 && i < end; i++)
+    {
+      char c = text[i];
+      if (c == '"' || c == '\'')
+      {
+        for (i++; i < end && text[i] != c; i++)
+          if (text[i] == '\\' && i + 1 < end)
+            i++;
+        if (i == end)
+          break;
+      }
+      else if (c == '(')
+        scan->depth++;
+      else if (c == ')' && --scan->depth == 0)
+        scan->at = i + 1;
+    }
+    if (scan->depth > 0)
+    {
+      scan->at = end;
+      return 1;
+    }
+
+    while (scan->scanned < count && idents[scan->scanned].begin < scan->at)
+      scan->scanned++;
+    if (scan->scanned == count)
+    {
+      scan->at = end;
+      return 0;
+    }
+
+    const Ident* ident = &idents[scan->scanned++];
+    Macro* macro = findMacro(pp, text + ident->begin, ident->length, ident->hash);
+    size_t open = skipSpace(text, ident->begin + ident->length, end);
+    scan->at = ident->begin + ident->length;
+    if (macro != NULL && macro->function && open < end && text[open] == '(')
+    {
+      scan->at = open + 1;
+      scan->depth = 1;
+    }
+  }
+}
+
+// An #if and what became of its branches
+typedef struct Conditional
+{
+  int line;         // of the #if
+  int parent;       // the lines around it are kept
+  int taken;        // one of its branches has been kept
+  int active;       // the current branch is kept
+  int seen_else;
+} Conditional;
+
+static void processFile(Preprocessor* pp, const SourceFile* file)
+{
+  Conditional* stack = NULL;
+  size_t depth = 0, capacity = 0;
+  int active = 1;
+  int line = 1;
+  TextBuffer args = { 0 };
+
+  for (size_t i = 0; i < file->line_count; line += file->lines[i++].newlines)
+  {
+    const SourceLine* source = &file->lines[i];
+    uint8_t directive = source->directive;
+
+    if (directive == DIRECTIVE_NONE)
+    {
+      if (!active)
+        ;
+      else if ((source->mask & pp->macro_mask) == 0)
+        textAppend(&pp->out, file->data + source->begin, source->end - source->begin);
+      else
+      {
+        // A macro call left open goes on over the text lines after it. They
+        // are expanded as one line, with blank lines after it so that every
+        // line after the call stays where it was.
+        const Ident* idents = file->idents.idents + source->idents;
+        size_t last = i, ident_count = source->ident_count, newlines = source->newlines;
+        CallScan scan = { 0, source->begin, 0 };
+
+        while (last + 1 < file->line_count && file->lines[last + 1].directive == DIRECTIVE_NONE &&
+               callOpen(pp, file->data, file->lines[last].end, idents, ident_count, &scan))
+        {
+          last++;
+          ident_count += file->lines[last].ident_count;
+          newlines += file->lines[last].newlines;
+        }
+
+        size_t start = pp->out.size;
+        expand(pp, &pp->out, file->data, source->begin, file->lines[last].end, idents, ident_count, line);
+        for (size_t j = start; last > i && j < pp->out.size; j++)
+          if (pp->out.data[j] == '\n')
+            pp->out.data[j] = ' ';
+
+        textNewlines(&pp->out, newlines);
+        line += (int) (newlines - file->lines[last].newlines);
+        i = last;
+        continue;
+      }
+      textNewlines(&pp->out, source->newlines);
+      continue;
+    }
+
+    int is_if = directive == DIRECTIVE_IF || directive == DIRECTIVE_IFDEF || directive == DIRECTIVE_IFNDEF;
+    int is_conditional = is_if || directive == DIRECTIVE_ELIF || directive == DIRECTIVE_ELSE || directive == DIRECTIVE_ENDIF;
+
+    if (!active && !is_conditional)
+    {
+      textNewlines(&pp->out, source->newlines);
+      continue;
+    }
+
+    directiveArgs(file, source, &args);
+    Conditional* top = depth ? &stack[depth - 1] : NULL;
+    size_t begin, length;
+
+    if (is_if)
+    {
+      if (depth == capacity)
+      {
+        capacity = capacity ? 2 * capacity : 16;
+        stack = (Conditional*) realloc(stack, capacity * sizeof(Conditional));
+      }
+
+      int value = 0;
+      if (active && directive == DIRECTIVE_IF)
+        value = evaluate(pp, args.data, args.size, line);
+      else if (active && (length = firstName(args.data, args.size, &begin)) == 0)
+        report(pp, line, "Macro name missing in #%s", directive_names[directive]);
+      else if (active)
+        value = isDefined(pp, args.data + begin, length) == (directive == DIRECTIVE_IFDEF);
+
+      Conditional* pushed = &stack[depth++];
+      pushed->line = line;
+      pushed->parent = active;
+      pushed->taken = value || !active;
+      pushed->active = active && value;
+      pushed->seen_else = 0;
+    }
+    else if ((directive == DIRECTIVE_ELIF || directive == DIRECTIVE_ELSE || directive == DIRECTIVE_ENDIF) && top == NULL)
+      report(pp, line, "#%s without #if", directive_names[directive]);
+    else if (directive == DIRECTIVE_ELIF || directive == DIRECTIVE_ELSE)
+    {
+      if (top->seen_else)
+        report(pp, line, "#%s after #else", directive_names[directive]);
+
+      if (top->taken)
+        top->active = 0;
+      else
+      {
+        top->active = directive == DIRECTIVE_ELSE || evaluate(pp, args.data, args.size, line);
+        top->taken = top->active;
+      }
+      top->seen_else |= directive == DIRECTIVE_ELSE;
+    }
+    else if (directive == DIRECTIVE_ENDIF)
+      depth--;
+    else if (directive == DIRECTIVE_DEFINE)
+      define(pp, args.data, args.size, line);
+    else if (directive == DIRECTIVE_UNDEF)
+    {
+      if ((length = firstName(args.data, args.size, &begin)) == 0)
+        report(pp, line, "Macro name missing in #undef");
+      else if (isDefined(pp, args.data + begin, length))
+        clearMacro(macroAt(pp, args.data + begin, length));
+    }
+    else if (directive == DIRECTIVE_INCLUDE)
+    {
+      if (include(pp, file, args.data, args.size, line))
+      {
+        // Carry on from the line after the #include
+        char marker[PATH_MAX + 32];
+        textAppend(&pp->out, marker, snprintf(marker, sizeof(marker), "# %d \"%s\"\n",
+                                              line + (int) source->newlines, file->path));
+        active = depth ? stack[depth - 1].active : 1;
+        continue;
+      }
+    }
+    else if (directive == DIRECTIVE_ERROR)
+      report(pp, line, "#error%.*s", (int) args.size, args.data);
+    else if (directive == DIRECTIVE_UNKNOWN)
+    {
+      size_t name = skipSpace(file->data, skipSpace(file->data, source->begin, source->end) + 1, source->end);
+      report(pp, line, "Unknown directive #%.*s", (int) (source->args - name), file->data + name);
+    }
+
+    active = depth ? stack[depth - 1].active : 1;
+    textNewlines(&pp->out, source->newlines);
+  }
+
+  for (size_t k = 0; k < depth; k++)
+    report(pp, stack[k].line, "Unterminated conditional directive");
+
+  free(stack);
+  textFree(&args);
+}
+
+void preprocInit(Preprocessor* pp, Diagnostics* diag, const char* const* include_dirs, size_t include_count)
+{
+  memset(pp, 0, sizeof(*pp));
+  pp->diag = diag;
+  pp->include_dirs = include_dirs;
+  pp->include_count = include_count;
+  internInit(&pp->names);
+  internInit(&pp->includes);
+}
+
+void preprocFree(Preprocessor* pp)
+{
+  for (size_t i = 0; i < pp->macros_capacity; i++)
+    clearMacro(&pp->macros[i]);
+  free(pp->macros);
+  free(pp->resolved);
+  free(pp->included);
+  internFree(&pp->names);
+  internFree(&pp->includes);
+  textFree(&pp->out);
+}
+
+void preprocess(Preprocessor* pp, const char* path, const char* text, size_t size)
+{
+  // The file itself is scanned for this run only and is not cached
+  SourceFile file;
+  memset(&file, 0, sizeof(file));
+  file.path = (char*) path;
+  file.data = text;
+  file.size = size;
+  file.id = SIZE_MAX;
+
+  scanSource(&file);
+  processFile(pp, &file);
+
+  free(file.lines);
+  free(file.idents.idents);
+  free(file.guard);
+}
@@ -0,0 +1,63 @@
+#ifndef PREPROC_H
+#define PREPROC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "diag.h"
+#include "intern.h"
+
+/*
+  Preprocessor run over a file before it is scanned.
+
+  It handles #include, object-like and function-like #define, #undef,
+  #if, #ifdef, #ifndef, #elif, #else, #endif, #error and #pragma once.
+  The output keeps every line of the file where it was: directives and
+  lines skipped by a conditional become empty lines, and the text of an
+  included file is put between line markers (# line "file") from which
+  the lexer takes its line number.
+
+  Headers are mapped into memory and split into lines and identifiers
+  once per process, in a cache shared by all threads, so a header that
+  many files include is read and scanned once. A line of text is copied
+  to the output as it is unless one of its identifiers may name a macro.
+  A header with an include guard or #pragma once is not walked again
+  once it has been included.
+*/
+
+// Growable text
+typedef struct TextBuffer
+{
+  char* data;
+  size_t size;
+  size_t capacity;
+} TextBuffer;
+
+typedef struct Preprocessor
+{
+  Diagnostics* diag;                // where errors are reported
+  const char* const* include_dirs;  // searched for #include, in order
+  size_t include_count;
+
+  InternPool names;                 // macro names
+  struct Macro* macros;             // by Atom of their name
+  size_t macros_capacity;
+  uint64_t macro_mask;              // bit of the hash of every name defined
+
+  InternPool includes;              // directory and name of every #include
+  struct SourceFile** resolved;     // by Atom of an #include, NULL until found
+  size_t resolved_capacity;
+  unsigned char* included;          // by id of a cached file: included yet
+  size_t included_capacity;
+  int depth;                        // nesting of #include
+
+  TextBuffer out;
+} Preprocessor;
+
+void preprocInit(Preprocessor* pp, Diagnostics* diag, const char* const* include_dirs, size_t include_count);
+void preprocFree(Preprocessor* pp);
+
+// Preprocess the size bytes at text, read from path, into pp->out
+void preprocess(Preprocessor* pp, const char* path, const char* text, size_t size);
+
+#endif
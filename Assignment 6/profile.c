@@ -0,0 +1,227 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+#define TIME_UNIT "cycles"
+
+static uint64_t now(void)
+{
+  return __rdtsc();
+}
+#else
+#define TIME_UNIT "ns"
+
+static uint64_t now(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t) time.tv_sec * 1000000000u + (uint64_t) time.tv_nsec;
+}
+#endif
+
+typedef struct RuleProfile
+{
+  const char* lhs;
+  int line;
+  uint64_t reductions;
+  uint64_t time;       // spent in the action, summed
+} RuleProfile;
+
+// Counts of one thread, indexed by rule and by state
+typedef struct Profile
+{
+  RuleProfile* rules;
+  size_t rule_count;
+  uint64_t* states;    // reductions in each state
+  size_t state_count;
+  int rule;            // whose action is running, or -1
+  uint64_t start;      // of that action
+  struct Profile* next;
+} Profile;
+
+static _Thread_local Profile* current;
+static Profile* profiles;  // of every thread
+static pthread_mutex_t profiles_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t setup_once = PTHREAD_ONCE_INIT;
+
+// Time two reads of the clock in a row take, which every action is charged
+static uint64_t overhead;
+
+static void writeReport(void);
+
+static void setup(void)
+{
+  overhead = UINT64_MAX;
+  for (int i = 0; i < 1000; i++)
+  {
+    uint64_t start = now();
+    uint64_t time = now() - start;
+    if (time < overhead)
+      overhead = time;
+  }
+  atexit(writeReport);
+}
+
+// The table with room for index, its new entries zeroed
+static void* grow(void* table, size_t* count, size_t index, size_t size)
+{
+  if (index < *count)
+    return table;
+
+  size_t capacity = *count ? *count : 64;
+  while (capacity <= index)
+    capacity *= 2;
+
+  table = realloc(table, capacity * size);
+  memset((char*) table + *count * size, 0, (capacity - *count) * size);
+  *count = capacity;
+  return table;
+}
+
+static Profile* threadProfile(void)
+{
+  if (current != NULL)
+    return current;
+
+  pthread_once(&setup_once, setup);
+  current = (Profile*) calloc(1, sizeof(Profile));
+  current->rule = -1;
+
+  pthread_mutex_lock(&profiles_lock);
+  current->next = profiles;
+  profiles = current;
+  pthread_mutex_unlock(&profiles_lock);
+  return current;
+}
+
+void profileReduce(int rule, int state, const char* lhs, int line)
+{
+  Profile* profile = threadProfile();
+  profile->rules = (RuleProfile*) grow(profile->rules, &profile->rule_count, rule, sizeof(RuleProfile));
+  profile->states = (uint64_t*) grow(profile->states, &profile->state_count, state, sizeof(uint64_t));
+
+  RuleProfile* entry = &profile->rules[rule];
+  entry->lhs = lhs;
+  entry->line = line;
+  entry->reductions++;
+  profile->states[state]++;
+
+  profile->rule = rule;
+  profile->start = now();
+}
+
+void profileActionEnd(int rule)
+{
+  uint64_t end = now();
+  Profile* profile = current;
+
+  // An action that ended the parse with YYABORT never gets here
+  if (profile == NULL || profile->rule != rule)
+    return;
+
+  uint64_t time = end - profile->start;
+  profile->rules[rule].time += time > overhead ? time - overhead : 0;
+  profile->rule = -1;
+}
+
+// Totals of all the threads, for sorting
+static RuleProfile* rule_totals;
+static uint64_t* state_totals;
+
+static int byTime(const void* a, const void* b)
+{
+  uint64_t x = rule_totals[*(const size_t*) a].time;
+  uint64_t y = rule_totals[*(const size_t*) b].time;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int byReductions(const void* a, const void* b)
+{
+  uint64_t x = state_totals[*(const size_t*) a];
+  uint64_t y = state_totals[*(const size_t*) b];
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void writeReport(void)
+{
+  size_t rule_count = 0;
+  size_t state_count = 0;
+
+  for (Profile* profile = profiles; profile != NULL; profile = profile->next)
+  {
+    if (profile->rule_count > 0)
+      rule_totals = (RuleProfile*) grow(rule_totals, &rule_count, profile->rule_count - 1, sizeof(RuleProfile));
+    if (profile->state_count > 0)
+      state_totals = (uint64_t*) grow(state_totals, &state_count, profile->state_count - 1, sizeof(uint64_t));
+
+    for (size_t i = 0; i < profile->rule_count; i++)
+      if (profile->rules[i].reductions > 0)
+      {
+        rule_totals[i].lhs = profile->rules[i].lhs;
+        rule_totals[i].line = profile->rules[i].line;
+        rule_totals[i].reductions += profile->rules[i].reductions;
+        rule_totals[i].time += profile->rules[i].time;
+      }
+    for (size_t i = 0; i < profile->state_count; i++)
+      state_totals[i] += profile->states[i];
+  }
+
+  size_t* order = (size_t*) malloc(((rule_count > state_count ? rule_count : state_count) + 1) * sizeof(size_t));
+  size_t used = 0;
+  uint64_t reductions = 0;
+  uint64_t time = 0;
+
+  for (size_t i = 0; i < rule_count; i++)
+    if (rule_totals[i].reductions > 0)
+    {
+      order[used++] = i;
+      reductions += rule_totals[i].reductions;
+      time += rule_totals[i].time;
+    }
+  qsort(order, used, sizeof(size_t), byTime);
+
+  FILE* out = fopen(PROFILE_FILE, "w");
+  if (out != NULL)
+  {
+    double total_time = time ? (double) time : 1.0;
+    double total_reductions = reductions ? (double) reductions : 1.0;
+
+    fprintf(out, "Parser profile: %llu reductions, %llu %s in actions\n\n",
+            (unsigned long long) reductions, (unsigned long long) time, TIME_UNIT);
+
+    // yacc numbers the rules of y.output from 0, one below its own numbers
+    fprintf(out, "Rules by time in their action (%s, less %llu per action for the clock)\n",
+            TIME_UNIT, (unsigned long long) overhead);
+    fprintf(out, "  rule  line  %-16s %12s %14s %10s %7s\n", "lhs", "reductions", "time", "per red.", "share");
+    for (size_t i = 0; i < used; i++)
+    {
+      const RuleProfile* rule = &rule_totals[order[i]];
+      fprintf(out, "  %4zu  %4d  %-16s %12llu %14llu %10.1f %6.1f%%\n", order[i] - 1, rule->line, rule->lhs,
+              (unsigned long long) rule->reductions, (unsigned long long) rule->time,
+              (double) rule->time / (double) rule->reductions, 100.0 * rule->time / total_time);
+    }
+
+    used = 0;
+    for (size_t i = 0; i < state_count; i++)
+      if (state_totals[i] > 0)
+        order[used++] = i;
+    qsort(order, used, sizeof(size_t), byReductions);
+
+    fprintf(out, "\nStates by reductions\n");
+    fprintf(out, "  state %12s %7s\n", "reductions", "share");
+    for (size_t i = 0; i < used; i++)
+      fprintf(out, "  %5zu %12llu %6.1f%%\n", order[i], (unsigned long long) state_totals[order[i]],
+              100.0 * state_totals[order[i]] / total_reductions);
+    fclose(out);
+  }
+
+  free(order);
+}
@@ -0,0 +1,61 @@
+#include <string.h>
+#include <time.h>
+
+#include "symstats.h"
+
+void statsInit(SymtableStats* stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+uint64_t statsClock(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+void statsLookup(SymtableStats* stats, size_t probes, int hit, uint64_t ns)
+{
+  stats->lookups++;
+  stats->hits += hit != 0;
+  stats->probes += probes;
+  if (probes > stats->max_probes)
+    stats->max_probes = probes;
+  stats->histogram[probes < STATS_BUCKETS ? probes : STATS_BUCKETS - 1]++;
+  stats->lookup_ns += ns;
+}
+
+void statsMerge(SymtableStats* into, const SymtableStats* from)
+{
+  into->lookups += from->lookups;
+  into->hits += from->hits;
+  into->inserts += from->inserts;
+  into->scope_exits += from->scope_exits;
+  into->dropped += from->dropped;
+  into->probes += from->probes;
+  if (from->max_probes > into->max_probes)
+    into->max_probes = from->max_probes;
+  for (int i = 0; i < STATS_BUCKETS; i++)
+    into->histogram[i] += from->histogram[i];
+  into->lookup_ns += from->lookup_ns;
+}
+
+void statsPrint(const SymtableStats* stats, const char* probe, FILE* out)
+{
+  double lookups = stats->lookups ? (double) stats->lookups : 1.0;
+
+  fprintf(out, "Symbol table statistics\n");
+  fprintf(out, "  lookups      %zu (%zu found)\n", stats->lookups, stats->hits);
+  fprintf(out, "  inserts      %zu\n", stats->inserts);
+  fprintf(out, "  scope exits  %zu (%zu symbols dropped)\n", stats->scope_exits, stats->dropped);
+  fprintf(out, "  lookup time  %.3f ms (%.1f ns per lookup)\n",
+          stats->lookup_ns / 1e6, stats->lookup_ns / lookups);
+  fprintf(out, "  %ss per lookup: %.2f on average, %zu at most\n",
+          probe, stats->probes / lookups, stats->max_probes);
+
+  for (int i = 0; i < STATS_BUCKETS; i++)
+    if (stats->histogram[i] != 0)
+      fprintf(out, "  %4d%s %10zu  %5.1f%%\n", i, i == STATS_BUCKETS - 1 ? "+" : " ",
+              stats->histogram[i], 100.0 * stats->histogram[i] / lookups);
+}
@@ -0,0 +1,43 @@
+#ifndef SYMSTATS_H
+#define SYMSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Lookups are counted by probes taken, up to STATS_BUCKETS - 1 and more
+#define STATS_BUCKETS 8
+
+/*
+  Statistics of the symbol table, kept when asked for. A probe is one node
+  of the trie visited by a lookup. How many probes lookups take, and how
+  long they take, shows how well the table and its hash cope with the
+  names of a program.
+*/
+typedef struct SymtableStats
+{
+  size_t lookups;
+  size_t hits;                      // lookups that found a symbol
+  size_t inserts;
+  size_t scope_exits;
+  size_t dropped;                   // symbols dropped on scope exits
+  size_t probes;                    // taken by all lookups
+  size_t max_probes;                // taken by the longest lookup
+  size_t histogram[STATS_BUCKETS];  // lookups by probes taken
+  uint64_t lookup_ns;               // time spent looking up
+} SymtableStats;
+
+void statsInit(SymtableStats* stats);
+
+// Monotonic clock in nanoseconds
+uint64_t statsClock(void);
+
+void statsLookup(SymtableStats* stats, size_t probes, int hit, uint64_t ns);
+
+// Add the counts of from to into
+void statsMerge(SymtableStats* into, const SymtableStats* from);
+
+// Print the statistics; probe names what a probe is in this table
+void statsPrint(const SymtableStats* stats, const char* probe, FILE* out);
+
+#endif
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "symtable.h"
+
+// Bits of the hash used by each level of the trie
+#define LEVEL_BITS 5
+#define LEVEL_MASK ((1u << LEVEL_BITS) - 1)
+
+#define CHUNK_SIZE 65536
+
+// A child of a node: a symbol, or the node below
+typedef union SymEntry
+{
+  Symbol symbol;
+  const SymNode* node;
+} SymEntry;
+
+struct SymNode
+{
+  uint32_t bitmap;     // bit i set if the node has a child for index i
+  uint32_t leaves;     // bit i set if that child is a symbol
+  SymEntry entries[];  // one per bit of bitmap, in index order
+};
+
+struct SymChunk
+{
+  struct SymChunk* next;
+  size_t size;
+  max_align_t data[];
+};
+
+void symPoolInit(SymPool* pool)
+{
+  pool->chunks = NULL;
+  pool->used = 0;
+}
+
+void symPoolFree(SymPool* pool)
+{
+  while (pool->chunks != NULL)
+  {
+    struct SymChunk* next = pool->chunks->next;
+    free(pool->chunks);
+    pool->chunks = next;
+  }
+  pool->used = 0;
+}
+
+static SymNode* allocateNode(SymPool* pool, int count)
+{
+  size_t size = sizeof(SymNode) + (size_t) count * sizeof(SymEntry);
+  size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+
+  if (pool->chunks == NULL || pool->used + size > pool->chunks->size)
+  {
+    size_t capacity = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+    struct SymChunk* chunk = (struct SymChunk*) malloc(sizeof(struct SymChunk) + capacity);
+    chunk->next = pool->chunks;
+    chunk->size = capacity;
+    pool->chunks = chunk;
+    pool->used = 0;
+  }
+
+  SymNode* node = (SymNode*) ((char*) pool->chunks->data + pool->used);
+  pool->used += size;
+  return node;
+}
+
+static int indexAt(uint64_t hash, unsigned shift)
+{
+  return (int) ((hash >> shift) & LEVEL_MASK);
+}
+
+// Position among the entries of the child for index, if it has one
+static int position(const SymNode* node, int index)
+{
+  return __builtin_popcount(node->bitmap & ((1u << index) - 1));
+}
+
+/*
+  Atoms are small consecutive integers, so they are spread over the whole
+  64-bit range with the murmur3 finalizer before use. The finalizer is a
+  bijection, so two names never have the same hash and the trie needs no
+  collision lists.
+*/
+uint64_t symtableHash(Atom name)
+{
+  uint64_t hash = name;
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+Symtable symtableEmpty(void)
+{
+  Symtable table = { NULL, 0 };
+  return table;
+}
+
+// A node holding just the two symbols, which differ in hash from shift on
+static const SymNode* pair(SymPool* pool, const Symbol* a, uint64_t a_hash,
+                           const Symbol* b, uint64_t b_hash, unsigned shift)
+{
+  int a_index = indexAt(a_hash, shift);
+  int b_index = indexAt(b_hash, shift);
+
+  if (a_index == b_index)
+  {
+    SymNode* node = allocateNode(pool, 1);
+    node->bitmap = 1u << a_index;
+    node->leaves = 0;
+    node->entries[0].node = pair(pool, a, a_hash, b, b_hash, shift + LEVEL_BITS);
+    return node;
+  }
+
+  SymNode* node = allocateNode(pool, 2);
+  node->bitmap = (1u << a_index) | (1u << b_index);
+  node->leaves = node->bitmap;
+  node->entries[a_index < b_index ? 0 : 1].symbol = *a;
+  node->entries[a_index < b_index ? 1 : 0].symbol = *b;
+  return node;
+}
+
+// Copy of node with room for extra more entries, the new one at pos
+static SymNode* copyNode(SymPool* pool, const SymNode* node, int extra, int pos)
+{
+  int count = __builtin_popcount(node->bitmap);
+  SymNode* copy = allocateNode(pool, count + extra);
+  copy->bitmap = node->bitmap;
+  copy->leaves = node->leaves;
+
+  memcpy(copy->entries, node->entries, pos * sizeof(SymEntry));
+  memcpy(copy->entries + pos + extra, node->entries + pos, (count - pos) * sizeof(SymEntry));
+  return copy;
+}
+
+// The node with symbol put in, and *added set if its name was not there
+static const SymNode* insert(SymPool* pool, const SymNode* node, const Symbol* symbol,
+                             uint64_t hash, unsigned shift, int* added)
+{
+  int index = indexAt(hash, shift);
+  uint32_t bit = 1u << index;
+
+  if (node == NULL || !(node->bitmap & bit))
+  {
+    *added = 1;
+    if (node == NULL)
+    {
+      SymNode* leaf = allocateNode(pool, 1);
+      leaf->bitmap = leaf->leaves = bit;
+      leaf->entries[0].symbol = *symbol;
+      return leaf;
+    }
+
+    int pos = position(node, index);
+    SymNode* copy = copyNode(pool, node, 1, pos);
+    copy->bitmap |= bit;
+    copy->leaves |= bit;
+    copy->entries[pos].symbol = *symbol;
+    return copy;
+  }
+
+  int pos = position(node, index);
+  SymNode* copy = copyNode(pool, node, 0, pos);
+
+  if (!(node->leaves & bit))
+    copy->entries[pos].node = insert(pool, node->entries[pos].node, symbol, hash, shift + LEVEL_BITS, added);
+  else if (node->entries[pos].symbol.name == symbol->name)
+    copy->entries[pos].symbol = *symbol;
+  else
+  {
+    // Two names now share this index: they move down a level
+    const Symbol* other = &node->entries[pos].symbol;
+    copy->leaves &= ~bit;
+    copy->entries[pos].node = pair(pool, other, symtableHash(other->name), symbol, hash, shift + LEVEL_BITS);
+    *added = 1;
+  }
+  return copy;
+}
+
+Symtable symtableInsert(SymPool* pool, Symtable table, Atom name, int dtype, int scope)
+{
+  Symbol symbol = { name, dtype, scope };
+  int added = 0;
+
+  table.root = insert(pool, table.root, &symbol, symtableHash(name), 0, &added);
+  table.size += added;
+  return table;
+}
+
+const Symbol* symtableLookup(Symtable table, Atom name)
+{
+  uint64_t hash = symtableHash(name);
+  const SymNode* node = table.root;
+
+  for (unsigned shift = 0; node != NULL; shift += LEVEL_BITS)
+  {
+    int index = indexAt(hash, shift);
+    uint32_t bit = 1u << index;
+    if (!(node->bitmap & bit))
+      return NULL;
+
+    const SymEntry* entry = &node->entries[position(node, index)];
+    if (node->leaves & bit)
+      return entry->symbol.name == name ? &entry->symbol : NULL;
+    node = entry->node;
+  }
+  return NULL;
+}
+
+int symtableDepth(Symtable table, Atom name)
+{
+  uint64_t hash = symtableHash(name);
+  const SymNode* node = table.root;
+  int depth = 0;
+
+  for (unsigned shift = 0; node != NULL; shift += LEVEL_BITS)
+  {
+    int index = indexAt(hash, shift);
+    uint32_t bit = 1u << index;
+    depth++;
+    if (!(node->bitmap & bit) || (node->leaves & bit))
+      break;
+    node = node->entries[position(node, index)].node;
+  }
+  return depth;
+}
+
+const Symbol* symtableLookupInScope(Symtable table, Atom name, int scope)
+{
+  // A symbol of the current scope is always the innermost one of its name
+  const Symbol* symbol = symtableLookup(table, name);
+  if (symbol == NULL || symbol->scope != scope)
+    return NULL;
+
+  return symbol;
+}
+
+static void forEach(const SymNode* node, void (*visit)(const Symbol* symbol, void* arg), void* arg)
+{
+  int count = __builtin_popcount(node->bitmap);
+  uint32_t bits = node->bitmap;
+
+  for (int pos = 0; pos < count; pos++, bits &= bits - 1)
+  {
+    uint32_t bit = bits & -bits;
+    if (node->leaves & bit)
+      visit(&node->entries[pos].symbol, arg);
+    else
+      forEach(node->entries[pos].node, visit, arg);
+  }
+}
+
+void symtableForEach(Symtable table, void (*visit)(const Symbol* symbol, void* arg), void* arg)
+{
+  if (table.root != NULL)
+    forEach(table.root, visit, arg);
+}
+
+static void printSymbol(const Symbol* symbol, void* arg)
+{
+  printf("%s %d %d\n", atomName((const InternPool*) arg, symbol->name), symbol->dtype, symbol->scope);
+}
+
+void symtablePrint(Symtable table, const InternPool* names)
+{
+  symtableForEach(table, printSymbol, (void*) names);
+}
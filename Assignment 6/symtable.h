@@ -0,0 +1,75 @@
+#ifndef SYMTABLE_H
+#define SYMTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "intern.h"
+
+// Structure for a symbol's entry in a symbol table
+typedef struct Symbol
+{
+  Atom name;         // name of the identifier
+  int dtype;         // TypeId of its type; 0 for int, 1 for float
+  int scope;         // scope of this symbol
+} Symbol;
+
+// Node of the trie, never changed once built
+typedef struct SymNode SymNode;
+
+// Storage of trie nodes, all freed at once
+typedef struct SymPool
+{
+  struct SymChunk* chunks;  // newest first
+  size_t used;              // bytes used of the newest chunk
+} SymPool;
+
+/*
+  Persistent symbol table.
+
+  A Symtable is one version of a hash array mapped trie from names to
+  their innermost symbol. Each level of the trie takes 5 more bits of the
+  hash of an Atom, and a node only stores the children it has, found with
+  a 32-bit bitmap and a population count. No version ever changes:
+  adding a symbol copies the O(log n) nodes on the path to it and shares
+  all the others, and returns a new version.
+
+  So a Symtable is a value. Entering a scope is remembering the current
+  version and leaving it is going back to that version, and a snapshot
+  can be handed to another thread, which reads it while this one goes
+  on adding to its own versions. Nodes come from a SymPool and live until
+  the pool is freed.
+*/
+typedef struct Symtable
+{
+  const SymNode* root;
+  size_t size;       // number of names with a symbol
+} Symtable;
+
+void symPoolInit(SymPool* pool);
+void symPoolFree(SymPool* pool);
+
+// The table without any symbols
+Symtable symtableEmpty(void);
+
+uint64_t symtableHash(Atom name);
+
+// The table with a symbol added, hiding any other of its name. The new
+// nodes are taken from pool; table itself is unchanged.
+Symtable symtableInsert(SymPool* pool, Symtable table, Atom name, int dtype, int scope);
+
+// Innermost symbol with the given name, or NULL
+const Symbol* symtableLookup(Symtable table, Atom name);
+
+// Number of nodes a lookup of name visits, for statistics
+int symtableDepth(Symtable table, Atom name);
+
+// Symbol with the given name declared exactly in scope, or NULL
+const Symbol* symtableLookupInScope(Symtable table, Atom name, int scope);
+
+// Call visit on the innermost symbol of every name, in trie order
+void symtableForEach(Symtable table, void (*visit)(const Symbol* symbol, void* arg), void* arg);
+
+void symtablePrint(Symtable table, const InternPool* names);
+
+#endif
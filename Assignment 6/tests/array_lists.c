@@ -0,0 +1,16 @@
+int main()
+{
+  int a[2], b[3], c;
+  int d[3], a[2];
+  int e[7], b[4];
+  float f[1.5], g[8];
+  float g[8], f[2.5];
+  return 0;
+}
+
+int other(int x)
+{
+  int a[10], b[10];
+  int b[100];
+  return x;
+}
@@ -0,0 +1,14 @@
+int main()
+{
+  int a[5];
+  int a[6];
+  int b[5];
+  int b[5];
+  float c[2];
+  {
+    float c[3];
+    float c[3];
+    float c[4];
+  }
+  return 0;
+}
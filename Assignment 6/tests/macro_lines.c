@@ -0,0 +1,12 @@
+#define F(x, y) ((x) + (y))
+int main()
+{
+  int a;
+  a = F(a,
+        1);
+  a = F(F(a, 2),
+        F(3,
+          a)) + b;
+  c = a;
+  return 0;
+}
@@ -0,0 +1,485 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dce.h"
+
+// Where a block goes on to when it does not, or when the program ends
+#define NO_BLOCK SIZE_MAX
+#define END_BLOCK (SIZE_MAX - 1)
+
+// No quad, or the number of a name only one block mentions
+#define NONE SIZE_MAX
+#define LOCAL UINT32_MAX
+
+typedef uint64_t Word;
+#define WORD_BITS 64
+
+// Variables and temporaries, numbered densely: variable a is its Atom and
+// temporary tn is n after the variables. Only the global names, which
+// more than one block mentions or which a block reads before it sets
+// them, are in the sets of the blocks, so that these stay small however
+// long the program is
+typedef struct Names
+{
+  uint32_t var_count;
+  uint32_t count;
+  uint32_t* global;   // number of each name among the global ones, or LOCAL
+  uint32_t global_count;
+  size_t words;       // of a set of global names
+} Names;
+
+typedef struct Block
+{
+  size_t start;
+  size_t end;         // one past its last quad
+  size_t next[2];     // blocks it goes on to, or NO_BLOCK or END_BLOCK
+  Word* use;          // global names read before they are set in it
+  Word* def;          // global names set in it
+  Word* in;           // global names live where it starts
+  Word* out;          // and where it ends
+} Block;
+
+// The names live at a point of a block. A local name that the block has
+// not set or read yet, going backwards, is live if it is a variable and
+// dead if it is a temporary
+typedef struct Live
+{
+  Word* global;
+  uint32_t* local;    // 2 * (block + 1), plus 1 if live
+  uint32_t block;
+} Live;
+
+// Where the reads and the sets of a name were last seen in a block
+typedef struct Mention
+{
+  size_t block;
+  size_t read;
+  size_t set;
+} Mention;
+
+// A copy "name = from" made in a block
+typedef struct Copy
+{
+  Operand from;
+  uint32_t version;   // of from when copied
+  size_t block;       // + 1, or 0 if it does not hold
+} Copy;
+
+static int isName(Operand operand)
+{
+  return operand.kind == OPERAND_VAR || operand.kind == OPERAND_TEMP;
+}
+
+static uint32_t nameOf(const Names* names, Operand operand)
+{
+  return operand.kind == OPERAND_VAR ? operand.index : names->var_count + operand.index;
+}
+
+static int sameOperand(Operand a, Operand b)
+{
+  return a.kind == b.kind && a.index == b.index;
+}
+
+static int has(const Word* set, uint32_t n)
+{
+  return (set[n / WORD_BITS] >> (n % WORD_BITS)) & 1;
+}
+
+static void add(Word* set, uint32_t n)
+{
+  set[n / WORD_BITS] |= (Word) 1 << (n % WORD_BITS);
+}
+
+static void drop(Word* set, uint32_t n)
+{
+  set[n / WORD_BITS] &= ~((Word) 1 << (n % WORD_BITS));
+}
+
+static int isLive(const Names* names, const Live* live, Operand operand)
+{
+  uint32_t name = nameOf(names, operand);
+  if (names->global[name] != LOCAL)
+    return has(live->global, names->global[name]);
+  if (live->local[name] >> 1 != live->block + 1)
+    return operand.kind == OPERAND_VAR;
+  return live->local[name] & 1;
+}
+
+static void setLive(const Names* names, Live* live, Operand operand, int is_live)
+{
+  uint32_t name = nameOf(names, operand);
+  if (names->global[name] == LOCAL)
+    live->local[name] = 2 * (live->block + 1) + (is_live ? 1 : 0);
+  else if (is_live)
+    add(live->global, names->global[name]);
+  else
+    drop(live->global, names->global[name]);
+}
+
+// From the names live after a quad to those live before it
+static void liveBefore(const Names* names, const Quad* quad, Live* live)
+{
+  if (!quadIsJump(quad) && isName(quad->result))
+    setLive(names, live, quad->result, 0);
+  if (isName(quad->arg1))
+    setLive(names, live, quad->arg1, 1);
+  if (isName(quad->arg2))
+    setLive(names, live, quad->arg2, 1);
+}
+
+// Split the code into blocks, with the blocks each goes on to
+static size_t findBlocks(const QuadList* code, Block** blocks_out)
+{
+  uint8_t* leader = (uint8_t*) malloc(code->count);
+  quadLeaders(code, leader);
+
+  size_t count = 0;
+  for (size_t i = 0; i < code->count; i++)
+    count += leader[i];
+
+  Block* blocks = (Block*) calloc(count, sizeof(Block));
+  size_t* block_of = (size_t*) malloc((code->count + 1) * sizeof(size_t));
+  size_t b = 0;
+  for (size_t i = 0; i < code->count; i++)
+  {
+    if (leader[i] && i > 0)
+      blocks[b++].end = i;
+    if (leader[i])
+      blocks[b].start = i;
+    block_of[i] = b;
+  }
+  blocks[b].end = code->count;
+  block_of[code->count] = END_BLOCK;
+
+  for (b = 0; b < count; b++)
+  {
+    const Quad* last = &code->quads[blocks[b].end - 1];
+    blocks[b].next[0] = blocks[b].next[1] = NO_BLOCK;
+    if (last->op != QUAD_GOTO)
+      blocks[b].next[0] = block_of[blocks[b].end];
+    if (quadIsJump(last))
+      blocks[b].next[1] = block_of[last->result.index];
+  }
+
+  free(block_of);
+  free(leader);
+  *blocks_out = blocks;
+  return count;
+}
+
+// Number the names, and the global ones among them
+static void findNames(const QuadList* code, const Block* blocks, size_t count, Names* names)
+{
+  uint32_t vars = 0, temps = 0;
+  for (size_t i = 0; i < code->count; i++)
+  {
+    const Operand* operands[3] = { &code->quads[i].result, &code->quads[i].arg1, &code->quads[i].arg2 };
+    for (int j = 0; j < 3; j++)
+      if (operands[j]->kind == OPERAND_VAR && operands[j]->index >= vars)
+        vars = operands[j]->index + 1;
+      else if (operands[j]->kind == OPERAND_TEMP && operands[j]->index >= temps)
+        temps = operands[j]->index + 1;
+  }
+  names->var_count = vars;
+  names->count = vars + temps;
+  names->global = (uint32_t*) malloc(names->count * sizeof(uint32_t));
+
+  // the set field is only the block that last set the name
+  Mention* mention = (Mention*) malloc(names->count * sizeof(Mention));
+  for (uint32_t n = 0; n < names->count; n++)
+  {
+    names->global[n] = LOCAL;
+    mention[n].block = mention[n].set = NONE;
+  }
+
+  for (size_t b = 0; b < count; b++)
+    for (size_t i = blocks[b].start; i < blocks[b].end; i++)
+    {
+      const Quad* quad = &code->quads[i];
+      const Operand* operands[3] = { &quad->arg1, &quad->arg2, &quad->result };
+      for (int j = 0; j < 3; j++)
+      {
+        if (!isName(*operands[j]) || (j == 2 && quadIsJump(quad)))
+          continue;
+        uint32_t name = nameOf(names, *operands[j]);
+        if ((mention[name].block != NONE && mention[name].block != b) || (j < 2 && mention[name].set != b))
+          names->global[name] = 0;
+        mention[name].block = b;
+        if (j == 2)
+          mention[name].set = b;
+      }
+    }
+
+  names->global_count = 0;
+  for (uint32_t n = 0; n < names->count; n++)
+    if (names->global[n] != LOCAL)
+      names->global[n] = names->global_count++;
+  names->words = (names->global_count + WORD_BITS - 1) / WORD_BITS;
+  free(mention);
+}
+
+static void solveLiveness(const QuadList* code, const Names* names, Block* blocks, size_t count, Word* sets)
+{
+  size_t words = names->words;
+  Word* at_exit = sets;
+  memset(at_exit, 0, words * sizeof(Word));
+  for (uint32_t name = 0; name < names->var_count; name++)
+    if (names->global[name] != LOCAL)
+      add(at_exit, names->global[name]);
+
+  for (size_t b = 0; b < count; b++)
+  {
+    Block* block = &blocks[b];
+    block->use = sets + (1 + 4 * b) * words;
+    block->def = block->use + words;
+    block->in = block->def + words;
+    block->out = block->in + words;
+    memset(block->use, 0, 4 * words * sizeof(Word));
+
+    // backwards, a name read is used unless set before
+    for (size_t i = block->end; i-- > block->start;)
+    {
+      const Quad* quad = &code->quads[i];
+      const Operand* operands[3] = { &quad->result, &quad->arg1, &quad->arg2 };
+      for (int j = 0; j < 3; j++)
+      {
+        if (!isName(*operands[j]) || (j == 0 && quadIsJump(quad)))
+          continue;
+        uint32_t n = names->global[nameOf(names, *operands[j])];
+        if (n == LOCAL)
+          continue;
+        if (j > 0)
+          add(block->use, n);
+        else
+        {
+          drop(block->use, n);
+          add(block->def, n);
+        }
+      }
+    }
+  }
+
+  // later blocks first, as liveness flows backwards
+  int changed = 1;
+  while (changed)
+  {
+    changed = 0;
+    for (size_t b = count; b-- > 0;)
+    {
+      Block* block = &blocks[b];
+      for (int k = 0; k < 2; k++)
+      {
+        if (block->next[k] == NO_BLOCK)
+          continue;
+        const Word* in = block->next[k] == END_BLOCK ? at_exit : blocks[block->next[k]].in;
+        for (size_t w = 0; w < words; w++)
+          block->out[w] |= in[w];
+      }
+      for (size_t w = 0; w < words; w++)
+      {
+        Word in = block->use[w] | (block->out[w] & ~block->def[w]);
+        if (in != block->in[w])
+        {
+          block->in[w] = in;
+          changed = 1;
+        }
+      }
+    }
+  }
+}
+
+// Propagate the copies of each block into the quads after them; returns
+// whether a quad changed
+static int propagateCopies(QuadList* code, const Names* names, const Block* blocks, size_t count)
+{
+  // a copy holds while what it copied keeps the version it had then, as
+  // the version of a name goes up whenever it is set
+  Copy* copy_of = (Copy*) calloc(names->count, sizeof(Copy));
+  uint32_t* version = (uint32_t*) calloc(names->count, sizeof(uint32_t));
+  int changed = 0;
+
+  for (size_t b = 0; b < count; b++)
+    for (size_t i = blocks[b].start; i < blocks[b].end; i++)
+    {
+      Quad* quad = &code->quads[i];
+      Operand* args[2] = { &quad->arg1, &quad->arg2 };
+      for (int k = 0; k < 2; k++)
+      {
+        if (!isName(*args[k]))
+          continue;
+        const Copy* copy = &copy_of[nameOf(names, *args[k])];
+        if (copy->block != b + 1 || (isName(copy->from) && version[nameOf(names, copy->from)] != copy->version))
+          continue;
+
+        // a variable is not read from a temporary instead, which would
+        // keep the temporary live and the copy needed
+        if (args[k]->kind == OPERAND_VAR && copy->from.kind == OPERAND_TEMP)
+          continue;
+        if (quadIsJump(quad) && copy->from.kind == OPERAND_CONST)
+          continue;
+        *args[k] = copy->from;
+        changed = 1;
+      }
+
+      if (quadIsJump(quad) || !isName(quad->result))
+        continue;
+
+      uint32_t set = nameOf(names, quad->result);
+      version[set]++;
+      copy_of[set].block = 0;
+      if (quad->op == QUAD_COPY && !sameOperand(quad->arg1, quad->result))
+      {
+        copy_of[set].from = quad->arg1;
+        copy_of[set].version = isName(quad->arg1) ? version[nameOf(names, quad->arg1)] : 0;
+        copy_of[set].block = b + 1;
+      }
+    }
+
+  free(copy_of);
+  free(version);
+  return changed;
+}
+
+// For each copy "to = from", the quad of its block that last set from, if
+// no quad after that one reads from, or reads or sets to, before the copy;
+// NONE for other copies and other quads
+static void findSources(const QuadList* code, const Names* names, const Block* blocks, size_t count, size_t* source)
+{
+  Mention* mention = (Mention*) malloc(names->count * sizeof(Mention));
+  for (uint32_t n = 0; n < names->count; n++)
+    mention[n].block = NONE;
+
+  for (size_t b = 0; b < count; b++)
+    for (size_t k = blocks[b].start; k < blocks[b].end; k++)
+    {
+      const Quad* quad = &code->quads[k];
+      const Operand* operands[3] = { &quad->arg1, &quad->arg2, &quad->result };
+      for (int j = 0; j < 3; j++)
+        if (isName(*operands[j]) && mention[nameOf(names, *operands[j])].block != b)
+        {
+          Mention* m = &mention[nameOf(names, *operands[j])];
+          m->block = b;
+          m->read = m->set = NONE;
+        }
+
+      source[k] = NONE;
+      if (quad->op == QUAD_COPY && isName(quad->arg1) && !sameOperand(quad->arg1, quad->result))
+      {
+        const Mention* from = &mention[nameOf(names, quad->arg1)];
+        const Mention* to = &mention[nameOf(names, quad->result)];
+        size_t i = from->set;
+        if (i != NONE && (from->read == NONE || from->read <= i) && (to->read == NONE || to->read <= i) &&
+            (to->set == NONE || to->set < i))
+          source[k] = i;
+      }
+
+      if (isName(quad->arg1))
+        mention[nameOf(names, quad->arg1)].read = k;
+      if (isName(quad->arg2))
+        mention[nameOf(names, quad->arg2)].read = k;
+      if (!quadIsJump(quad) && isName(quad->result))
+        mention[nameOf(names, quad->result)].set = k;
+    }
+
+  free(mention);
+}
+
+// Remove dead quads and compute into the names copied to, going backwards
+// through each block from the names live at its end
+static void sweep(QuadList* code, const Names* names, const Block* blocks, size_t count, size_t* source,
+                  uint8_t* removed, Live* live)
+{
+  for (size_t b = 0; b < count; b++)
+  {
+    memcpy(live->global, blocks[b].out, names->words * sizeof(Word));
+    live->block = (uint32_t) b;
+    for (size_t k = blocks[b].end; k-- > blocks[b].start;)
+    {
+      Quad* quad = &code->quads[k];
+      if (quadIsJump(quad))
+      {
+        liveBefore(names, quad, live);
+        continue;
+      }
+
+      if (!isLive(names, live, quad->result) || (quad->op == QUAD_COPY && sameOperand(quad->arg1, quad->result)))
+      {
+        removed[k] = 1;
+        continue;
+      }
+
+      if (source[k] != NONE && !isLive(names, live, quad->arg1))
+      {
+        // the value is computed into the name copied to, which stays
+        // live up to there as nothing between reads or sets it. The
+        // source of the quad computing it was found for the name it set
+        // before, so it is left for the next sweep to find again
+        code->quads[source[k]].result = quad->result;
+        source[source[k]] = NONE;
+        removed[k] = 1;
+        continue;
+      }
+
+      liveBefore(names, quad, live);
+    }
+  }
+}
+
+// Solve liveness and sweep the code once; returns how many quads went
+static size_t sweepCode(QuadList* code)
+{
+  Block* blocks;
+  size_t count = findBlocks(code, &blocks);
+  Names names;
+  findNames(code, blocks, count, &names);
+
+  // a set for the end of the program, four per block and one for sweep()
+  Word* sets = (Word*) calloc((2 + 4 * count) * names.words, sizeof(Word));
+  solveLiveness(code, &names, blocks, count, sets);
+
+  size_t* source = (size_t*) malloc(code->count * sizeof(size_t));
+  findSources(code, &names, blocks, count, source);
+
+  Live live;
+  live.global = sets + (1 + 4 * count) * names.words;
+  live.local = (uint32_t*) calloc(names.count, sizeof(uint32_t));
+  uint8_t* removed = (uint8_t*) calloc(code->count, 1);
+  sweep(code, &names, blocks, count, source, removed, &live);
+  size_t removed_count = quadRemove(code, removed);
+
+  free(removed);
+  free(live.local);
+  free(source);
+  free(sets);
+  free(names.global);
+  free(blocks);
+  return removed_count;
+}
+
+size_t removeDeadCode(QuadList* code)
+{
+  // copies are computed into the names they copy to before they are
+  // propagated, which would keep what they copy live
+  size_t total = 0;
+  for (;;)
+  {
+    if (code->count == 0)
+      return total;
+
+    size_t removed = sweepCode(code);
+    total += removed;
+    if (code->count == 0)
+      return total;
+
+    Block* blocks;
+    size_t count = findBlocks(code, &blocks);
+    Names names;
+    findNames(code, blocks, count, &names);
+    int changed = propagateCopies(code, &names, blocks, count);
+    free(names.global);
+    free(blocks);
+
+    if (!changed && removed == 0)
+      return total;
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef DCE_H
+#define DCE_H
+
+#include "quad.h"
+
+/*
+  Copy propagation and dead code elimination, run after value numbering.
+
+  - A copy "x = y" within a basic block makes the quads after it read y
+    where they read x, until either is set again. A constant is not put
+    into a jump, whose test on a constant is folded as it is generated
+  - A quad computing into a name that only a copy reads computes into the
+    name copied to instead: "t4 = t1 + t3; a = t4" is "a = t1 + t3"
+  - A quad setting a name that is not live, which no quad can read before
+    it is set again, is removed, as is a copy of a name to itself
+
+  Liveness is solved over the basic blocks and their jumps, with every
+  variable live at the end of the program, as its value is left in
+  memory, and no temporary. The three are repeated until no quad is
+  removed.
+*/
+
+// Remove the quads copy propagation and liveness make useless; returns
+// how many
+size_t removeDeadCode(QuadList* code);
+
+#endif
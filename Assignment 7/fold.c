@@ -0,0 +1,233 @@
+#include <limits.h>
+#include <math.h>
+
+#include "fold.h"
+
+int foldConstant(const QuadList* code, Operand operand, Constant* value)
+{
+  if (operand.kind != OPERAND_CONST)
+    return 0;
+
+  *value = code->constants[operand.index];
+  return 1;
+}
+
+// Whether operand is 0; a float -0 is not, as -0 - -0 is 0 and not -0
+static int isZero(const QuadList* code, Operand operand)
+{
+  Constant constant;
+  if (!foldConstant(code, operand, &constant))
+    return 0;
+  return constant.dtype == TYPE_FLOAT ? constant.value.f == 0.0f && !signbit(constant.value.f) : constant.value.i == 0;
+}
+
+static int isOne(const QuadList* code, Operand operand)
+{
+  Constant constant;
+  if (!foldConstant(code, operand, &constant))
+    return 0;
+  return constant.dtype == TYPE_FLOAT ? constant.value.f == 1.0f : constant.value.i == 1;
+}
+
+// int arithmetic as the target does it, wrapping around instead of
+// overflowing
+static int wrap(long long value)
+{
+  return (int) (unsigned) value;
+}
+
+// Compute a op b into *result; fails where the program must do it
+static int compute(QuadOp op, Constant a, Constant b, Constant* result)
+{
+  if (a.dtype != b.dtype)
+    return 0;
+
+  result->dtype = a.dtype;
+  if (a.dtype == TYPE_FLOAT)
+  {
+    float x = a.value.f, y = b.value.f;
+    switch (op)
+    {
+      case QUAD_ADD: result->value.f = x + y; return 1;
+      case QUAD_SUB: result->value.f = x - y; return 1;
+      case QUAD_MUL: result->value.f = x * y; return 1;
+      case QUAD_DIV:
+        if (y == 0.0f)
+          return 0;
+        result->value.f = x / y;
+        return 1;
+      default:
+        return 0;
+    }
+  }
+
+  long long x = a.value.i, y = b.value.i;
+  switch (op)
+  {
+    case QUAD_ADD: result->value.i = wrap(x + y); return 1;
+    case QUAD_SUB: result->value.i = wrap(x - y); return 1;
+    case QUAD_MUL: result->value.i = wrap(x * y); return 1;
+    case QUAD_DIV:
+    case QUAD_MOD:
+      if (y == 0)
+        return 0;
+      // INT_MIN / -1 wraps to INT_MIN, with no remainder
+      result->value.i = op == QUAD_DIV ? wrap(x / y) : (int) (x % y);
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static Operand constantOperand(QuadList* code, Constant constant)
+{
+  if (constant.dtype == TYPE_FLOAT)
+    return quadFloat(code, constant.value.f);
+  return quadInt(code, constant.value.i);
+}
+
+// The quad that set temporary operand, while no other quad has read it
+static Quad* definition(QuadList* code, TempPool* temps, Operand operand)
+{
+  if (operand.kind != OPERAND_TEMP || operand.index == 0 || operand.index > temps->count || !temps->busy[operand.index])
+    return NULL;
+  return &code->quads[temps->defined[operand.index]];
+}
+
+// Fold "t op k" into the quad that set t, if that is "t = y op' c" or
+// "t = c - y" and both constants are int; returns whether it did
+static int reassociate(QuadList* code, TempPool* temps, QuadOp op, Operand t, Operand k)
+{
+  Quad* quad = definition(code, temps, t);
+  Constant c, d;
+  if (quad == NULL || !foldConstant(code, k, &d) || d.dtype != TYPE_INT)
+    return 0;
+
+  int additive = op == QUAD_ADD || op == QUAD_SUB;
+  if (additive && quad->op == QUAD_SUB && foldConstant(code, quad->arg1, &c) && c.dtype == TYPE_INT)
+  {
+    // c - y + k is (c + k) - y
+    long long sum = (long long) c.value.i + (op == QUAD_ADD ? (long long) d.value.i : -(long long) d.value.i);
+    quad->arg1 = quadInt(code, wrap(sum));
+    return 1;
+  }
+
+  if (!foldConstant(code, quad->arg2, &c) || c.dtype != TYPE_INT)
+    return 0;
+  if (additive && (quad->op == QUAD_ADD || quad->op == QUAD_SUB))
+  {
+    // y + c + k, with either + a -
+    long long sum = (quad->op == QUAD_ADD ? (long long) c.value.i : -(long long) c.value.i)
+                    + (op == QUAD_ADD ? (long long) d.value.i : -(long long) d.value.i);
+    int total = wrap(sum);
+    if (total == 0)
+    {
+      quad->op = QUAD_COPY;
+      quad->arg2 = NO_OPERAND;
+    }
+    else if (total > 0 || total == INT_MIN)
+    {
+      quad->op = QUAD_ADD;
+      quad->arg2 = quadInt(code, total);
+    }
+    else
+    {
+      quad->op = QUAD_SUB;
+      quad->arg2 = quadInt(code, -total);
+    }
+    return 1;
+  }
+
+  if (op == QUAD_MUL && quad->op == QUAD_MUL)
+  {
+    int product = wrap((long long) c.value.i * d.value.i);
+    if (product == 0)
+    {
+      quad->op = QUAD_COPY;
+      quad->arg1 = quadInt(code, 0);
+      quad->arg2 = NO_OPERAND;
+    }
+    else if (product == 1)
+    {
+      quad->op = QUAD_COPY;
+      quad->arg2 = NO_OPERAND;
+    }
+    else
+      quad->arg2 = quadInt(code, product);
+    return 1;
+  }
+
+  return 0;
+}
+
+Operand foldQuad(QuadList* code, TempPool* temps, TypeId dtype, QuadOp* op, Operand* arg1, Operand* arg2)
+{
+  Constant a, b, result;
+  int constant1 = foldConstant(code, *arg1, &a);
+
+  if (*op == QUAD_NEG)
+  {
+    if (!constant1)
+      return NO_OPERAND;
+    if (a.dtype == TYPE_FLOAT)
+      return quadFloat(code, -a.value.f);
+    return quadInt(code, wrap(-(long long) a.value.i));
+  }
+
+  int constant2 = foldConstant(code, *arg2, &b);
+  if (constant1 && constant2)
+    return compute(*op, a, b, &result) ? constantOperand(code, result) : NO_OPERAND;
+
+  if (constant1 && (*op == QUAD_ADD || *op == QUAD_MUL))
+  {
+    Operand swap = *arg1;
+    *arg1 = *arg2;
+    *arg2 = swap;
+    b = a;
+    constant2 = 1;
+  }
+
+  // x + -c is x - c, which reads better and is what reassociate() makes
+  if (constant2 && b.dtype == TYPE_INT && b.value.i < 0 && b.value.i != INT_MIN && (*op == QUAD_ADD || *op == QUAD_SUB))
+  {
+    *op = *op == QUAD_ADD ? QUAD_SUB : QUAD_ADD;
+    b.value.i = -b.value.i;
+    *arg2 = quadInt(code, b.value.i);
+  }
+
+  // with a float constant, only the identities that hold for every float
+  int is_int = constant2 && b.dtype == TYPE_INT;
+  switch (*op)
+  {
+    case QUAD_ADD:
+      if (is_int && b.value.i == 0)
+        return *arg1;
+      break;
+    case QUAD_SUB:
+      if (isZero(code, *arg2))
+        return *arg1;
+      if (dtype == TYPE_INT && arg1->kind == OPERAND_VAR && arg2->kind == OPERAND_VAR && arg1->index == arg2->index)
+        return quadInt(code, 0);
+      break;
+    case QUAD_MUL:
+      if (isOne(code, *arg2))
+        return *arg1;
+      if (is_int && b.value.i == 0)
+      {
+        // the quads that computed arg1 are left for dead code to remove
+        tempRelease(temps, *arg1);
+        return *arg2;
+      }
+      break;
+    case QUAD_DIV:
+      if (isOne(code, *arg2))
+        return *arg1;
+      break;
+    default:
+      break;
+  }
+
+  if (is_int && reassociate(code, temps, *op, *arg1, *arg2))
+    return *arg1;
+  return NO_OPERAND;
+}
@@ -0,0 +1,34 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "quad.h"
+
+/*
+  Constant folding and algebraic simplification, done as each quad of an
+  expression is about to be generated, so that only the code left over is
+  ever emitted.
+
+  - An operator applied to constants is computed with the semantics of
+    their type: int arithmetic wraps around and divides towards zero,
+    float arithmetic is done in float. A division by zero is left for
+    the program to do when it runs
+  - Identities drop the operator: x+0, x-0, x*1 and x/1 are x, and x*0
+    and x-x are 0. Where x is float, only those that hold for every float,
+    infinities, NaN and -0 included, are used: x-0, x*1 and x/1. The 0
+    of x-0 is not -0 there, as -0 - -0 is 0
+  - Constant chains of int + and -, or of int *, are reassociated: the
+    quad that set t in "t = b - 4" becomes "t = b - 1" when t + 3 is
+    asked for, as t is read only once
+  - A constant is put on the right of + and *, so that the above find it
+    there
+*/
+
+// Operand holding arg1 op arg2 of type dtype, for a binary op, or op arg1
+// for QUAD_NEG, when it can be had without a new quad; NO_OPERAND
+// otherwise, after putting a constant on the right of a commutative op
+Operand foldQuad(QuadList* code, TempPool* temps, TypeId dtype, QuadOp* op, Operand* arg1, Operand* arg2);
+
+// Whether operand is a constant; its value is then stored in *value
+int foldConstant(const QuadList* code, Operand operand, Constant* value);
+
+#endif
@@ -3,8 +3,13 @@
 #include <stdlib.h>
 #include <string.h>
 
-// Size of HashTable
-#define TABLE_SIZE 100
+#include "dce.h"
+#include "fold.h"
+#include "lvn.h"
+#include "quad.h"
+#include "symstats.h"
+#include "symtable.h"
+#include "types.h"
 
 int yylex();
 int yyerror(char* s);
@@ -12,294 +17,335 @@ int yylineno;
 FILE* yyin;
 int success=1;
 
+// Syntax errors recovered from so far, and how many are too many to go on
+int syntax_errors=0;
+#define MAX_SYNTAX_ERRORS 20
+
 // File to store the generated intermediate code
 FILE* interm_file;
 
-// Keeps track of the label number for lines of intermediate code
-int interm_label=0;
-
-// Used to create new unique temporary variable name for intermediate code
-int new_temp_index=1;
-
-// Stores intermediate code corresponding to a label
-char* interm_code[100];
+// Temporaries of the function being parsed
+TempPool temps;
 
-int temp_label=0, backpatch_label=0, temp=0;
-
-// expr_var tracks last assigned var in expressions/assignment
-// temp_var is useful for backpatching later
-char expr_var[10], temp_var[10];
+// Intermediate code of the whole translation unit; the number of the next
+// quad, code.count, is the label of the next line
+QuadList code;
 
 // Tracks scope during parsing
 int scope=0;
 
 // Stores datatype during parsing
-int dtype;
-
-/** SYMBOL TABLE DS BEGINS **/
-
-// Structure for a symbol's entry in a symbol table
-typedef struct Symbol
-{
-    char name[10]; // name of the identifier
-    int dtype; // 0 for int; 1 for float
-    int scope; // scope of this symbol
-    struct Symbol* next;
-} Symbol;
-
-// Symbol table structure
-typedef struct Symtable
-{
-    Symbol* entry[TABLE_SIZE];
-} Symtable;
+TypeId dtype;
 
-/*
-http://www.cse.yorku.ca/~oz/hash.html -> djb2 algorithm
+// Variables of the declaration being parsed and their array lengths
+Atom* vars=NULL;
+int* var_lengths=NULL;
+size_t var_count=0, var_capacity=0;
 
-this algorithm (k=33) was first reported by dan bernstein many years ago in
-comp.lang.c. another version of this algorithm (now favored by bernstein)
-uses xor: hash(i) = hash(i - 1) * 33 ^ str[i]; the magic of number 33 (why
-it works better than many other constants, prime or not) has never
-been adequately explained.
-*/
-int hash(char *str)
-{
-  int hash = 5381;
-  int c;
+// Every type used by the program, each stored once
+TypeTable types;
 
-  while ((c = *str++))
-    hash = ((hash << 5) + hash) + c; // hash * 33 + c
-
-  return hash % TABLE_SIZE;
-}
+/** SYMBOL TABLE DS BEGINS **/
 
 // Global variable for symbol table
 Symtable table;
 
-// Initialize all pointers in the symbol table to NULL
+// Statistics of the symbol table, kept if not NULL
+SymtableStats* stats=NULL;
+SymtableStats table_stats;
+
+// Initialize the symbol table
 void init()
 {
-    for(int i=0;i<TABLE_SIZE;i++)
-    {
-        table.entry[i]=NULL;
-    }
+    symtableInit(&table);
+    typeTableInit(&types);
 }
 
 // Function to add a new entry to symbol table
-void add(char* symb)
+void add(Atom symb,TypeId type)
 {
-    int hval=hash(symb);
-    Symbol* head=table.entry[hval];
-    if(head==NULL)
-    { // No collision
-        head=(Symbol*)malloc(sizeof(Symbol));
-        strcpy(head->name,symb);
-        head->dtype=dtype;
-        head->scope=scope;
-        head->next=NULL;
-        table.entry[hval]=head;
-        return;
+    symtableInsert(&table,symb,type,scope);
+    if(stats!=NULL){
+        stats->inserts++;
     }
-    // For collision, add this new symbol to the end of list
-    while(head->next!=NULL)
-    {
-        head=head->next;
+}
+
+// Innermost symbol with the given name, counted and timed if stats are kept
+Symbol* lookup(Atom symb)
+{
+    if(stats==NULL){
+        return symtableLookup(&table,symb);
     }
-    head->next=(Symbol*)malloc(sizeof(Symbol));
-    strcpy(head->name,symb);
-    head->dtype=dtype;
-    head->scope=scope;
-    head->next=NULL;
+    uint64_t start=statsClock();
+    Symbol* symbol=symtableLookup(&table,symb);
+    uint64_t ns=statsClock()-start;
+    statsLookup(stats,symtableProbes(&table,symb),symbol!=NULL,ns);
+    return symbol;
 }
 
 // Function to check if the variable is being redefined in same scope
 // returns 1 for redeclaration, 2 for conflicting types, otherwise 0
-int existsInSameScope(char* symb)
+int existsInSameScope(Atom symb,TypeId type)
 {
-    int hval=hash(symb);
-    Symbol* head=table.entry[hval];
-    if(head==NULL)
+    // A symbol of the current scope is always the innermost one of its name
+    Symbol* symbol=lookup(symb);
+    if(symbol==NULL || symbol->scope!=scope)
     {
         return 0;
     }
-    while(head!=NULL)
-    {
-        // If the symbol names match and
-        //      the current scope==its scope
-        // then it implies that this identifier is
-        //      either being redeclared (if datatypes are same)
-        //      or, conflicting types found (if datatypes differ)
-        if(strcmp(head->name,symb)==0 && head->scope==scope)
-        {
-            if(dtype==head->dtype)
-            { // redeclaration
-                    return 1;
-            }
-            else
-            { // conflicting types
-                    return 2;
-            }
-        }
-        head=head->next;
+    if(type==(TypeId)symbol->dtype)
+    { // redeclaration
+            return 1;
+    }
+    else
+    { // conflicting types
+            return 2;
     }
-    return 0;
 }
 
 // Function to check if hashtable contains a particular symbol
-int contains(char* symb)
+int contains(Atom symb)
 {
-    int hval=hash(symb);
-    Symbol* head=table.entry[hval];
-    if(head==NULL)
-    {
-        return 0;
+    return lookup(symb)!=NULL;
+}
+
+// Function to get the type of the value a symbol present in symbol table
+// stands for, which for an array is its element type
+TypeId getDtype(Atom symb)
+{
+    Symbol* symbol=lookup(symb);
+    if(symbol==NULL)
+    { // not needed since the symbol is known to exist in the table
+        return TYPE_INT;
     }
-    while(head!=NULL)
+    return typeValue(&types,symbol->dtype);
+}
+
+// Type of a variable of the declaration being parsed, given its array
+// length, or -1 if it is not an array
+TypeId declaredType(int length)
+{
+    if(length<0)
     {
-        // If the symbol names match
-        // then it implies that this identifier is already present
-        if(strcmp(head->name,symb)==0)
-        {
-            return 1;
-        }
-        head=head->next;
+        return dtype;
     }
-    return 0;
+    return typeArray(&types,dtype,(uint32_t)length);
 }
 
-// Function to get the data type of a symbol present in symbol table
-int getDtype(char* symb)
+// The variables of a declaration are read left to right, so the parser
+// stack does not grow with their number, but declared from the last one
+// back once it ends, as the right recursive rule for them used to
+void pushVar(Atom symb,int length)
 {
-    int hval=hash(symb);
-    Symbol* head=table.entry[hval];
-    while(head!=NULL)
+    if(var_count==var_capacity){
+        var_capacity=var_capacity?2*var_capacity:16;
+        vars=(Atom*)realloc(vars,var_capacity*sizeof(Atom));
+        var_lengths=(int*)realloc(var_lengths,var_capacity*sizeof(int));
+    }
+    vars[var_count]=symb;
+    var_lengths[var_count]=length;
+    var_count+=1;
+}
+
+void declareVars()
+{
+    while(var_count>0)
     {
-        if(strcmp(head->name,symb)==0)
-        {
-            return head->dtype;
+        var_count-=1;
+        Atom symb=vars[var_count];
+        TypeId declared=declaredType(var_lengths[var_count]);
+        int type=existsInSameScope(symb,declared);
+        if(type==1){
+            char buff[50];
+            snprintf(buff,sizeof(buff),": Multiple definitions of the identifier %s",atomName(symb));
+            yyerror(buff);
+        } else if(type==2){
+            char buff[50];
+            snprintf(buff,sizeof(buff),": Conflicting types for the identifier %s",atomName(symb));
+            yyerror(buff);
+        } else{
+            add(symb,declared);
         }
-        head=head->next;
     }
-    // not needed since the symbol is known to exist in the table
-    return 0;
+}
+
+// Function to open a new scope when entering a block
+void enterScope()
+{
+    scope+=1;
+    symtableEnterScope(&table);
 }
 
 // Function to delete symbols of a scope when coming out of that scope
-void deleteSymbolsOfScope(int scope)
+void exitScope()
 {
-    for(int i=0;i<TABLE_SIZE;i++)
-    {
-        Symbol* head=table.entry[i];
-        Symbol* temp;
-        if(head==NULL)
-        {
-            continue;
-        }
-        // Delete "matching scope" symbols at the start of the list
-        while(head!=NULL && head->scope==scope)
-        {
-            temp=head;
-            head=head->next;
-            free(temp);
-            table.entry[i]=head;
-        }
-        // Look for the required symbols using the previous pointer
-        while(head!=NULL && head->next!=NULL)
-        {
-            if(head->next->scope==scope)
-            { // Delete the next symbol
-                    temp=head->next;
-                    head->next=temp->next;
-                    free(temp);
-            }
-            else
-            { // Move the pointer forward
-                    head=head->next;
-            }
-        }
+    size_t size=table.size;
+    symtableExitScope(&table);
+    scope-=1;
+    if(stats!=NULL){
+        stats->scope_exits++;
+        stats->dropped+=size-table.size;
     }
 }
 
 // Helper function to print symbols in symbol table
 void printSymbolTable()
 {
-    for(int i=0;i<TABLE_SIZE;i++)
-    {
-        if(table.entry[i]==NULL)
-        {
-            continue;
-        }
-        printf("\nPrinting at index %d\n",i);
-        Symbol* head=table.entry[i];
-        while(head!=NULL)
-        {
-            printf("%s %d %d\n",head->name,head->dtype,head->scope);
-            head=head->next;
-        }
-    }
+    symtablePrint(&table);
 }
 
 // Free all the DMA space of hashtable
 void freeAll()
 {
-    for(int i=0;i<TABLE_SIZE;i++)
-    {
-        Symbol* head=table.entry[i];
-        Symbol* temp;
-        while(head!=NULL)
-        {
-            temp=head;
-            head=head->next;
-            free(temp);
-        }
-    }
+    symtableFree(&table);
+    typeTableFree(&types);
+    internFree();
+    free(vars);
+    free(var_lengths);
 }
 
 /** SYMBOL TABLE DS ENDS **/
 
+// Count a syntax error the parser recovered from; returns 1 once there
+// have been too many, since later ones likely only follow from the first
+int recover()
+{
+    syntax_errors+=1;
+    if(syntax_errors<MAX_SYNTAX_ERRORS)
+    {
+        return 0;
+    }
+    printf("\nParsing stopped at line %d : Too many syntax errors\n",yylineno);
+    return 1;
+}
+
 /** FUNCTIONS FOR INTERMEDIATE CODE GENERATION **/
 
-// Function to return name of a new temporary variable
-char* newTemp()
+// Function to append a quadruple to the intermediate code; a temporary
+// is used once, so those it reads are free again after it
+size_t generate(QuadOp op,Operand result,Operand arg1,Operand arg2)
 {
-    static char t[3];
-    sprintf(t,"t%d",new_temp_index);
-    return t;
+    tempRelease(&temps,arg2);
+    tempRelease(&temps,arg1);
+    return quadEmit(&code,op,result,arg1,arg2);
 }
 
-// Function to emit the quadruple to output array
-void generate(int label,char* str)
+// Function to append a quadruple whose result of type dtype is a new
+// temporary, which may be one it reads itself; constants are folded
+// instead, so the result may be any operand
+Operand generateTemp(QuadOp op,TypeId dtype,Operand arg1,Operand arg2)
 {
-    interm_code[label]=(char*)malloc((strlen(str)+1)*sizeof(char));
-    strcpy(interm_code[label],str);
+    Operand folded=foldQuad(&code,&temps,dtype,&op,&arg1,&arg2);
+    if(folded.kind!=OPERAND_NONE){
+        return folded;
+    }
+    tempRelease(&temps,arg2);
+    tempRelease(&temps,arg1);
+    Operand temp=tempTake(&temps,code.count);
+    quadEmit(&code,op,temp,arg1,arg2);
+    return temp;
 }
 
-// Function to print the intermediate codes to output file
-void writeIntermCode(){
-    for(int i=0;i<100;i++)
-    {
-        if(interm_code[i]!=NULL)
-        {
-            fprintf(interm_file,"%d: %s",i,interm_code[i]);
-            free(interm_code[i]);
+// Mark where the code of a function ends, and free its temporaries for
+// the next
+void endFunction(Atom name)
+{
+    quadEndFunction(&code,name);
+    tempPoolReset(&temps);
+}
+
+// Report the temporaries each function uses once the code is optimised
+void printTemporaries(void)
+{
+    size_t begin=0;
+    for(size_t f=0;f<code.function_count;f++){
+        const FunctionCode* function=&code.functions[f];
+        printf("\nTemporaries used by %s: %u",atomName(function->name),quadTempsUsed(&code,begin,function->end));
+        begin=function->end;
+    }
+}
+
+/*
+  A condition is compiled to jumps, and the value it tests last is only
+  tested once it is known which way the code after it goes on: the jump
+  of that test goes where the code does not simply fall through. So
+  "a && b" is "ifFalse a goto F; ifFalse b goto F" and "a || b" is
+  "if a goto T; ifFalse b goto F", and no value is ever computed only to
+  be tested.
+*/
+Condition condition(Operand value)
+{
+    Condition cond={NO_JUMPS,NO_JUMPS,value,0};
+    return cond;
+}
+
+// Test the value left untested in cond, jumping if cond is `when`; the
+// code falls through otherwise
+void jumpIf(Condition* cond,int when)
+{
+    if(cond->test.kind==OPERAND_NONE){
+        return;
+    }
+    // a negated value makes the condition true when it is zero
+    QuadOp op=when!=cond->negated?QUAD_IF:QUAD_IFFALSE;
+    Constant value;
+    if(foldConstant(&code,cond->test,&value)){
+        // the jump is always or never taken
+        int nonzero=value.dtype==TYPE_FLOAT?value.value.f!=0.0f:value.value.i!=0;
+        cond->test=NO_OPERAND;
+        if(nonzero!=(op==QUAD_IF)){
+            return;
         }
+        op=QUAD_GOTO;
+    }
+    JumpList jump=quadJump(&code,op,cond->test);
+    tempRelease(&temps,cond->test);
+    if(when){
+        cond->truelist=quadMerge(&code,cond->truelist,jump);
+    } else{
+        cond->falselist=quadMerge(&code,cond->falselist,jump);
     }
+    cond->test=NO_OPERAND;
+}
+
+// Finish the condition of a statement, whose body comes next and is run
+// when it is true; returns the jumps taken when it is false
+JumpList bodyIfTrue(Condition cond)
+{
+    jumpIf(&cond,0);
+    quadBackpatch(&code,cond.truelist,code.count);
+    return cond.falselist;
+}
+
+// Function to print the intermediate codes to output file
+void writeIntermCode(){
+    quadDump(&code,interm_file);
 }
 
 %}
 
+%code requires
+{
+#include "intern.h"
+#include "quad.h"
+#include "types.h"
+}
+
 // yylval is now a union (instead of default int)
 // which can hold different info.
 %union
 {
     int number;     // for integer constants
     float decimal;  // for floating point numbers
-    char* string;   // for name of identifiers
+    Atom atom;      // for name of identifiers
     struct DtypeName
     {                   // for expressions
-        int dtype;      // for datatype of expressions
-        char* place;    // for "place" value of expression
+        TypeId dtype;   // for datatype of expressions
+        Operand place;  // for "place" value of expression
     } DtypeName;
+    Condition cond;         // for conditions
+    JumpList nextlist;      // jumps to the end of a statement
+    size_t label;           // number of a quad
 }
 
 %token INT_CONST_TOK
@@ -314,6 +360,8 @@ void writeIntermCode(){
 %token LSQ_TOK
 %token RSQ_TOK
 
+%left  OR_TOK
+%left  AND_TOK
 %left  PLUS_TOK MINUS_TOK
 %left  ASTERISK_TOK QUOTIENT_TOK MODULUS_TOK
 
@@ -325,14 +373,18 @@ void writeIntermCode(){
 %token WHILE_TOK
 %token RETURN_TOK
 %token IDENTIFIER_TOK
+%token NOT_TOK
 
 %nonassoc LOWER_THAN_ELSE
 %nonassoc ELSE_TOK
 
 %type<number> INT_CONST_TOK
-%type<string> IDENTIFIER_TOK
+%type<atom> IDENTIFIER_TOK FN_NAME
 %type<decimal> FLOAT_CONST_TOK
-%type<DtypeName> EXPRESSION
+%type<DtypeName> EXPRESSION PRIMARY ASSIGN
+%type<cond> COND_PART NEGATION
+%type<nextlist> ELSE_OPTN ELSE_PART
+%type<number> ARRAY_OPTN
 
 %start S
 
@@ -340,23 +392,23 @@ void writeIntermCode(){
 %%
 S:      MAIN_FN US_DEF_FNS
         ;
-MAIN_FN:        DATATYPE MAIN_TOK LPAREN_TOK RPAREN_TOK BLK      {printf("\nSyntax of main function is correct");}
+MAIN_FN:        DATATYPE MAIN_TOK LPAREN_TOK RPAREN_TOK BLK      {printf("\nSyntax of main function is correct"); endFunction(internAtom("main",4));}
                 ;
 BLK:    BLK_START STMTS BLKS BLK_END
+        |
+        BLK_START STMTS error BLK_END   {if(recover()) YYABORT; yyerrok;}
         ;
-BLK_START:      LCURLY_TOK      {scope+=1;}
+BLK_START:      LCURLY_TOK      {enterScope();}
                 ;
-BLK_END:        RCURLY_TOK      {   deleteSymbolsOfScope(scope);
-                                    scope-=1;
-                                }
+BLK_END:        RCURLY_TOK      {exitScope();}
                 ;
-BLKS:   BLK STMTS BLKS
+BLKS:   BLKS BLK STMTS
         |
         ;
 STMTS:  STMTS STMT
         |
         ;
-STMT:   RETURN_TOK EXPRESSION SEMICOLON_TOK     {printf("\nSyntax of return statement is correct");}
+STMT:   RETURN_TOK EXPRESSION SEMICOLON_TOK     {tempRelease(&temps,$2.place); printf("\nSyntax of return statement is correct");}
         |
         DECLARATION SEMICOLON_TOK       {printf("\nSyntax of declaration statement is correct");}
         |
@@ -367,68 +419,48 @@ STMT:   RETURN_TOK EXPRESSION SEMICOLON_TOK     {printf("\nSyntax of return stat
         ITER                            {printf("\nSyntax of iterative statement is correct");}
         |
         COND                            {printf("\nSyntax of conditional statement is correct");}
+        |
+        error SEMICOLON_TOK             {if(recover()) YYABORT; yyerrok;}
         ;
-DECLARATION:    DATATYPE VARS
+DECLARATION:    DATATYPE VARS   {declareVars();}
                 ;
-DATATYPE:   INT_TOK     {dtype=0;}
+DATATYPE:   INT_TOK     {dtype=TYPE_INT;}
             |
-            FLOAT_TOK   {dtype=1;}
+            FLOAT_TOK   {dtype=TYPE_FLOAT;}
             ;
-VARS:   IDENTIFIER_TOK ARRAY_OPTN       { int type = existsInSameScope($1);
-                                            if(type==1){
-                                                char buff[50];
-                                                sprintf(buff,": Multiple definitions of the identifier %s",$1);
-                                                yyerror(buff);
-                                            } else if(type==2){
-                                                char buff[50];
-                                                sprintf(buff,": Conflicting types for the identifier %s",$1);
-                                                yyerror(buff);
-                                            } else{
-                                                add($1);
-                                        } }
+VARS:   IDENTIFIER_TOK ARRAY_OPTN       {var_count=0; pushVar($1,$2);}
         |
-        IDENTIFIER_TOK ARRAY_OPTN COMMA_TOK VARS        { int type = existsInSameScope($1);
-                                                            if(type==1){
-                                                                char buff[50];
-                                                                sprintf(buff,": Multiple definitions of the identifier %s",$1);
-                                                                yyerror(buff);
-                                                            } else if(type==2){
-                                                                char buff[50];
-                                                                sprintf(buff,": Conflicting types for the identifier %s",$1);
-                                                                yyerror(buff);
-                                                            } else{
-                                                                add($1);
-                                                        } }
+        VARS COMMA_TOK IDENTIFIER_TOK ARRAY_OPTN        {pushVar($3,$4);}
         ;
-ARRAY_OPTN:     LSQ_TOK INT_CONST_TOK RSQ_TOK
+ARRAY_OPTN:     LSQ_TOK INT_CONST_TOK RSQ_TOK   {$$=$2;}
                 |
                 LSQ_TOK FLOAT_CONST_TOK RSQ_TOK { char buff[40];
                                                     sprintf(buff,": Incorrect Array Declaration");
                                                     yyerror(buff);
+                                                    $$=-1;
                                                 }
-                |
+                |                               {$$=-1;}
                 ;
 ASSIGN: IDENTIFIER_TOK ASSIGN_TOK EXPRESSION    { if(!contains($1)){
                                                         char buff[40];
-                                                        sprintf(buff,": Undefined identifier %s",$1);
+                                                        snprintf(buff,sizeof(buff),": Undefined identifier %s",atomName($1));
                                                         yyerror(buff);
                                                     } else{
                                                         if(getDtype($1)!=$3.dtype){
                                                                 char buff[50];
                                                                 sprintf(buff,": Illegal assignment (Type Error) detected");
                                                                 yyerror(buff);
-                                                        } else{ // no issues; let us generate the intermediate code
-                                                                char buff[40];
-                                                                sprintf(buff,"%s = %s\n",$1,$3.place);
-                                                                generate(interm_label,buff);
-                                                                strcpy(expr_var,$1);
-                                                                interm_label+=1;
+                                                        } else if($3.place.kind!=OPERAND_VAR || $3.place.index!=$1){
+                                                                // no issues (and not folded to x=x); let us generate the intermediate code
+                                                                generate(QUAD_COPY,quadVar($1),$3.place,NO_OPERAND);
                                                         }
-                                                } }
-        ;
-EXPRESSION: LPAREN_TOK EXPRESSION RPAREN_TOK    { $$.dtype=$2.dtype;
-                                                    $$.place=strdup($2.place);
                                                 }
+                                                // tested when the assignment is a condition
+                                                $$.dtype=$3.dtype;
+                                                $$.place=quadVar($1);
+                                                }
+        ;
+EXPRESSION: PRIMARY     {$$=$1;}
             |
             EXPRESSION PLUS_TOK EXPRESSION      { if($1.dtype!=$3.dtype){
                                                         char buff[40];
@@ -436,15 +468,7 @@ EXPRESSION: LPAREN_TOK EXPRESSION RPAREN_TOK    { $$.dtype=$2.dtype;
                                                         yyerror(buff);
                                                     } else{
                                                         $$.dtype=$1.dtype;
-                                                        char* temp=newTemp();
-                                                        new_temp_index+=1;
-                                                        $$.place=strdup(temp);
-
-                                                        char buff[40];
-                                                        sprintf(buff,"%s = %s + %s\n",$$.place,$1.place,$3.place);
-                                                        generate(interm_label,buff);
-                                                        strcpy(expr_var,$$.place);
-                                                        interm_label+=1;
+                                                        $$.place=generateTemp(QUAD_ADD,$1.dtype,$1.place,$3.place);
                                                     }
                                                 }
             |
@@ -454,15 +478,7 @@ EXPRESSION: LPAREN_TOK EXPRESSION RPAREN_TOK    { $$.dtype=$2.dtype;
                                                         sprintf(buff,": Type error in expression");
                                                         yyerror(buff);
                                                     } else{
-                                                        char* temp=newTemp();
-                                                        new_temp_index+=1;
-                                                        $$.place=strdup(temp);
-
-                                                        char buff[40];
-                                                        sprintf(buff,"%s = %s - %s\n",$$.place,$1.place,$3.place);
-                                                        generate(interm_label,buff);
-                                                        strcpy(expr_var,$$.place);
-                                                        interm_label+=1;
+                                                        $$.place=generateTemp(QUAD_SUB,$1.dtype,$1.place,$3.place);
                                                     }
                                                 }
             |
@@ -472,15 +488,7 @@ EXPRESSION: LPAREN_TOK EXPRESSION RPAREN_TOK    { $$.dtype=$2.dtype;
                                                         sprintf(buff,": Type error in expression");
                                                         yyerror(buff);
                                                     } else{
-                                                        char* temp=newTemp();
-                                                        new_temp_index+=1;
-                                                        $$.place=strdup(temp);
-
-                                                        char buff[40];
-                                                        sprintf(buff,"%s = %s * %s\n",$$.place,$1.place,$3.place);
-                                                        generate(interm_label,buff);
-                                                        strcpy(expr_var,$$.place);
-                                                        interm_label+=1;
+                                                        $$.place=generateTemp(QUAD_MUL,$1.dtype,$1.place,$3.place);
                                                     }
                                                 }
             |
@@ -490,15 +498,7 @@ EXPRESSION: LPAREN_TOK EXPRESSION RPAREN_TOK    { $$.dtype=$2.dtype;
                                                         sprintf(buff,": Type error in expression");
                                                         yyerror(buff);
                                                     } else{
-                                                        char* temp=newTemp();
-                                                        new_temp_index+=1;
-                                                        $$.place=strdup(temp);
-
-                                                        char buff[40];
-                                                        sprintf(buff,"%s = %s / %s\n",$$.place,$1.place,$3.place);
-                                                        generate(interm_label,buff);
-                                                        strcpy(expr_var,$$.place);
-                                                        interm_label+=1;
+                                                        $$.place=generateTemp(QUAD_DIV,$1.dtype,$1.place,$3.place);
                                                     }
                                                 }
             |
@@ -508,132 +508,117 @@ EXPRESSION: LPAREN_TOK EXPRESSION RPAREN_TOK    { $$.dtype=$2.dtype;
                                                         sprintf(buff,": Type error in expression");
                                                         yyerror(buff);
                                                     } else{
-                                                        char* temp=newTemp();
-                                                        new_temp_index+=1;
-                                                        $$.place=strdup(temp);
-
-                                                        char buff[40];
-                                                        sprintf(buff,"%s = %s %% %s\n",$$.place,$1.place,$3.place);
-                                                        generate(interm_label,buff);
-                                                        strcpy(expr_var,$$.place);
-                                                        interm_label+=1;
+                                                        $$.place=generateTemp(QUAD_MOD,$1.dtype,$1.place,$3.place);
                                                     }
                                                 }
             |
             MINUS_TOK EXPRESSION        { $$.dtype=$2.dtype;
-                                            char* temp=newTemp();
-                                            new_temp_index+=1;
-                                            $$.place=strdup(temp);
-
-                                            char buff[40];
-                                            sprintf(buff,"%s = - %s\n",$$.place,$2.place);
-                                            generate(interm_label,buff);
-                                            strcpy(expr_var,$$.place);
-                                            interm_label+=1;
+                                            $$.place=generateTemp(QUAD_NEG,$2.dtype,$2.place,NO_OPERAND);
                                         }
+            ;
+PRIMARY:    LPAREN_TOK EXPRESSION RPAREN_TOK    { $$.dtype=$2.dtype;
+                                                    $$.place=$2.place;
+                                                }
             |
-            INT_CONST_TOK       { $$.dtype=0;
-                                    char temp_place[10];
-                                    sprintf(temp_place,"%d",$1);
-                                    $$.place=strdup(temp_place);
+            INT_CONST_TOK       { $$.dtype=TYPE_INT;
+                                    $$.place=quadInt(&code,$1);
                                 }
             |
-            FLOAT_CONST_TOK     { $$.dtype=1;
-                                    char temp_place[10];
-                                    sprintf(temp_place,"%.2f",$1);
-                                    $$.place=strdup(temp_place);
+            FLOAT_CONST_TOK     { $$.dtype=TYPE_FLOAT;
+                                    $$.place=quadFloat(&code,$1);
                                 }
             |
             IDENTIFIER_TOK      { if(!contains($1)){
                                         char buff[40];
-                                        sprintf(buff,": Undefined identifier %s",$1);
+                                        snprintf(buff,sizeof(buff),": Undefined identifier %s",atomName($1));
                                         yyerror(buff);
+                                        $$.place=quadVar($1);
                                     } else{
                                         $$.dtype=getDtype($1);
-                                        $$.place=strdup($1);
+                                        $$.place=quadVar($1);
                                 }}
             ;
 
-COND:   IF_TOK {temp_label=interm_label;}
-        LPAREN_TOK COND_PART RPAREN_TOK {
-                                                char* temp=newTemp();
-                                                new_temp_index+=1;
-
-                                                char buff[40];
-                                                sprintf(buff,"%s = not %s\n",temp,expr_var);
-                                                generate(interm_label,buff);
-                                                interm_label+=1;
-                                                backpatch_label=interm_label;
-                                                strcpy(temp_var,temp);
-                                                interm_label+=1;
+COND:   IF_TOK LPAREN_TOK COND_PART RPAREN_TOK {$<nextlist>$=bodyIfTrue($3);}
+        INNER_BODY ELSE_OPTN    {
+                                        // backpatching: with an else part, the
+                                        // jumps on false go to it, past its goto
+                                        if($7==NO_JUMPS){
+                                            quadBackpatch(&code,$<nextlist>5,code.count);
+                                        } else{
+                                            quadBackpatch(&code,$<nextlist>5,$7+1);
+                                            quadBackpatch(&code,$7,code.count);
                                         }
-        INNER_BODY ELSE_OPTN
+                                }
         ;
-ELSE_OPTN:      %prec LOWER_THAN_ELSE   {
-                                                // backpatching
-                                                char buff[40];
-                                                sprintf(buff,"if %s goto %d\n",temp_var,interm_label);
-                                                generate(backpatch_label,buff);
-                                        }
+ELSE_OPTN:      %prec LOWER_THAN_ELSE   {$$=NO_JUMPS;}
                 |
                 ELSE_PART
                 ;
-ELSE_PART:  ELSE_TOK    {
-                                // backpatching
-                                char buff[40];
-                                sprintf(buff,"if %s goto %d\n",temp_var,interm_label+1);
-                                generate(backpatch_label,buff);
-                                backpatch_label=interm_label;
-                                interm_label+=1;
-                        }
-            INNER_BODY  {
-                                // backpatching
-                                char buff[40];
-                                sprintf(buff,"goto %d\n",interm_label);
-                                generate(backpatch_label,buff);
-                        }
+ELSE_PART:  ELSE_TOK    {$<nextlist>$=quadJump(&code,QUAD_GOTO,NO_OPERAND);}
+            INNER_BODY  {$$=$<nextlist>2;}
             ;
 
-ITER:   WHILE_TOK {temp_label=interm_label;}
-        LPAREN_TOK COND_PART RPAREN_TOK {
-                                                char* temp=newTemp();
-                                                new_temp_index+=1;
-
-                                                char buff[40];
-                                                sprintf(buff,"%s = not %s\n",temp,expr_var);
-                                                generate(interm_label,buff);
-                                                interm_label+=1;
-                                                backpatch_label=interm_label;
-                                                strcpy(temp_var,temp);
-                                                interm_label+=1;
-                                        }
+ITER:   WHILE_TOK {$<label>$=code.count;}
+        LPAREN_TOK COND_PART RPAREN_TOK {$<nextlist>$=bodyIfTrue($4);}
         INNER_BODY {
-                        char buff[40];
-                        sprintf(buff,"goto %d\n",temp_label);
-                        generate(interm_label,buff);
-                        interm_label+=1;
+                        generate(QUAD_GOTO,quadLabel($<label>2),NO_OPERAND,NO_OPERAND);
 
                         // backpatching
-                        sprintf(buff,"if %s goto %d\n",temp_var,interm_label);
-                        generate(backpatch_label,buff);
+                        quadBackpatch(&code,$<nextlist>6,code.count);
                     }
         ;
-INNER_BODY:     BODY_START STMT { deleteSymbolsOfScope(scope);
-                                    scope-=1;}
+INNER_BODY:     BODY_START STMT {exitScope();}
                 |
                 BLK
                 ;
-BODY_START:             {scope+=1;}
+BODY_START:             {enterScope();}
                 ;
 
-COND_PART:  EXPRESSION
+COND_PART:  EXPRESSION      {$$=condition($1.place);}
+            |
+            ASSIGN          {$$=condition($1.place);}
+            |
+            COND_PART OR_TOK    {
+                                        // true jumps of the left side go past the
+                                        // right one; false ones fall through to it
+                                        $<cond>$=$1;
+                                        jumpIf(&$<cond>$,1);
+                                        quadBackpatch(&code,$<cond>$.falselist,code.count);
+                                }
+            COND_PART           {
+                                        $$=$4;
+                                        $$.truelist=quadMerge(&code,$<cond>3.truelist,$4.truelist);
+                                }
+            |
+            COND_PART AND_TOK   {
+                                        $<cond>$=$1;
+                                        jumpIf(&$<cond>$,0);
+                                        quadBackpatch(&code,$<cond>$.truelist,code.count);
+                                }
+            COND_PART           {
+                                        $$=$4;
+                                        $$.falselist=quadMerge(&code,$<cond>3.falselist,$4.falselist);
+                                }
             |
-            ASSIGN
+            NEGATION
+            ;
+// ! applies to a variable, a constant or a parenthesised expression only:
+// C reads !a + b as (!a) + b, a value no condition here computes
+NEGATION:   NOT_TOK PRIMARY     {
+                                        $$=condition($2.place);
+                                        $$.negated=1;
+                                }
+            |
+            NOT_TOK NEGATION    {
+                                        $$=$2;
+                                        $$.negated=!$2.negated;
+                                }
             ;
 
 FN_CALL:    IDENTIFIER_TOK ASSIGN_TOK FN_SIGN   { if(!contains($1)){
                                                         char buff[40];
-                                                        sprintf(buff,": Undefined identifier %s",$1);
+                                                        snprintf(buff,sizeof(buff),": Undefined identifier %s",atomName($1));
                                                         yyerror(buff);
                                                     } }
             |
@@ -646,11 +631,11 @@ OPTIONS:    PARAMS
             ;
 PARAMS: PARAM
         |
-        PARAM COMMA_TOK PARAMS
+        PARAMS COMMA_TOK PARAM
         ;
 PARAM:  IDENTIFIER_TOK  { if(!contains($1)){
                                 char buff[40];
-                                sprintf(buff,": Undefined identifier %s",$1);
+                                snprintf(buff,sizeof(buff),": Undefined identifier %s",atomName($1));
                                 yyerror(buff);
                             } }
         |
@@ -659,10 +644,10 @@ PARAM:  IDENTIFIER_TOK  { if(!contains($1)){
         FLOAT_CONST_TOK
         ;
 
-US_DEF_FNS:     US_DEF_FN US_DEF_FNS
+US_DEF_FNS:     US_DEF_FNS US_DEF_FN
                 |
                 ;
-US_DEF_FN:      DATATYPE FN_NAME LPAREN_TOK OPTIONS_FORMAL RPAREN_TOK BLK        {printf("\nSyntax of user defined function is correct");}
+US_DEF_FN:      DATATYPE FN_NAME LPAREN_TOK OPTIONS_FORMAL RPAREN_TOK BLK        {printf("\nSyntax of user defined function is correct"); endFunction($2);}
                 ;
 FN_NAME:        IDENTIFIER_TOK
                 ;
@@ -671,34 +656,59 @@ OPTIONS_FORMAL: PARAMS_FORMAL
                 ;
 PARAMS_FORMAL:  PARAM_FORMAL
                 |
-                PARAM_FORMAL COMMA_TOK PARAMS_FORMAL
+                PARAMS_FORMAL COMMA_TOK PARAM_FORMAL
                 ;
-PARAM_FORMAL:   DATATYPE IDENTIFIER_TOK { int type = existsInSameScope($2);
+PARAM_FORMAL:   DATATYPE IDENTIFIER_TOK { int type = existsInSameScope($2,dtype);
                                             if(type==1){
                                                 char buff[50];
-                                                sprintf(buff,": Multiple definitions of the identifier %s",$2);
+                                                snprintf(buff,sizeof(buff),": Multiple definitions of the identifier %s",atomName($2));
                                                 yyerror(buff);
                                             } else if(type==2){
                                                 char buff[50];
-                                                sprintf(buff,": Conflicting types for the identifier %s",$2);
+                                                snprintf(buff,sizeof(buff),": Conflicting types for the identifier %s",atomName($2));
                                                 yyerror(buff);
                                             } else{
-                                                add($2);
+                                                add($2,dtype);
                                         } }
 %%
 
 
-int main(){
-    yyin=fopen("sample.c","r");
+// With -s, statistics of the symbol table are printed to stderr
+int main(int argc,char* argv[]){
+    int arg=1;
+    if(argc>arg && strcmp(argv[arg],"-s")==0){
+        stats=&table_stats;
+        statsInit(stats);
+        arg+=1;
+    }
+    // The program is read from sample.c unless another file is named
+    const char* path=argc>arg?argv[arg]:"sample.c";
+    yyin=fopen(path,"r");
+    if(yyin==NULL){
+        fprintf(stderr,"cannot open %s\n",path);
+        return 1;
+    }
     interm_file=fopen("intermediate_code.txt","w");
     init();
-    if(yyparse()==0){
+    quadInit(&code);
+    tempPoolInit(&temps);
+    if(yyparse()==0 && syntax_errors==0){
+        size_t eliminated=valueNumber(&code);
+        size_t dead=removeDeadCode(&code);
         writeIntermCode();
+        printTemporaries();
+        printf("\nQuads removed by value numbering: %zu",eliminated);
+        printf("\nQuads removed by copy propagation and dead code elimination: %zu",dead);
         printf("\nParsed successfully.\n");
     }
+    if(stats!=NULL){
+        statsPrint(stats,"group",stderr);
+    }
     fclose(yyin);
     fclose(interm_file);
     freeAll();
+    quadFree(&code);
+    tempPoolFree(&temps);
     return 0;
 }
 
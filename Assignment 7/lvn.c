@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lvn.h"
+
+#define INITIAL_CAPACITY 64
+#define NO_HOLDER UINT32_MAX
+
+// Tags of the keys of the table: of a name, a constant or an operator
+// applied to value numbers
+enum { KEY_NAME, KEY_CONSTANT, KEY_EXPRESSION };
+
+typedef struct Entry
+{
+  uint32_t key[4];
+  uint32_t value;
+  uint32_t block;    // the entry is empty unless this is the current block
+} Entry;
+
+// A name that held a value when it was recorded; it may hold another by now
+typedef struct Holder
+{
+  Operand name;
+  uint32_t next;
+} Holder;
+
+typedef struct Numbering
+{
+  Entry* entries;
+  size_t capacity;
+  size_t used;
+  uint32_t block;
+
+  uint32_t* holders;  // first Holder of each value number
+  uint32_t value_count;
+  size_t value_capacity;
+
+  Holder* nodes;
+  uint32_t node_count;
+  size_t node_capacity;
+} Numbering;
+
+static uint64_t hash(const uint32_t* key)
+{
+  uint64_t h = ((uint64_t) key[0] << 32 | key[1]) * 0x9E3779B97F4A7C15ull;
+  h ^= ((uint64_t) key[2] << 32 | key[3]) * 0xC2B2AE3D27D4EB4Full;
+  return h ^ (h >> 29);
+}
+
+static Entry* slot(Numbering* numbering, const uint32_t* key)
+{
+  size_t i = hash(key) & (numbering->capacity - 1);
+  while (numbering->entries[i].block == numbering->block && memcmp(numbering->entries[i].key, key, sizeof(numbering->entries[i].key)) != 0)
+    i = (i + 1) & (numbering->capacity - 1);
+  return &numbering->entries[i];
+}
+
+static uint32_t* find(Numbering* numbering, const uint32_t* key)
+{
+  Entry* entry = slot(numbering, key);
+  return entry->block == numbering->block ? &entry->value : NULL;
+}
+
+static void put(Numbering* numbering, const uint32_t* key, uint32_t value)
+{
+  if (2 * (numbering->used + 1) > numbering->capacity)
+  {
+    Entry* old = numbering->entries;
+    size_t old_capacity = numbering->capacity;
+
+    numbering->capacity = 2 * old_capacity;
+    numbering->entries = (Entry*) calloc(numbering->capacity, sizeof(Entry));
+    for (size_t i = 0; i < old_capacity; i++)
+      if (old[i].block == numbering->block)
+        *slot(numbering, old[i].key) = old[i];
+    free(old);
+  }
+
+  Entry* entry = slot(numbering, key);
+  if (entry->block != numbering->block)
+  {
+    numbering->used++;
+    memcpy(entry->key, key, sizeof(entry->key));
+    entry->block = numbering->block;
+  }
+  entry->value = value;
+}
+
+static uint32_t newValue(Numbering* numbering)
+{
+  if (numbering->value_count == numbering->value_capacity)
+  {
+    numbering->value_capacity = numbering->value_capacity ? 2 * numbering->value_capacity : INITIAL_CAPACITY;
+    numbering->holders = (uint32_t*) realloc(numbering->holders, numbering->value_capacity * sizeof(uint32_t));
+  }
+  numbering->holders[numbering->value_count] = NO_HOLDER;
+  return numbering->value_count++;
+}
+
+static void nameKey(Operand name, uint32_t* key)
+{
+  key[0] = KEY_NAME;
+  key[1] = name.kind;
+  key[2] = name.index;
+  key[3] = 0;
+}
+
+// Record that name now holds value
+static void assign(Numbering* numbering, Operand name, uint32_t value)
+{
+  uint32_t key[4];
+  nameKey(name, key);
+  put(numbering, key, value);
+
+  if (numbering->node_count == numbering->node_capacity)
+  {
+    numbering->node_capacity = numbering->node_capacity ? 2 * numbering->node_capacity : INITIAL_CAPACITY;
+    numbering->nodes = (Holder*) realloc(numbering->nodes, numbering->node_capacity * sizeof(Holder));
+  }
+  numbering->nodes[numbering->node_count].name = name;
+  numbering->nodes[numbering->node_count].next = numbering->holders[value];
+  numbering->holders[value] = numbering->node_count++;
+}
+
+// Whether name still holds value
+static int holds(Numbering* numbering, Operand name, uint32_t value)
+{
+  uint32_t key[4];
+  nameKey(name, key);
+  uint32_t* held = find(numbering, key);
+  return held != NULL && *held == value;
+}
+
+static uint32_t valueOf(Numbering* numbering, const QuadList* code, Operand operand)
+{
+  uint32_t key[4];
+  if (operand.kind == OPERAND_CONST)
+  {
+    // equal constants are one value, whichever entry of the constants
+    const Constant* constant = &code->constants[operand.index];
+    key[0] = KEY_CONSTANT;
+    key[1] = constant->dtype;
+    memcpy(&key[2], &constant->value, sizeof(uint32_t));
+    key[3] = 0;
+  }
+  else
+    nameKey(operand, key);
+
+  uint32_t* value = find(numbering, key);
+  if (value != NULL)
+    return *value;
+
+  uint32_t fresh = newValue(numbering);
+  if (operand.kind == OPERAND_CONST)
+    put(numbering, key, fresh);
+  else
+    assign(numbering, operand, fresh);
+  return fresh;
+}
+
+// Make the quad after quads[i] that reads its result read holder instead,
+// unless one of them is set first; returns whether it did
+static int replaceUse(QuadList* code, size_t i, size_t end, Operand holder)
+{
+  Operand result = code->quads[i].result;
+  for (size_t j = i + 1; j < end; j++)
+  {
+    Quad* quad = &code->quads[j];
+    if (quadReads(quad, result))
+    {
+      if (quad->arg1.kind == result.kind && quad->arg1.index == result.index)
+        quad->arg1 = holder;
+      if (quad->arg2.kind == result.kind && quad->arg2.index == result.index)
+        quad->arg2 = holder;
+      return 1;
+    }
+    if (quadSets(quad, result) || quadSets(quad, holder))
+      return 0;
+  }
+  return 0;
+}
+
+// Number the values of the blocks quads[start..end-1], marking the quads
+// that recompute one
+static size_t numberBlock(Numbering* numbering, QuadList* code, size_t start, size_t end, uint8_t* removed)
+{
+  size_t eliminated = 0;
+  numbering->block++;
+  numbering->used = 0;
+  numbering->value_count = 0;
+  numbering->node_count = 0;
+
+  for (size_t i = start; i < end; i++)
+  {
+    Quad* quad = &code->quads[i];
+    if (quadIsJump(quad))
+      continue;
+
+    if (quad->op == QUAD_COPY)
+    {
+      assign(numbering, quad->result, valueOf(numbering, code, quad->arg1));
+      continue;
+    }
+
+    uint32_t key[4];
+    key[0] = KEY_EXPRESSION;
+    key[1] = quad->op;
+    key[2] = valueOf(numbering, code, quad->arg1);
+    key[3] = quad->op == QUAD_NEG ? 0 : valueOf(numbering, code, quad->arg2);
+    if ((quad->op == QUAD_ADD || quad->op == QUAD_MUL) && key[2] > key[3])
+    {
+      uint32_t swap = key[2];
+      key[2] = key[3];
+      key[3] = swap;
+    }
+
+    uint32_t* found = find(numbering, key);
+    if (found != NULL)
+    {
+      uint32_t value = *found;
+      for (uint32_t h = numbering->holders[value]; h != NO_HOLDER; h = numbering->nodes[h].next)
+      {
+        Operand holder = numbering->nodes[h].name;
+        if (!holds(numbering, holder, value))
+          continue;
+
+        // the result holds the value already, or its use can read the holder
+        if ((holder.kind == quad->result.kind && holder.index == quad->result.index) || replaceUse(code, i, end, holder))
+        {
+          removed[i] = 1;
+          eliminated++;
+          break;
+        }
+      }
+      if (removed[i])
+        continue;
+    }
+
+    uint32_t value = found != NULL ? *found : newValue(numbering);
+    if (found == NULL)
+      put(numbering, key, value);
+    assign(numbering, quad->result, value);
+  }
+  return eliminated;
+}
+
+// Mark the quads that start a block numbered afresh: those jumped to and
+// those after a goto. A block after a conditional jump that nothing
+// jumps to is only entered from the one before, and is numbered on
+static void markStarts(const QuadList* code, uint8_t* start)
+{
+  memset(start, 0, code->count);
+  for (size_t i = 0; i < code->count; i++)
+  {
+    const Quad* quad = &code->quads[i];
+    if (!quadIsJump(quad))
+      continue;
+    if (quad->result.kind == OPERAND_LABEL && quad->result.index < code->count)
+      start[quad->result.index] = 1;
+    if (quad->op == QUAD_GOTO && i + 1 < code->count)
+      start[i + 1] = 1;
+  }
+}
+
+size_t valueNumber(QuadList* code)
+{
+  if (code->count == 0)
+    return 0;
+
+  uint8_t* leader = (uint8_t*) malloc(code->count);
+  uint8_t* removed = (uint8_t*) calloc(code->count, 1);
+  markStarts(code, leader);
+
+  Numbering numbering;
+  memset(&numbering, 0, sizeof(numbering));
+  numbering.capacity = INITIAL_CAPACITY;
+  numbering.entries = (Entry*) calloc(numbering.capacity, sizeof(Entry));
+
+  size_t eliminated = 0;
+  size_t start = 0;
+  for (size_t i = 1; i <= code->count; i++)
+    if (i == code->count || leader[i])
+    {
+      eliminated += numberBlock(&numbering, code, start, i, removed);
+      start = i;
+    }
+
+  if (eliminated > 0)
+    quadRemove(code, removed);
+
+  free(numbering.entries);
+  free(numbering.holders);
+  free(numbering.nodes);
+  free(leader);
+  free(removed);
+  return eliminated;
+}
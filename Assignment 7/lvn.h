@@ -0,0 +1,26 @@
+#ifndef LVN_H
+#define LVN_H
+
+#include "quad.h"
+
+/*
+  Local value numbering over the extended basic blocks of the code: a
+  block and the blocks it falls through to that nothing jumps to, as the
+  body of an if or a while after its condition.
+
+  Within these, every value computed or copied gets a number, and so
+  does every operator applied to numbered values, with the operands of +
+  and * in order so that a + b and b + a are the same. A quad computing a
+  value that a variable or temporary still holds is removed, and the one
+  quad that reads its result reads that name instead, so "t1 = a - b;
+  c = t1; ... t1 = a - b; ifFalse t1 goto L" tests c.
+
+  Nothing is assumed where a jump comes in, as it may bring any values.
+  The tables are emptied there by moving on to a new block number, not
+  by clearing them.
+*/
+
+// Remove the quads recomputing a value; returns how many
+size_t valueNumber(QuadList* code);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+  Reduction profiler for an instrumentation build of the parser. The sed
+  command in README.md patches two calls into the reduction code yacc
+  generates: profileReduce() just before the action of a rule runs, and
+  profileActionEnd() just after it. Reductions are counted per rule and
+  per parser state, and the time between the two calls is summed per
+  rule, in TSC cycles where the CPU has them and in nanoseconds otherwise.
+
+  When the program exits, the rules sorted by the time of their actions
+  and the states sorted by their reductions are written to PROFILE_FILE.
+  Rules and states are numbered as in y.output.
+*/
+
+#define PROFILE_FILE "parse_profile.txt"
+
+// The parser reduces by rule in state; lhs and line name the rule
+void profileReduce(int rule, int state, const char* lhs, int line);
+
+// The action of rule has run
+void profileActionEnd(int rule);
+
+#endif
@@ -0,0 +1,355 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "quad.h"
+
+#define INITIAL_CAPACITY 64
+
+const Operand NO_OPERAND = { OPERAND_NONE, 0 };
+
+void quadInit(QuadList* code)
+{
+  code->quads = NULL;
+  code->count = code->capacity = 0;
+  code->constants = NULL;
+  code->constant_count = code->constant_capacity = 0;
+  code->functions = NULL;
+  code->function_count = code->function_capacity = 0;
+}
+
+void quadFree(QuadList* code)
+{
+  free(code->quads);
+  free(code->constants);
+  free(code->functions);
+  quadInit(code);
+}
+
+Operand quadVar(Atom name)
+{
+  Operand operand = { OPERAND_VAR, name };
+  return operand;
+}
+
+Operand quadTemp(uint32_t n)
+{
+  Operand operand = { OPERAND_TEMP, n };
+  return operand;
+}
+
+static Operand addConstant(QuadList* code, Constant constant)
+{
+  if (code->constant_count == code->constant_capacity)
+  {
+    code->constant_capacity = code->constant_capacity ? 2 * code->constant_capacity : INITIAL_CAPACITY;
+    code->constants = (Constant*) realloc(code->constants, code->constant_capacity * sizeof(Constant));
+  }
+
+  Operand operand = { OPERAND_CONST, (uint32_t) code->constant_count };
+  code->constants[code->constant_count++] = constant;
+  return operand;
+}
+
+Operand quadInt(QuadList* code, int value)
+{
+  Constant constant;
+  constant.dtype = TYPE_INT;
+  constant.value.i = value;
+  return addConstant(code, constant);
+}
+
+Operand quadFloat(QuadList* code, float value)
+{
+  Constant constant;
+  constant.dtype = TYPE_FLOAT;
+  constant.value.f = value;
+  return addConstant(code, constant);
+}
+
+Operand quadLabel(size_t quad)
+{
+  Operand operand = { OPERAND_LABEL, (uint32_t) quad };
+  return operand;
+}
+
+size_t quadEmit(QuadList* code, QuadOp op, Operand result, Operand arg1, Operand arg2)
+{
+  if (code->count == code->capacity)
+  {
+    code->capacity = code->capacity ? 2 * code->capacity : INITIAL_CAPACITY;
+    code->quads = (Quad*) realloc(code->quads, code->capacity * sizeof(Quad));
+  }
+
+  Quad* quad = &code->quads[code->count];
+  quad->op = op;
+  quad->result = result;
+  quad->arg1 = arg1;
+  quad->arg2 = arg2;
+  return code->count++;
+}
+
+void quadEndFunction(QuadList* code, Atom name)
+{
+  if (code->function_count == code->function_capacity)
+  {
+    code->function_capacity = code->function_capacity ? 2 * code->function_capacity : INITIAL_CAPACITY;
+    code->functions = (FunctionCode*) realloc(code->functions, code->function_capacity * sizeof(FunctionCode));
+  }
+
+  code->functions[code->function_count].name = name;
+  code->functions[code->function_count++].end = code->count;
+}
+
+uint32_t quadTempsUsed(const QuadList* code, size_t begin, size_t end)
+{
+  uint32_t highest = 0;
+  for (size_t i = begin; i < end; i++)
+  {
+    const Operand* operands[3] = { &code->quads[i].result, &code->quads[i].arg1, &code->quads[i].arg2 };
+    for (int j = 0; j < 3; j++)
+      if (operands[j]->kind == OPERAND_TEMP && operands[j]->index > highest)
+        highest = operands[j]->index;
+  }
+
+  // the numbers in use may have gaps once quads are removed
+  uint8_t* used = (uint8_t*) calloc(highest + 1, 1);
+  uint32_t count = 0;
+  for (size_t i = begin; i < end; i++)
+  {
+    const Operand* operands[3] = { &code->quads[i].result, &code->quads[i].arg1, &code->quads[i].arg2 };
+    for (int j = 0; j < 3; j++)
+      if (operands[j]->kind == OPERAND_TEMP && !used[operands[j]->index])
+      {
+        used[operands[j]->index] = 1;
+        count++;
+      }
+  }
+  free(used);
+  return count;
+}
+
+void tempPoolInit(TempPool* pool)
+{
+  pool->free = NULL;
+  pool->free_count = pool->free_capacity = 0;
+  pool->busy = NULL;
+  pool->defined = NULL;
+  pool->count = 0;
+}
+
+void tempPoolFree(TempPool* pool)
+{
+  free(pool->free);
+  free(pool->busy);
+  free(pool->defined);
+  tempPoolInit(pool);
+}
+
+void tempPoolReset(TempPool* pool)
+{
+  pool->free_count = 0;
+  pool->count = 0;
+}
+
+Operand tempTake(TempPool* pool, size_t quad)
+{
+  uint32_t n;
+  if (pool->free_count > 0)
+    n = pool->free[--pool->free_count];
+  else
+  {
+    // temporaries are numbered from 1; every slot up to the capacity of
+    // free is in busy and defined
+    n = ++pool->count;
+    if (n >= pool->free_capacity)
+    {
+      pool->free_capacity = pool->free_capacity ? 2 * pool->free_capacity : INITIAL_CAPACITY;
+      pool->free = (uint32_t*) realloc(pool->free, pool->free_capacity * sizeof(uint32_t));
+      pool->busy = (uint8_t*) realloc(pool->busy, pool->free_capacity);
+      pool->defined = (size_t*) realloc(pool->defined, pool->free_capacity * sizeof(size_t));
+    }
+  }
+
+  pool->busy[n] = 1;
+  pool->defined[n] = quad;
+  return quadTemp(n);
+}
+
+void tempRelease(TempPool* pool, Operand operand)
+{
+  // after an error an operand may be released twice, or not be set at all
+  if (operand.kind != OPERAND_TEMP || operand.index == 0 || operand.index > pool->count || !pool->busy[operand.index])
+    return;
+
+  pool->busy[operand.index] = 0;
+  pool->free[pool->free_count++] = operand.index;
+}
+
+// The target of a jump in a list is the next jump, or NO_JUMPS
+static JumpList nextJump(const QuadList* code, JumpList jump)
+{
+  return code->quads[jump].result.index;
+}
+
+JumpList quadJump(QuadList* code, QuadOp op, Operand test)
+{
+  Operand end = { OPERAND_NONE, NO_JUMPS };
+  return (JumpList) quadEmit(code, op, end, test, NO_OPERAND);
+}
+
+JumpList quadMerge(QuadList* code, JumpList a, JumpList b)
+{
+  if (a == NO_JUMPS)
+    return b;
+
+  JumpList last = a;
+  while (nextJump(code, last) != NO_JUMPS)
+    last = nextJump(code, last);
+  code->quads[last].result.index = b;
+  return a;
+}
+
+void quadBackpatch(QuadList* code, JumpList list, size_t target)
+{
+  while (list != NO_JUMPS)
+  {
+    JumpList next = nextJump(code, list);
+    code->quads[list].result = quadLabel(target);
+    list = next;
+  }
+}
+
+static int sameOperand(Operand a, Operand b)
+{
+  return a.kind == b.kind && a.index == b.index;
+}
+
+int quadIsJump(const Quad* quad)
+{
+  return quad->op == QUAD_IF || quad->op == QUAD_IFFALSE || quad->op == QUAD_GOTO;
+}
+
+int quadReads(const Quad* quad, Operand operand)
+{
+  return sameOperand(quad->arg1, operand) || sameOperand(quad->arg2, operand);
+}
+
+int quadSets(const Quad* quad, Operand operand)
+{
+  return !quadIsJump(quad) && sameOperand(quad->result, operand);
+}
+
+void quadLeaders(const QuadList* code, uint8_t* leader)
+{
+  memset(leader, 0, code->count);
+  if (code->count > 0)
+    leader[0] = 1;
+
+  for (size_t i = 0; i < code->count; i++)
+  {
+    const Quad* quad = &code->quads[i];
+    if (!quadIsJump(quad))
+      continue;
+    if (quad->result.kind == OPERAND_LABEL && quad->result.index < code->count)
+      leader[quad->result.index] = 1;
+    if (i + 1 < code->count)
+      leader[i + 1] = 1;
+  }
+}
+
+size_t quadRemove(QuadList* code, const uint8_t* removed)
+{
+  // where each quad goes, and where a jump to the end goes
+  size_t* moved = (size_t*) malloc((code->count + 1) * sizeof(size_t));
+  size_t kept = 0;
+  for (size_t i = 0; i < code->count; i++)
+  {
+    moved[i] = kept;
+    if (!removed[i])
+      code->quads[kept++] = code->quads[i];
+  }
+  moved[code->count] = kept;
+
+  for (size_t i = 0; i < kept; i++)
+    if (quadIsJump(&code->quads[i]) && code->quads[i].result.kind == OPERAND_LABEL)
+      code->quads[i].result.index = (uint32_t) moved[code->quads[i].result.index];
+  for (size_t f = 0; f < code->function_count; f++)
+    code->functions[f].end = moved[code->functions[f].end];
+
+  size_t count = code->count - kept;
+  code->count = kept;
+  free(moved);
+  return count;
+}
+
+void quadPrintOperand(const QuadList* code, Operand operand, FILE* out)
+{
+  switch (operand.kind)
+  {
+    case OPERAND_VAR:
+      fputs(atomName(operand.index), out);
+      break;
+    case OPERAND_TEMP:
+      fprintf(out, "t%u", operand.index);
+      break;
+    case OPERAND_CONST:
+    {
+      const Constant* constant = &code->constants[operand.index];
+      if (constant->dtype == TYPE_FLOAT)
+        fprintf(out, "%.2f", constant->value.f);
+      else
+        fprintf(out, "%d", constant->value.i);
+      break;
+    }
+    case OPERAND_LABEL:
+      fprintf(out, "%u", operand.index);
+      break;
+    default:
+      // a jump not patched yet
+      fputs("?", out);
+  }
+}
+
+void quadPrint(const QuadList* code, const Quad* quad, FILE* out)
+{
+  static const char* binary[] = { [QUAD_ADD] = "+", [QUAD_SUB] = "-", [QUAD_MUL] = "*", [QUAD_DIV] = "/", [QUAD_MOD] = "%" };
+
+  switch (quad->op)
+  {
+    case QUAD_IF:
+    case QUAD_IFFALSE:
+      fputs(quad->op == QUAD_IF ? "if " : "ifFalse ", out);
+      quadPrintOperand(code, quad->arg1, out);
+      fputs(" goto ", out);
+      quadPrintOperand(code, quad->result, out);
+      return;
+    case QUAD_GOTO:
+      fputs("goto ", out);
+      quadPrintOperand(code, quad->result, out);
+      return;
+    default:
+      break;
+  }
+
+  quadPrintOperand(code, quad->result, out);
+  fputs(" = ", out);
+  if (quad->op == QUAD_NEG)
+    fputs("- ", out);
+
+  quadPrintOperand(code, quad->arg1, out);
+  if (quad->op <= QUAD_MOD)
+  {
+    fprintf(out, " %s ", binary[quad->op]);
+    quadPrintOperand(code, quad->arg2, out);
+  }
+}
+
+void quadDump(const QuadList* code, FILE* out)
+{
+  for (size_t i = 0; i < code->count; i++)
+  {
+    fprintf(out, "%zu: ", i);
+    quadPrint(code, &code->quads[i], out);
+    fputc('\n', out);
+  }
+}
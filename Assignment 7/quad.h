@@ -0,0 +1,188 @@
+#ifndef QUAD_H
+#define QUAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "intern.h"
+#include "types.h"
+
+/*
+  Intermediate code as quadruples.
+
+  A quad is a fixed-size record of an operator and up to three operands,
+  and the code of a translation unit is a growable vector of them, so it
+  has no limit on its length. An operand is tagged with what it names and
+  holds an index: the Atom of a variable, the number of a temporary, an
+  entry of the constants of the code, or the number of the quad a jump
+  goes to. Passes over the code compare and rewrite those integers; quads
+  are only turned into text when the code is dumped.
+
+  Jumps whose target is not known yet are kept in JumpLists, as in the
+  backpatching of Aho et al. A list is threaded through the jumps in it:
+  the target of each holds the number of the next one until the list is
+  backpatched, so a list is only the number of its first jump and costs
+  no memory of its own.
+*/
+typedef enum OperandKind
+{
+  OPERAND_NONE,
+  OPERAND_VAR,    // index: Atom of the variable
+  OPERAND_TEMP,   // index: n of temporary tn
+  OPERAND_CONST,  // index: into the constants
+  OPERAND_LABEL   // index: number of a quad
+} OperandKind;
+
+typedef struct Operand
+{
+  uint32_t kind;
+  uint32_t index;
+} Operand;
+
+typedef enum QuadOp
+{
+  QUAD_ADD,      // result = arg1 + arg2
+  QUAD_SUB,      // result = arg1 - arg2
+  QUAD_MUL,      // result = arg1 * arg2
+  QUAD_DIV,      // result = arg1 / arg2
+  QUAD_MOD,      // result = arg1 % arg2
+  QUAD_NEG,      // result = - arg1
+  QUAD_COPY,     // result = arg1
+  QUAD_IF,       // if arg1 goto result
+  QUAD_IFFALSE,  // ifFalse arg1 goto result
+  QUAD_GOTO      // goto result
+} QuadOp;
+
+typedef struct Quad
+{
+  QuadOp op;
+  Operand result;
+  Operand arg1;
+  Operand arg2;
+} Quad;
+
+// Value of a constant operand, of type int or float
+typedef struct Constant
+{
+  TypeId dtype;
+  union
+  {
+    int i;
+    float f;
+  } value;
+} Constant;
+
+// The quads of a function, which start where those of the one before end
+typedef struct FunctionCode
+{
+  Atom name;
+  size_t end;          // one past its last quad
+} FunctionCode;
+
+typedef struct QuadList
+{
+  Quad* quads;
+  size_t count;
+  size_t capacity;
+  Constant* constants;
+  size_t constant_count;
+  size_t constant_capacity;
+  FunctionCode* functions;
+  size_t function_count;
+  size_t function_capacity;
+} QuadList;
+
+void quadInit(QuadList* code);
+void quadFree(QuadList* code);
+
+// Operands
+extern const Operand NO_OPERAND;
+Operand quadVar(Atom name);
+Operand quadTemp(uint32_t n);
+Operand quadInt(QuadList* code, int value);
+Operand quadFloat(QuadList* code, float value);
+Operand quadLabel(size_t quad);
+
+// Append a quad; returns its number
+size_t quadEmit(QuadList* code, QuadOp op, Operand result, Operand arg1, Operand arg2);
+
+// End the code of function name with the last quad emitted
+void quadEndFunction(QuadList* code, Atom name);
+
+// Number of temporaries quads[begin..end-1] use
+uint32_t quadTempsUsed(const QuadList* code, size_t begin, size_t end);
+
+// Jumps still to be given their target, see above
+typedef uint32_t JumpList;
+#define NO_JUMPS UINT32_MAX
+
+// Append a jump whose target is yet to be backpatched; returns the list of
+// just that jump
+JumpList quadJump(QuadList* code, QuadOp op, Operand test);
+
+// The jumps of both lists
+JumpList quadMerge(QuadList* code, JumpList a, JumpList b);
+
+// Make every jump of list go to target
+void quadBackpatch(QuadList* code, JumpList list, size_t target);
+
+// Temporaries of a function. A temporary is used exactly once, so it is
+// given back to the pool as soon as that use is generated, and the next
+// one taken reuses it: a function needs as many as its deepest expression
+// holds at once, not one per expression
+typedef struct TempPool
+{
+  uint32_t* free;      // temporaries given back, taken last one first
+  size_t free_count;
+  size_t free_capacity;
+  uint8_t* busy;       // indexed by n of tn, whether it holds a value
+  size_t* defined;     // and the quad that set it, while it does
+  uint32_t count;      // temporaries t1 to tcount made so far
+} TempPool;
+
+void tempPoolInit(TempPool* pool);
+void tempPoolFree(TempPool* pool);
+
+// Start over for the next function
+void tempPoolReset(TempPool* pool);
+
+// A temporary not in use, to be set by quad number quad
+Operand tempTake(TempPool* pool, size_t quad);
+
+// Give back operand if it is a temporary in use; anything else is ignored
+void tempRelease(TempPool* pool, Operand operand);
+
+// A condition compiled to jumps. The value it tests last is kept untested
+// until the code after it is known, so that its jump can go wherever the
+// code does not fall through
+typedef struct Condition
+{
+  JumpList truelist;   // jumps taken when it is true
+  JumpList falselist;  // and when it is false
+  Operand test;        // value still to be tested, or OPERAND_NONE
+  int negated;         // whether it is true when test is zero
+} Condition;
+
+// Whether a quad jumps, and whether it reads or sets an operand
+int quadIsJump(const Quad* quad);
+int quadReads(const Quad* quad, Operand operand);
+int quadSets(const Quad* quad, Operand operand);
+
+// Mark in leader[0..count-1] the quads that start a basic block: the
+// first one, those jumped to and those after a jump
+void quadLeaders(const QuadList* code, uint8_t* leader);
+
+// Remove the quads marked in removed[0..count-1]; a jump to a removed quad
+// goes to the next one kept, and functions keep the quads left of theirs.
+// Returns how many were removed
+size_t quadRemove(QuadList* code, const uint8_t* removed);
+
+// Print an operand, or a quad without its number, as the text of the code
+void quadPrintOperand(const QuadList* code, Operand operand, FILE* out);
+void quadPrint(const QuadList* code, const Quad* quad, FILE* out);
+
+// Print every quad numbered, one per line
+void quadDump(const QuadList* code, FILE* out);
+
+#endif
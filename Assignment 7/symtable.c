@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "symtable.h"
+
+// Control byte values. A full slot stores H2 of its hash (0..127).
+#define CTRL_EMPTY   ((int8_t) -128)
+#define CTRL_DELETED ((int8_t) -2)
+
+#define INITIAL_CAPACITY GROUP_WIDTH
+
+// Upper bits of the hash select the starting group, lower 7 bits are
+// kept in the control byte.
+#define H1(hash) ((size_t) ((hash) >> 7))
+#define H2(hash) ((int8_t) ((hash) & 0x7f))
+
+// Bitmask with bit i set if control byte i of the group equals byte
+static unsigned matchByte(const int8_t* group, int8_t byte)
+{
+#ifdef __SSE2__
+  __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+  return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+#else
+  unsigned mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++)
+    if (group[i] == byte)
+      mask |= 1u << i;
+  return mask;
+#endif
+}
+
+// Bitmask of the EMPTY or DELETED control bytes of the group
+static unsigned matchFree(const int8_t* group)
+{
+#ifdef __SSE2__
+  __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+  return (unsigned) _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl));
+#else
+  unsigned mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++)
+    if (group[i] < -1)
+      mask |= 1u << i;
+  return mask;
+#endif
+}
+
+// Set a control byte, keeping the cloned bytes past the end in sync so
+// that a group can be loaded from any slot without wrapping around.
+static void setCtrl(Symtable* table, size_t i, int8_t byte)
+{
+  table->ctrl[i] = byte;
+  if (i < GROUP_WIDTH)
+    table->ctrl[table->capacity + i] = byte;
+}
+
+static void allocate(Symtable* table, size_t capacity)
+{
+  table->ctrl = (int8_t*) malloc(capacity + GROUP_WIDTH);
+  memset(table->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+  table->slots = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+  table->capacity = capacity;
+  table->used = 0;
+  table->tombstones = 0;
+}
+
+// First EMPTY or DELETED slot on the probe sequence of hash
+static size_t findFree(const Symtable* table, uint64_t hash)
+{
+  size_t mask = table->capacity - 1;
+  size_t pos = H1(hash) & mask;
+  size_t stride = 0;
+
+  for (;;)
+  {
+    unsigned free_slots = matchFree(table->ctrl + pos);
+    if (free_slots)
+      return (pos + __builtin_ctz(free_slots)) & mask;
+
+    // Triangular probing visits every group once when capacity is a power of two
+    stride += GROUP_WIDTH;
+    pos = (pos + stride) & mask;
+  }
+}
+
+// Slot indexing the innermost symbol called name, or capacity if none;
+// the groups probed are counted in *groups
+static size_t probeSlot(const Symtable* table, Atom name, uint64_t hash, size_t* groups)
+{
+  size_t mask = table->capacity - 1;
+  size_t pos = H1(hash) & mask;
+  size_t stride = 0;
+
+  for (*groups = 1;; ++*groups)
+  {
+    const int8_t* group = table->ctrl + pos;
+    unsigned candidates = matchByte(group, H2(hash));
+
+    while (candidates)
+    {
+      size_t i = (pos + __builtin_ctz(candidates)) & mask;
+      candidates &= candidates - 1;
+
+      if (table->symbols[table->slots[i]].name == name)
+        return i;
+    }
+
+    // An EMPTY byte ends every probe sequence passing through this group
+    if (matchByte(group, CTRL_EMPTY))
+      return table->capacity;
+
+    stride += GROUP_WIDTH;
+    pos = (pos + stride) & mask;
+  }
+}
+
+static size_t findSlot(const Symtable* table, Atom name, uint64_t hash)
+{
+  size_t groups;
+  return probeSlot(table, name, hash, &groups);
+}
+
+// Rebuild the index with the given capacity, dropping all tombstones
+static void rehash(Symtable* table, size_t capacity)
+{
+  int8_t* old_ctrl = table->ctrl;
+  uint32_t* old_slots = table->slots;
+  size_t old_capacity = table->capacity;
+  allocate(table, capacity);
+
+  for (size_t i = 0; i < old_capacity; i++)
+  {
+    if (old_ctrl[i] < 0)
+      continue;
+
+    size_t j = findFree(table, symtableHash(table->symbols[old_slots[i]].name));
+    setCtrl(table, j, old_ctrl[i]);
+    table->slots[j] = old_slots[i];
+    table->used++;
+  }
+
+  free(old_ctrl);
+  free(old_slots);
+}
+
+/*
+  Atoms are small consecutive integers, so they are spread over the whole
+  64-bit range with the murmur3 finalizer before use.
+*/
+uint64_t symtableHash(Atom name)
+{
+  uint64_t hash = name;
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+void symtableInit(Symtable* table)
+{
+  allocate(table, INITIAL_CAPACITY);
+
+  table->symbols = NULL;
+  table->size = table->symbols_capacity = 0;
+
+  table->scopes = NULL;
+  table->depth = table->scopes_capacity = 0;
+}
+
+void symtableFree(Symtable* table)
+{
+  free(table->ctrl);
+  free(table->slots);
+  free(table->symbols);
+  free(table->scopes);
+  table->ctrl = NULL;
+  table->slots = NULL;
+  table->symbols = NULL;
+  table->scopes = NULL;
+  table->capacity = table->used = table->tombstones = 0;
+  table->size = table->symbols_capacity = 0;
+  table->depth = table->scopes_capacity = 0;
+}
+
+Symbol* symtableInsert(Symtable* table, Atom name, int dtype, int scope)
+{
+  if (table->size == table->symbols_capacity)
+  {
+    table->symbols_capacity = table->symbols_capacity ? 2 * table->symbols_capacity : 64;
+    table->symbols = (Symbol*) realloc(table->symbols, table->symbols_capacity * sizeof(Symbol));
+  }
+
+  uint32_t index = (uint32_t) table->size++;
+  Symbol* symbol = &table->symbols[index];
+  symbol->name = name;
+  symbol->dtype = dtype;
+  symbol->scope = scope;
+
+  // A name already visible is shadowed: its slot now points at the new symbol
+  uint64_t hash = symtableHash(name);
+  size_t i = findSlot(table, name, hash);
+  if (i != table->capacity)
+  {
+    symbol->shadowed = table->slots[i];
+    table->slots[i] = index;
+    return symbol;
+  }
+  symbol->shadowed = NO_SYMBOL;
+
+  // Keep at least 1/8 of the slots EMPTY so that every probe terminates
+  if ((table->used + table->tombstones + 1) * 8 > table->capacity * 7)
+  {
+    if (table->used * 2 < table->capacity)
+      rehash(table, table->capacity);
+    else
+      rehash(table, table->capacity * 2);
+  }
+
+  i = findFree(table, hash);
+  if (table->ctrl[i] == CTRL_DELETED)
+    table->tombstones--;
+  setCtrl(table, i, H2(hash));
+  table->slots[i] = index;
+  table->used++;
+  return symbol;
+}
+
+Symbol* symtableLookup(const Symtable* table, Atom name)
+{
+  size_t i = findSlot(table, name, symtableHash(name));
+  if (i == table->capacity)
+    return NULL;
+
+  return &table->symbols[table->slots[i]];
+}
+
+size_t symtableProbes(const Symtable* table, Atom name)
+{
+  size_t groups;
+  probeSlot(table, name, symtableHash(name), &groups);
+  return groups;
+}
+
+Symbol* symtableLookupInScope(const Symtable* table, Atom name, int scope)
+{
+  // A symbol of the current scope is always the innermost one of its name
+  Symbol* symbol = symtableLookup(table, name);
+  if (symbol == NULL || symbol->scope != scope)
+    return NULL;
+
+  return symbol;
+}
+
+void symtableEnterScope(Symtable* table)
+{
+  if (table->depth == table->scopes_capacity)
+  {
+    table->scopes_capacity = table->scopes_capacity ? 2 * table->scopes_capacity : 16;
+    table->scopes = (size_t*) realloc(table->scopes, table->scopes_capacity * sizeof(size_t));
+  }
+
+  table->scopes[table->depth++] = table->size;
+}
+
+void symtableExitScope(Symtable* table)
+{
+  if (table->depth == 0)
+    return;
+
+  size_t start = table->scopes[--table->depth];
+
+  while (table->size > start)
+  {
+    uint32_t index = (uint32_t) --table->size;
+    const Symbol* symbol = &table->symbols[index];
+    size_t i = findSlot(table, symbol->name, symtableHash(symbol->name));
+
+    // Uncover the symbol it shadowed, if any
+    if (symbol->shadowed != NO_SYMBOL)
+      table->slots[i] = symbol->shadowed;
+    else
+    {
+      setCtrl(table, i, CTRL_DELETED);
+      table->used--;
+      table->tombstones++;
+    }
+  }
+}
+
+void symtablePrint(const Symtable* table)
+{
+  for (size_t i = 0; i < table->size; i++)
+  {
+    const Symbol* symbol = &table->symbols[i];
+    printf("%s %d %d\n", atomName(symbol->name), symbol->dtype, symbol->scope);
+  }
+}
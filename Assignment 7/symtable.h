@@ -0,0 +1,84 @@
+#ifndef SYMTABLE_H
+#define SYMTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "intern.h"
+
+// Number of control bytes examined together while probing
+#define GROUP_WIDTH 16
+
+// Index of no symbol
+#define NO_SYMBOL UINT32_MAX
+
+// Structure for a symbol's entry in a symbol table
+typedef struct Symbol
+{
+  Atom name;         // name of the identifier
+  int dtype;         // TypeId of its type; 0 for int, 1 for float
+  int scope;         // scope of this symbol
+  uint32_t shadowed; // symbol of the same name this one hides, or NO_SYMBOL
+} Symbol;
+
+/*
+  Symbol table structure.
+
+  Symbols live inline in a flat array in declaration order, which doubles
+  as the scope stack: scopes[i] is the number of symbols declared before
+  the i-th open scope was entered, so the symbols of the innermost scope
+  are always the last ones in the array.
+
+  They are indexed by name with open addressing in the style of a Swiss
+  table: every slot has a control byte which is either EMPTY, DELETED or
+  the low 7 bits of the hash of its Atom, and holds the index of the
+  innermost symbol of that name. Lookups compare GROUP_WIDTH control bytes
+  at once and only touch the slots whose control byte matches. The index
+  doubles once it is 7/8 full.
+
+  Exiting a scope pops exactly the symbols it declared, pointing their
+  slots back at the symbols they shadowed.
+*/
+typedef struct Symtable
+{
+  int8_t* ctrl;      // capacity + GROUP_WIDTH control bytes
+  uint32_t* slots;   // capacity indices into symbols
+  size_t capacity;   // power of two, at least GROUP_WIDTH
+  size_t used;       // number of FULL control bytes
+  size_t tombstones; // number of DELETED control bytes
+
+  Symbol* symbols;   // all visible symbols, outermost scope first
+  size_t size;
+  size_t symbols_capacity;
+
+  size_t* scopes;    // symbol count at entry of each open scope
+  size_t depth;
+  size_t scopes_capacity;
+} Symtable;
+
+void symtableInit(Symtable* table);
+void symtableFree(Symtable* table);
+
+uint64_t symtableHash(Atom name);
+
+// Add a symbol
+Symbol* symtableInsert(Symtable* table, Atom name, int dtype, int scope);
+
+// Innermost symbol with the given name, or NULL
+Symbol* symtableLookup(const Symtable* table, Atom name);
+
+// Number of groups a lookup of name probes, for statistics
+size_t symtableProbes(const Symtable* table, Atom name);
+
+// Symbol with the given name declared exactly in scope, or NULL
+Symbol* symtableLookupInScope(const Symtable* table, Atom name, int scope);
+
+// Open a new scope
+void symtableEnterScope(Symtable* table);
+
+// Remove the symbols declared in the innermost open scope
+void symtableExitScope(Symtable* table);
+
+void symtablePrint(const Symtable* table);
+
+#endif
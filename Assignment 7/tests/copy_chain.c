@@ -0,0 +1,11 @@
+int main()
+{
+    int a,c,p,q,x,y;
+    p = x + y;
+    c = a;
+    q = p;
+    a = q;
+    p = 0;
+    q = 0;
+    return 0;
+}
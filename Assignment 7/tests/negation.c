@@ -0,0 +1,11 @@
+int main()
+{
+    int a,b,c;
+    if (!a && !(a + b) || !!b) {
+        c = 1;
+    }
+    while (!(c - 3)) {
+        c = c + 1;
+    }
+    return 0;
+}
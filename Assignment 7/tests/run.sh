@@ -0,0 +1,23 @@
+#!/bin/sh
+# Writes the intermediate code of every program in tests/ and compares it
+# with the .txt file of the same name, run after building lex as
+#   sh tests/run.sh
+# Each program is compiled in a directory of its own, so that the
+# intermediate_code.txt of sample.c is left as it is.
+dir=$(cd "$(dirname "$0")" && pwd)
+lex="$dir/../lex"
+work=$(mktemp -d)
+status=0
+
+for test in "$dir"/*.c; do
+    name=$(basename "$test" .c)
+    if ! (cd "$work" && "$lex" "$test" >/dev/null) ||
+       ! diff -u "$dir/$name.txt" "$work/intermediate_code.txt"; then
+        echo "$name: wrong intermediate code"
+        status=1
+    fi
+done
+
+rm -rf "$work"
+[ $status -eq 0 ] && echo "tests passed"
+exit $status
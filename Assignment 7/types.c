@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+#define INITIAL_CAPACITY 64
+
+static uint64_t mix(uint64_t hash, uint64_t value)
+{
+  hash ^= value;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static uint64_t hashType(uint8_t kind, TypeId base, uint32_t count, const TypeId* params)
+{
+  uint64_t hash = mix(mix(mix(0x9e3779b97f4a7c15ULL, kind), base), count);
+  if (kind == TYPE_FUNCTION)
+    for (uint32_t i = 0; i < count; i++)
+      hash = mix(hash, params[i]);
+  return hash;
+}
+
+static int sameType(const TypeTable* table, const Type* type, uint8_t kind, TypeId base, uint32_t count, const TypeId* params)
+{
+  if (type->kind != kind || type->base != base || type->count != count)
+    return 0;
+
+  return kind != TYPE_FUNCTION || count == 0 ||
+         memcmp(table->params + type->params, params, count * sizeof(TypeId)) == 0;
+}
+
+static void allocateSlots(TypeTable* table, size_t capacity)
+{
+  table->slots = (TypeId*) malloc(capacity * sizeof(TypeId));
+  for (size_t i = 0; i < capacity; i++)
+    table->slots[i] = NO_TYPE;
+  table->capacity = capacity;
+}
+
+// Slot of the type in the index, or the empty slot where it belongs
+static size_t findSlot(const TypeTable* table, uint64_t hash, uint8_t kind, TypeId base, uint32_t count, const TypeId* params)
+{
+  size_t mask = table->capacity - 1;
+  size_t i = (size_t) hash & mask;
+
+  while (table->slots[i] != NO_TYPE &&
+         !sameType(table, &table->types[table->slots[i]], kind, base, count, params))
+    i = (i + 1) & mask;
+
+  return i;
+}
+
+static void grow(TypeTable* table)
+{
+  free(table->slots);
+  allocateSlots(table, table->capacity * 2);
+
+  for (TypeId id = 0; id < table->size; id++)
+  {
+    const Type* type = &table->types[id];
+    const TypeId* params = type->kind == TYPE_FUNCTION && type->count ? table->params + type->params : NULL;
+    uint64_t hash = hashType(type->kind, type->base, type->count, params);
+    table->slots[findSlot(table, hash, type->kind, type->base, type->count, params)] = id;
+  }
+}
+
+// The id of the given type, entering it first if it is new
+static TypeId intern(TypeTable* table, uint8_t kind, TypeId base, uint32_t count, const TypeId* params)
+{
+  uint64_t hash = hashType(kind, base, count, params);
+  size_t i = findSlot(table, hash, kind, base, count, params);
+  if (table->slots[i] != NO_TYPE)
+    return table->slots[i];
+
+  if (table->size == table->types_capacity)
+  {
+    table->types_capacity = table->types_capacity ? 2 * table->types_capacity : INITIAL_CAPACITY;
+    table->types = (Type*) realloc(table->types, table->types_capacity * sizeof(Type));
+  }
+
+  TypeId id = (TypeId) table->size++;
+  Type* type = &table->types[id];
+  type->kind = kind;
+  type->base = base;
+  type->count = count;
+  type->params = (uint32_t) table->params_size;
+
+  if (kind == TYPE_FUNCTION && count > 0)
+  {
+    if (table->params_size + count > table->params_capacity)
+    {
+      while (table->params_size + count > table->params_capacity)
+        table->params_capacity = table->params_capacity ? 2 * table->params_capacity : INITIAL_CAPACITY;
+      table->params = (TypeId*) realloc(table->params, table->params_capacity * sizeof(TypeId));
+    }
+    memcpy(table->params + table->params_size, params, count * sizeof(TypeId));
+    table->params_size += count;
+  }
+
+  table->slots[i] = id;
+
+  // Keep the index at most half full
+  if (table->size * 2 > table->capacity)
+    grow(table);
+
+  return id;
+}
+
+void typeTableInit(TypeTable* table)
+{
+  table->types = NULL;
+  table->size = table->types_capacity = 0;
+  table->params = NULL;
+  table->params_size = table->params_capacity = 0;
+  allocateSlots(table, INITIAL_CAPACITY);
+
+  for (int kind = 0; kind < TYPE_PRIMITIVE_COUNT; kind++)
+    intern(table, (uint8_t) kind, NO_TYPE, 0, NULL);
+}
+
+void typeTableFree(TypeTable* table)
+{
+  free(table->types);
+  free(table->params);
+  free(table->slots);
+  table->types = NULL;
+  table->params = NULL;
+  table->slots = NULL;
+  table->size = table->types_capacity = 0;
+  table->params_size = table->params_capacity = 0;
+  table->capacity = 0;
+}
+
+const Type* typeGet(const TypeTable* table, TypeId type)
+{
+  return &table->types[type];
+}
+
+const TypeId* typeParams(const TypeTable* table, TypeId function)
+{
+  return table->params + table->types[function].params;
+}
+
+TypeId typeArray(TypeTable* table, TypeId element, uint32_t length)
+{
+  return intern(table, TYPE_ARRAY, element, length, NULL);
+}
+
+TypeId typeFunction(TypeTable* table, TypeId result, const TypeId* params, uint32_t count)
+{
+  return intern(table, TYPE_FUNCTION, result, count, params);
+}
+
+TypeId typeValue(const TypeTable* table, TypeId type)
+{
+  if (type != NO_TYPE && table->types[type].kind == TYPE_ARRAY)
+    return table->types[type].base;
+
+  return type;
+}
@@ -0,0 +1,76 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Hash-consed types.
+
+  Every distinct type is stored once in a TypeTable and named by a 32-bit
+  TypeId, so two types are equal exactly when their ids are, however
+  deeply they are built. Building a type that already exists returns the
+  existing id.
+
+  The primitive types are entered first, in TypeKind order, so the id of
+  a primitive type is its kind: int is 0 and float is 1, as the datatypes
+  have always been numbered.
+*/
+typedef uint32_t TypeId;
+
+// Id of no type, e.g. of an undefined identifier
+#define NO_TYPE UINT32_MAX
+
+typedef enum TypeKind
+{
+  TYPE_INT,
+  TYPE_FLOAT,
+  TYPE_CHAR,
+  TYPE_DOUBLE,
+  TYPE_ARRAY,       // base: element type, count: length
+  TYPE_FUNCTION     // base: result type, count: number of parameters
+} TypeKind;
+
+#define TYPE_PRIMITIVE_COUNT TYPE_ARRAY
+
+typedef struct Type
+{
+  uint8_t kind;     // TypeKind
+  TypeId base;
+  uint32_t count;
+  uint32_t params;  // first parameter type in the parameter pool
+} Type;
+
+typedef struct TypeTable
+{
+  Type* types;
+  size_t size;
+  size_t types_capacity;
+
+  TypeId* params;   // parameter types of all function types
+  size_t params_size;
+  size_t params_capacity;
+
+  TypeId* slots;    // open addressing index of types, NO_TYPE if empty
+  size_t capacity;  // power of two
+} TypeTable;
+
+void typeTableInit(TypeTable* table);
+void typeTableFree(TypeTable* table);
+
+const Type* typeGet(const TypeTable* table, TypeId type);
+
+// Parameter types of a function type
+const TypeId* typeParams(const TypeTable* table, TypeId function);
+
+// The type of length elements of type element
+TypeId typeArray(TypeTable* table, TypeId element, uint32_t length);
+
+// The type of functions taking count parameters and returning result
+TypeId typeFunction(TypeTable* table, TypeId result, const TypeId* params, uint32_t count);
+
+// Type of the value a name of the given type stands for in an expression:
+// the element type of an array, otherwise the type itself
+TypeId typeValue(const TypeTable* table, TypeId type);
+
+#endif
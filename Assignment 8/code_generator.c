@@ -89,6 +89,58 @@ int inRegDesc ( char* var )
     return regNum;
 }
 
+/**
+ * @brief Check if an operand is a number, which may be negative
+ *        as constants are folded.
+ *
+ */
+int isNumber ( char* operand )
+{
+    if (operand[0] == '-')
+        operand++;
+    return operand[0] >= '0' && operand[0] <= '9';
+}
+
+/**
+ * @brief Remove a variable from the register descriptor table, as the
+ *        value the registers hold for it is old once it is assigned.
+ *        Temporaries are reused for new values, so this happens often.
+ *
+ */
+void forgetVariable ( char* var )
+{
+    for (int i = 0; i < 4; i++)
+    {
+        int k = 0;
+        for (int j = 0; j < 5; j++)
+            if (strcmp(regDesc[i].name[j], var) != 0)
+            {
+                if (k != j)
+                    strcpy(regDesc[i].name[k], regDesc[i].name[j]);
+                k++;
+            }
+        for (; k < 5; k++)
+            memset(regDesc[i].name[k], 0, 5);
+
+        if (strlen(regDesc[i].name[0]) == 0)
+            regDesc[i].isOccupied = 0;
+    }
+}
+
+/**
+ * @brief Record that a register now holds only the value of a variable.
+ *
+ */
+void setRegister ( int regNum, char* var )
+{
+    forgetVariable(var);
+    for (int j = 0; j < 5; j++)
+        memset(regDesc[regNum].name[j], 0, 5);
+
+    regDesc[regNum].isOccupied = 1;
+    strcpy(regDesc[regNum].name[0], var);
+}
+
 /**
  * @brief Produce output of lexical analysis on program passed as
  *        command line arg.
@@ -139,7 +191,7 @@ int main ( int argc, char **argv )
         int i = 0;
         while (token != NULL)
         {
-            tokens[i] = (char*) malloc( 5 * sizeof(char));
+            tokens[i] = (char*) malloc( (strlen(token) + 1) * sizeof(char));
             strcpy(tokens[i], token);
             token = strtok(NULL," ");
             i += 1;
@@ -176,8 +228,7 @@ int main ( int argc, char **argv )
                 if (!done)
                     regNum = rand() % 4;
 
-                regDesc[regNum].isOccupied = 1;
-                strcpy(regDesc[regNum].name[0], tokens[1]);
+                setRegister(regNum, tokens[1]);
 
                 fprintf(assemblyFile, "MOV R%d,A\n", regNum);
             }
@@ -203,8 +254,31 @@ int main ( int argc, char **argv )
                 if (!done)
                     regNum = rand() % 4;
 
-                regDesc[regNum].isOccupied = 1;
-                strcpy(regDesc[regNum].name[0], tokens[1]);
+                setRegister(regNum, tokens[1]);
+
+                fprintf(assemblyFile, "MOV R%d,A\n", regNum);
+            }
+
+            // assignment of a constant
+            else if (tokens[4]==NULL && isNumber(tokens[3]))
+            {
+                fprintf(assemblyFile, "MVI A,%s\n", tokens[3]);
+
+                int done = 0;
+                int regNum = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    if (!regDesc[i].isOccupied)
+                    {
+                        regNum = i;
+                        done = 1;
+                        break;
+                    }
+                }
+                if (!done)
+                    regNum = rand() % 4;
+
+                setRegister(regNum, tokens[1]);
 
                 fprintf(assemblyFile, "MOV R%d,A\n", regNum);
             }
@@ -215,11 +289,15 @@ int main ( int argc, char **argv )
                 fprintf (assemblyFile, "LHLD %s\n", tokens[3]);
 
                 int regNum = inRegDesc(tokens[3]);
-                if (regNum != -1)
+                if (regNum != -1 && strcmp(tokens[1], tokens[3]) != 0)
                 {
+                    forgetVariable(tokens[1]);
                     for(int j = 0; j < 5; j++)
                         if (strlen(regDesc[regNum].name[j]) == 0)
+                        {
                             strcpy(regDesc[regNum].name[j], tokens[1]);
+                            break;
+                        }
                 }
 
                 else
@@ -238,18 +316,17 @@ int main ( int argc, char **argv )
                     if (!done)
                         reg_num1 = rand() % 4;
 
-                    regDesc[reg_num1].isOccupied = 1;
-                    strcpy(regDesc[reg_num1].name[0], tokens[1]);
+                    setRegister(reg_num1, tokens[1]);
 
                     fprintf(assemblyFile, "MOV R%d,M\n", reg_num1);
                 }
             }
 
             // type (number+something) or (number-something)
-            else if (tokens[3][0]>='0' && tokens[3][0]<='9')
+            else if (isNumber(tokens[3]))
             {
                 // type (number+number) or (number-number)
-                if (tokens[5][0]>='0' && tokens[5][0]<='9')
+                if (isNumber(tokens[5]))
                 {
                     fprintf(assemblyFile, "MVI A,%s\n", tokens[3]);
                     if (strcmp(tokens[4], "+") == 0)
@@ -271,8 +348,7 @@ int main ( int argc, char **argv )
                     if (!done)
                         regNum = rand() % 4;
 
-                    regDesc[regNum].isOccupied = 1;
-                    strcpy(regDesc[regNum].name[0], tokens[1]);
+                    setRegister(regNum, tokens[1]);
 
                     fprintf(assemblyFile, "MOV R%d,A\n", regNum);
                 }
@@ -308,15 +384,14 @@ int main ( int argc, char **argv )
                     if (!done)
                         regNum = rand() % 4;
 
-                    regDesc[regNum].isOccupied = 1;
-                    strcpy(regDesc[regNum].name[0], tokens[1]);
+                    setRegister(regNum, tokens[1]);
 
                     fprintf(assemblyFile, "MOV R%d,A\n", regNum);
                 }
             }
 
             // type (id+number) or (id-number)
-            else if (tokens[5][0]>='0' && tokens[5][0]<='9')
+            else if (isNumber(tokens[5]))
             {
                 int regNum = inRegDesc(tokens[3]);
                 if (regNum == -1)
@@ -347,8 +422,7 @@ int main ( int argc, char **argv )
                 if (!done)
                     regNum = rand() % 4;
 
-                regDesc[regNum].isOccupied = 1;
-                strcpy(regDesc[regNum].name[0], tokens[1]);
+                setRegister(regNum, tokens[1]);
 
                 fprintf(assemblyFile, "MOV R%d,A\n", regNum);
             }
@@ -397,8 +471,7 @@ int main ( int argc, char **argv )
                 if (!done)
                     regNum = rand() % 4;
 
-                regDesc[regNum].isOccupied = 1;
-                strcpy(regDesc[regNum].name[0], tokens[1]);
+                setRegister(regNum, tokens[1]);
 
                 fprintf(assemblyFile,"MOV R%d,A\n",regNum);
             }
@@ -411,13 +484,17 @@ int main ( int argc, char **argv )
             if (strcmp(tokens[1], "goto") == 0)
                 fprintf(assemblyFile, "JMP %s\n", tokens[2]);
 
-            // conditional jump
+            // conditional jump, taken if the value is nonzero for "if"
+            // and if it is zero for "ifFalse"
             else
             {
                 fprintf(assemblyFile, "LHLD %s\n", tokens[2]);
                 fprintf(assemblyFile, "MOV A,M\n");
                 fprintf(assemblyFile, "ADI 0\n");
-                fprintf(assemblyFile, "JNZ %s\n", tokens[4]);
+                if (strcmp(tokens[1], "ifFalse") == 0)
+                    fprintf(assemblyFile, "JZ %s\n", tokens[4]);
+                else
+                    fprintf(assemblyFile, "JNZ %s\n", tokens[4]);
             }
         }
 